@@ -0,0 +1,92 @@
+/*
+ * Licensed Materials - Property of IBM
+ * (C) Copyright IBM Corp. 2022. All Rights Reserved.
+ * US Government Users Restricted Rights - Use, duplication or disclosure
+ * restricted by GSA ADP Schedule Contract with IBM Corp.
+ */
+#include "CompiledSchema.h"
+#include "WrappedVsam.h"
+
+
+Napi::Function CompiledSchema::Init(Napi::Env env) {
+  Napi::HandleScope scope(env);
+
+  return DefineClass(
+      env, "CompiledSchema",
+      {InstanceAccessor("fields", &CompiledSchema::GetFields, nullptr),
+       InstanceAccessor("key", &CompiledSchema::GetKey, nullptr),
+       InstanceAccessor("recordLength", &CompiledSchema::GetRecordLength,
+                        nullptr)});
+}
+
+// static
+Napi::Value CompiledSchema::Compile(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  if (info.Length() != 1 || !info[0].IsObject() ||
+      get(env, info[0]) != nullptr) {
+    Napi::TypeError::New(env, "compileSchema error: compileSchema() expects "
+                              "argument: schema JSON object.")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  std::shared_ptr<SchemaLayout> pSchema = std::make_shared<SchemaLayout>();
+  if (!WrappedVsam::parseSchema(info, info[0].ToObject(), "compileSchema",
+                                pSchema->layout, pSchema->key_i,
+                                pSchema->keypos, &pSchema->altKey))
+    return env.Null();
+  if (pSchema->layout.empty()) {
+    Napi::TypeError::New(env, "compileSchema error: the schema has no field.")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  Napi::Object obj =
+      WrappedVsam::getAddonData(env)->compiledSchemaConstructor.New({});
+  CompiledSchema *p = Napi::ObjectWrap<CompiledSchema>::Unwrap(obj);
+  if (p == nullptr)
+    return env.Null();
+  p->pSchema_ = pSchema;
+  return obj;
+}
+
+// static
+std::shared_ptr<const SchemaLayout>
+CompiledSchema::get(Napi::Env env, const Napi::Value &value) {
+  if (!value.IsObject() ||
+      !value.As<Napi::Object>().InstanceOf(
+          WrappedVsam::getAddonData(env)->compiledSchemaConstructor.Value()))
+    return nullptr;
+  CompiledSchema *p =
+      Napi::ObjectWrap<CompiledSchema>::Unwrap(value.As<Napi::Object>());
+  return p != nullptr ? p->pSchema_ : nullptr;
+}
+
+CompiledSchema::CompiledSchema(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<CompiledSchema>(info) {}
+
+Napi::Value CompiledSchema::GetFields(const Napi::CallbackInfo &info) {
+  // a copy each time, so the layout shared by the datasets isn't changed
+  Napi::Env env = info.Env();
+  const std::vector<LayoutItem> &layout = pSchema_->layout;
+  Napi::Array fields = Napi::Array::New(env, layout.size());
+  for (size_t i = 0; i < layout.size(); i++) {
+    Napi::Object field = Napi::Object::New(env);
+    field.Set("name", layout[i].name);
+    field.Set("type", layout[i].type == LayoutItem::STRING ? "string"
+                                                           : "hexadecimal");
+    field.Set("offset", Napi::Number::New(env, layout[i].offset));
+    field.Set("minLength", Napi::Number::New(env, layout[i].minLength));
+    field.Set("maxLength", Napi::Number::New(env, layout[i].maxLength));
+    fields.Set(i, field);
+  }
+  return fields;
+}
+
+Napi::Value CompiledSchema::GetKey(const Napi::CallbackInfo &info) {
+  return Napi::String::New(info.Env(), pSchema_->layout[pSchema_->key_i].name);
+}
+
+Napi::Value CompiledSchema::GetRecordLength(const Napi::CallbackInfo &info) {
+  const LayoutItem &last = pSchema_->layout.back();
+  return Napi::Number::New(info.Env(), last.offset + last.maxLength);
+}
@@ -0,0 +1,33 @@
+/*
+ * Licensed Materials - Property of IBM
+ * (C) Copyright IBM Corp. 2022. All Rights Reserved.
+ * US Government Users Restricted Rights - Use, duplication or disclosure
+ * restricted by GSA ADP Schedule Contract with IBM Corp.
+ */
+
+#pragma once
+#include "VsamFile.h"
+#include <memory>
+#include <napi.h>
+
+// A schema of compileSchema(), parsed once into the layout that openSync(),
+// allocSync(), openAsync() and allocAsync() share instead of parsing it on
+// each open; it can't be changed.
+class CompiledSchema : public Napi::ObjectWrap<CompiledSchema> {
+public:
+  static Napi::Function Init(Napi::Env env);
+  static Napi::Value Compile(const Napi::CallbackInfo &info);
+  // the layout of value if it's a CompiledSchema, else null
+  static std::shared_ptr<const SchemaLayout> get(Napi::Env env,
+                                                 const Napi::Value &value);
+
+  CompiledSchema(const Napi::CallbackInfo &info);
+
+private:
+  /* Entry point from Javascript */
+  Napi::Value GetFields(const Napi::CallbackInfo &info);
+  Napi::Value GetKey(const Napi::CallbackInfo &info);
+  Napi::Value GetRecordLength(const Napi::CallbackInfo &info);
+
+  std::shared_ptr<const SchemaLayout> pSchema_;
+};
@@ -0,0 +1,119 @@
+/*
+ * Licensed Materials - Property of IBM
+ * (C) Copyright IBM Corp. 2022. All Rights Reserved.
+ * US Government Users Restricted Rights - Use, duplication or disclosure
+ * restricted by GSA ADP Schedule Contract with IBM Corp.
+ */
+#include <string.h>
+
+#include "FieldIndex.h"
+
+FieldIndex::FieldIndex(size_t offset, size_t len, size_t keypos,
+                       size_t keylen)
+    : offset_(offset), len_(len), keypos_(keypos), keylen_(keylen),
+      slots_(1024, 0), nkeys_(0), nempty_(0) {}
+
+uint32_t FieldIndex::hash(const char *p, size_t len) {
+  // FNV-1a
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h ^= (unsigned char)p[i];
+    h *= 16777619u;
+  }
+  return h;
+}
+
+size_t FieldIndex::slotOf(const char *value) const {
+  // slot of value, or the empty slot where it goes; the table is never full
+  size_t mask = slots_.size() - 1;
+  size_t s = hash(value, len_) & mask;
+  while (slots_[s] != 0 &&
+         memcmp(values_.data() + (slots_[s] - 1) * len_, value, len_))
+    s = (s + 1) & mask;
+  return s;
+}
+
+void FieldIndex::grow() {
+  std::vector<uint32_t> old;
+  old.swap(slots_);
+  slots_.assign(old.size() * 2, 0);
+  for (auto i = old.begin(); i != old.end(); ++i)
+    if (*i != 0)
+      slots_[slotOf(values_.data() + (*i - 1) * len_)] = *i;
+}
+
+void FieldIndex::compact() {
+  // the values with no keys are dropped, and the others rehashed, in a table
+  // sized for them
+  std::string values;
+  std::vector<std::string> keys;
+  values.reserve((keys_.size() - nempty_) * len_);
+  keys.reserve(keys_.size() - nempty_);
+  for (size_t v = 0; v < keys_.size(); v++) {
+    if (keys_[v].empty())
+      continue;
+    values.append(values_, v * len_, len_);
+    keys.push_back(std::move(keys_[v]));
+  }
+  values_.swap(values);
+  keys_.swap(keys);
+  nempty_ = 0;
+  size_t n = 1024;
+  while (keys_.size() * 4 > n * 3)
+    n *= 2;
+  std::vector<uint32_t>(n, 0).swap(slots_);
+  for (size_t v = 0; v < keys_.size(); v++)
+    slots_[slotOf(values_.data() + v * len_)] = v + 1;
+}
+
+void FieldIndex::add(const char *recbuf) {
+  const char *value = recbuf + offset_;
+  size_t s = slotOf(value);
+  if (slots_[s] == 0) {
+    values_.append(value, len_);
+    keys_.push_back(std::string());
+    slots_[s] = keys_.size();
+    if (keys_.size() * 4 > slots_.size() * 3) // load factor 0.75
+      grow();
+  } else if (keys_[slots_[s] - 1].empty())
+    nempty_--;
+  keys_[slots_[slotOf(value)] - 1].append(recbuf + keypos_, keylen_);
+  nkeys_++;
+}
+
+void FieldIndex::remove(const char *recbuf) {
+  remove(recbuf + offset_, recbuf + keypos_);
+}
+
+void FieldIndex::remove(const char *value, const char *key) {
+  // the value itself is kept, with no keys, so the probe chains stay intact,
+  // until those values are over half of them, when the table is compacted
+  size_t s = slotOf(value);
+  if (slots_[s] == 0)
+    return;
+  std::string &keys = keys_[slots_[s] - 1];
+  for (size_t k = 0; k < keys.length(); k += keylen_) {
+    if (memcmp(keys.data() + k, key, keylen_) == 0) {
+      keys.erase(k, keylen_);
+      nkeys_--;
+      if (keys.empty() && ++nempty_ > 1024 && nempty_ * 2 > keys_.size())
+        compact();
+      return;
+    }
+  }
+}
+
+const std::string *FieldIndex::find(const char *value) const {
+  size_t s = slotOf(value);
+  if (slots_[s] == 0 || keys_[slots_[s] - 1].empty())
+    return nullptr;
+  return &keys_[slots_[s] - 1];
+}
+
+size_t FieldIndex::memoryUsage() const {
+  size_t n = sizeof(*this) + slots_.capacity() * sizeof(uint32_t) +
+             values_.capacity() + keys_.capacity() * sizeof(std::string);
+  for (auto i = keys_.begin(); i != keys_.end(); ++i)
+    n += i->capacity();
+  return n;
+}
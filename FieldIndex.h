@@ -0,0 +1,45 @@
+/*
+ * Licensed Materials - Property of IBM
+ * (C) Copyright IBM Corp. 2022. All Rights Reserved.
+ * US Government Users Restricted Rights - Use, duplication or disclosure
+ * restricted by GSA ADP Schedule Contract with IBM Corp.
+ */
+
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Secondary index built by buildIndex(): an open-addressing hash map, with
+// linear probing, from the value of a field to the primary keys of the
+// records with that value. It's only used on the VSAM thread.
+class FieldIndex {
+public:
+  FieldIndex(size_t offset, size_t len, size_t keypos, size_t keylen);
+
+  void add(const char *recbuf);
+  void remove(const char *recbuf);
+  void remove(const char *value, const char *key);
+  // the primary keys of the records with value (len bytes), keylen bytes
+  // each one after the other, or nullptr if there's none
+  const std::string *find(const char *value) const;
+
+  size_t offset() const { return offset_; }
+  size_t keys() const { return nkeys_; }
+  size_t values() const { return keys_.size() - nempty_; }
+  size_t memoryUsage() const;
+
+private:
+  static uint32_t hash(const char *p, size_t len);
+  size_t slotOf(const char *value) const;
+  void grow();
+  void compact();
+
+  size_t offset_, len_; // of the field in the record
+  size_t keypos_, keylen_;
+  std::vector<uint32_t> slots_;   // 0 if empty, else 1 + index of a value
+  std::string values_;            // the distinct values, len_ bytes each
+  std::vector<std::string> keys_; // the primary keys of each value
+  size_t nkeys_;
+  size_t nempty_; // the values left with no keys, dropped by compact()
+};
@@ -0,0 +1,108 @@
+/*
+ * Licensed Materials - Property of IBM
+ * (C) Copyright IBM Corp. 2022. All Rights Reserved.
+ * US Government Users Restricted Rights - Use, duplication or disclosure
+ * restricted by GSA ADP Schedule Contract with IBM Corp.
+ */
+#include "RecordBatch.h"
+#include "WrappedVsam.h"
+
+
+Napi::Function RecordBatch::Init(Napi::Env env) {
+  Napi::HandleScope scope(env);
+
+  return DefineClass(env, "RecordBatch",
+                     {InstanceAccessor("length", &RecordBatch::GetLength,
+                                       nullptr),
+                      InstanceMethod("getRow", &RecordBatch::GetRow),
+                      InstanceMethod("getField", &RecordBatch::GetField),
+                      InstanceMethod("getKey", &RecordBatch::GetKey)});
+}
+
+// static
+Napi::Value RecordBatch::New(Napi::Env env,
+                             Napi::FunctionReference &constructor,
+                             const std::vector<LayoutItem> &layout, int key_i,
+                             size_t reclen, std::string &records) {
+  Napi::Object obj = constructor.New({});
+  RecordBatch *p = Napi::ObjectWrap<RecordBatch>::Unwrap(obj);
+  if (p == nullptr)
+    return env.Null();
+  p->layout_ = layout;
+  p->key_i_ = key_i;
+  p->reclen_ = reclen;
+  p->length_ = records.length() / reclen;
+  p->records_.swap(records);
+  return obj;
+}
+
+RecordBatch::RecordBatch(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<RecordBatch>(info), key_i_(-1), reclen_(0),
+      length_(0) {}
+
+const char *RecordBatch::getRecord(const Napi::CallbackInfo &info,
+                                   size_t nargs, const char *pApiName) {
+  Napi::Env env = info.Env();
+  if (info.Length() != nargs || !info[0].IsNumber()) {
+    Napi::TypeError::New(env, std::string(pApiName) + " error: " + pApiName +
+                                  (nargs == 1
+                                       ? "() expects arguments: index."
+                                       : "() expects arguments: index, "
+                                         "field-name."))
+        .ThrowAsJavaScriptException();
+    return nullptr;
+  }
+  double i = info[0].As<Napi::Number>().DoubleValue();
+  if (i < 0 || i >= length_ || i != (size_t)i) {
+    Napi::RangeError::New(env, std::string(pApiName) +
+                                   " error: index must be an integer from 0 "
+                                   "to length - 1.")
+        .ThrowAsJavaScriptException();
+    return nullptr;
+  }
+  return records_.data() + (size_t)i * reclen_;
+}
+
+Napi::Value RecordBatch::GetLength(const Napi::CallbackInfo &info) {
+  return Napi::Number::New(info.Env(), length_);
+}
+
+Napi::Value RecordBatch::GetRow(const Napi::CallbackInfo &info) {
+  const char *recbuf = getRecord(info, 1, "getRow");
+  if (recbuf == nullptr)
+    return info.Env().Null();
+  Napi::Object record = Napi::Object::New(info.Env());
+  for (auto i = layout_.begin(); i != layout_.end(); ++i)
+    record.Set(i->name, WrappedVsam::createFieldValue(info.Env(), *i,
+                                                       recbuf + i->offset));
+  return record;
+}
+
+Napi::Value RecordBatch::GetField(const Napi::CallbackInfo &info) {
+  if (info.Length() != 2 || !info[1].IsString()) {
+    Napi::TypeError::New(info.Env(), "getField error: getField() expects "
+                                     "arguments: index, field-name.")
+        .ThrowAsJavaScriptException();
+    return info.Env().Null();
+  }
+  const char *recbuf = getRecord(info, 2, "getField");
+  if (recbuf == nullptr)
+    return info.Env().Null();
+  const std::string &name =
+      static_cast<std::string>(info[1].As<Napi::String>());
+  for (auto i = layout_.begin(); i != layout_.end(); ++i)
+    if (i->name == name)
+      return WrappedVsam::createFieldValue(info.Env(), *i, recbuf + i->offset);
+  Napi::TypeError::New(info.Env(), "getField error: '" + name +
+                                       "' is not a field of the schema.")
+      .ThrowAsJavaScriptException();
+  return info.Env().Null();
+}
+
+Napi::Value RecordBatch::GetKey(const Napi::CallbackInfo &info) {
+  const char *recbuf = getRecord(info, 1, "getKey");
+  if (recbuf == nullptr)
+    return info.Env().Null();
+  const LayoutItem &item = layout_[key_i_];
+  return WrappedVsam::createFieldValue(info.Env(), item, recbuf + item.offset);
+}
@@ -0,0 +1,38 @@
+/*
+ * Licensed Materials - Property of IBM
+ * (C) Copyright IBM Corp. 2022. All Rights Reserved.
+ * US Government Users Restricted Rights - Use, duplication or disclosure
+ * restricted by GSA ADP Schedule Contract with IBM Corp.
+ */
+
+#pragma once
+#include "VsamFile.h"
+#include <napi.h>
+
+// Records of scanBatch(), kept in one buffer of fixed-length records with the
+// layout they were read with; a field is only decoded when it's accessed.
+class RecordBatch : public Napi::ObjectWrap<RecordBatch> {
+public:
+  static Napi::Function Init(Napi::Env env);
+  static Napi::Value New(Napi::Env env, Napi::FunctionReference &constructor,
+                         const std::vector<LayoutItem> &layout, int key_i,
+                         size_t reclen, std::string &records);
+
+  RecordBatch(const Napi::CallbackInfo &info);
+
+private:
+  /* Entry point from Javascript */
+  Napi::Value GetLength(const Napi::CallbackInfo &info);
+  Napi::Value GetRow(const Napi::CallbackInfo &info);
+  Napi::Value GetField(const Napi::CallbackInfo &info);
+  Napi::Value GetKey(const Napi::CallbackInfo &info);
+
+  const char *getRecord(const Napi::CallbackInfo &info, size_t nargs,
+                        const char *pApiName);
+
+  std::vector<LayoutItem> layout_;
+  int key_i_;
+  size_t reclen_;
+  size_t length_; // number of records
+  std::string records_;
+};
@@ -0,0 +1,214 @@
+/*
+ * Licensed Materials - Property of IBM
+ * (C) Copyright IBM Corp. 2022. All Rights Reserved.
+ * US Government Users Restricted Rights - Use, duplication or disclosure
+ * restricted by GSA ADP Schedule Contract with IBM Corp.
+ */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Snapshot.h"
+#include "RecordBatch.h"
+#include "WrappedVsam.h"
+
+
+Napi::Function Snapshot::Init(Napi::Env env) {
+  Napi::HandleScope scope(env);
+
+  return DefineClass(env, "Snapshot",
+                     {InstanceAccessor("length", &Snapshot::GetLength, nullptr),
+                      InstanceMethod("find", &Snapshot::Find),
+                      InstanceMethod("findeq", &Snapshot::Find),
+                      InstanceMethod("findge", &Snapshot::FindGe),
+                      InstanceMethod("scan", &Snapshot::Scan),
+                      InstanceMethod("close", &Snapshot::Close)});
+}
+
+// static
+Napi::Value Snapshot::Open(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  if (info.Length() != 2 || !info[0].IsString() || !info[1].IsObject()) {
+    Napi::TypeError::New(env, "openSnapshot error: openSnapshot() expects "
+                              "arguments: path, schema JSON object.")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  const std::string &path =
+      static_cast<std::string>(info[0].As<Napi::String>());
+  std::vector<LayoutItem> layout;
+  int key_i, keypos;
+  if (!WrappedVsam::parseSchema(info, info[1].ToObject(), "openSnapshot",
+                                layout, key_i, keypos))
+    return env.Null();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    std::string errmsg = "openSnapshot error: open() of " + path +
+                         " failed, errno=" + std::to_string(errno) + ".";
+    if (fd >= 0)
+      ::close(fd);
+    Napi::Error::New(env, errmsg).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  size_t maplen = st.st_size;
+  void *map = maplen == 0 ? MAP_FAILED
+                          : mmap(nullptr, maplen, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd); // the mapping remains
+  SnapshotHeader header;
+  if (map == MAP_FAILED ||
+      !header.decode((const char *)map, maplen, layout) ||
+      header.keypos != (uint32_t)keypos ||
+      header.keylen != layout[key_i].maxLength) {
+    if (map != MAP_FAILED)
+      munmap(map, maplen);
+    Napi::Error::New(env, "openSnapshot error: " + path +
+                              " is not a snapshot with the layout of the "
+                              "schema.")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+
+  Napi::Object obj =
+      WrappedVsam::getAddonData(env)->snapshotConstructor.New({});
+  Snapshot *p = Napi::ObjectWrap<Snapshot>::Unwrap(obj);
+  if (p == nullptr) {
+    munmap(map, maplen);
+    return env.Null();
+  }
+  p->layout_ = layout;
+  p->key_i_ = key_i;
+  p->keypos_ = keypos;
+  p->keylen_ = header.keylen;
+  p->reclen_ = header.reclen;
+  p->count_ = header.count;
+  p->map_ = map;
+  p->maplen_ = maplen;
+  p->records_ = (const char *)map + header.recordOffset();
+  return obj;
+}
+
+Snapshot::Snapshot(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<Snapshot>(info), key_i_(0), keypos_(0), keylen_(0),
+      reclen_(0), count_(0), map_(nullptr), maplen_(0), records_(nullptr) {}
+
+Snapshot::~Snapshot() { unmap(); }
+
+void Snapshot::unmap() {
+  if (map_ != nullptr) {
+    munmap(map_, maplen_);
+    map_ = nullptr;
+    records_ = nullptr;
+    count_ = 0;
+  }
+}
+
+bool Snapshot::errorIfClosed(const Napi::CallbackInfo &info,
+                             const char *pApiName) {
+  if (map_ != nullptr)
+    return false;
+  Napi::Error::New(info.Env(),
+                   std::string(pApiName) + " error: snapshot is not open.")
+      .ThrowAsJavaScriptException();
+  return true;
+}
+
+size_t Snapshot::lowerBound(const std::string &key) const {
+  // index of the first record whose initial key bytes are >= key
+  size_t lo = 0, hi = count_;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (memcmp(record(mid) + keypos_, key.data(), key.length()) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+Napi::Value Snapshot::createRecordObject(Napi::Env env, size_t i) const {
+  Napi::Object obj = Napi::Object::New(env);
+  const char *recbuf = record(i);
+  for (auto f = layout_.begin(); f != layout_.end(); ++f)
+    obj.Set(f->name,
+            WrappedVsam::createFieldValue(env, *f, recbuf + f->offset));
+  return obj;
+}
+
+Napi::Value Snapshot::GetLength(const Napi::CallbackInfo &info) {
+  return Napi::Number::New(info.Env(), count_);
+}
+
+Napi::Value Snapshot::find(const Napi::CallbackInfo &info, bool equal,
+                           const char *pApiName) {
+  Napi::Env env = info.Env();
+  if (info.Length() != 1) {
+    Napi::TypeError::New(env, std::string(pApiName) + " error: " + pApiName +
+                                  "() expects arguments: key-string or "
+                                  "key-buffer.")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (errorIfClosed(info, pApiName))
+    return env.Null();
+  std::string key, errmsg;
+  if (!WrappedVsam::encodeKey(layout_[key_i_], info[0], pApiName, key,
+                              errmsg)) {
+    Napi::TypeError::New(env, errmsg).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  size_t i = lowerBound(key);
+  if (i == count_ ||
+      (equal && memcmp(record(i) + keypos_, key.data(), key.length()) != 0))
+    return env.Null();
+  return createRecordObject(env, i);
+}
+
+Napi::Value Snapshot::Find(const Napi::CallbackInfo &info) {
+  return find(info, true, "find");
+}
+
+Napi::Value Snapshot::FindGe(const Napi::CallbackInfo &info) {
+  return find(info, false, "findge");
+}
+
+Napi::Value Snapshot::Scan(const Napi::CallbackInfo &info) {
+  Napi::Env env = info.Env();
+  if (info.Length() > 1 || (info.Length() == 1 && !info[0].IsObject())) {
+    Napi::TypeError::New(env,
+                         "scan error: scan() expects arguments: options.")
+        .ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  if (errorIfClosed(info, "scan"))
+    return env.Null();
+  ScanRange range;
+  std::string errmsg;
+  if (!WrappedVsam::parseScanRange(
+          layout_, key_i_,
+          info.Length() == 1 ? info[0].ToObject() : Napi::Object::New(env),
+          "scan", &range, errmsg)) {
+    Napi::TypeError::New(env, errmsg).ThrowAsJavaScriptException();
+    return env.Null();
+  }
+  std::string records;
+  size_t n = 0;
+  for (size_t i = lowerBound(range.from);
+       i < count_ && (range.maxCount == 0 || n < range.maxCount); i++) {
+    const char *recbuf = record(i);
+    if (!range.to.empty() &&
+        memcmp(recbuf + keypos_, range.to.data(), range.to.length()) > 0)
+      break;
+    if (!range.matches(recbuf))
+      continue;
+    records.append(recbuf, reclen_);
+    n++;
+  }
+  return RecordBatch::New(
+      env, WrappedVsam::getAddonData(env)->recordBatchConstructor, layout_,
+      key_i_, reclen_, records);
+}
+
+void Snapshot::Close(const Napi::CallbackInfo &info) { unmap(); }
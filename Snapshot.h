@@ -0,0 +1,48 @@
+/*
+ * Licensed Materials - Property of IBM
+ * (C) Copyright IBM Corp. 2022. All Rights Reserved.
+ * US Government Users Restricted Rights - Use, duplication or disclosure
+ * restricted by GSA ADP Schedule Contract with IBM Corp.
+ */
+
+#pragma once
+#include "VsamFile.h"
+#include <napi.h>
+
+// A file written by snapshotTo(), memory-mapped read-only: the records are
+// fixed-length and in ascending key order, so they're found by a binary
+// search in the mapping, with no I/O thread and no system call.
+class Snapshot : public Napi::ObjectWrap<Snapshot> {
+public:
+  static Napi::Function Init(Napi::Env env);
+  static Napi::Value Open(const Napi::CallbackInfo &info);
+
+  Snapshot(const Napi::CallbackInfo &info);
+  ~Snapshot();
+
+private:
+  /* Entry point from Javascript */
+  Napi::Value GetLength(const Napi::CallbackInfo &info);
+  Napi::Value Find(const Napi::CallbackInfo &info);
+  Napi::Value FindGe(const Napi::CallbackInfo &info);
+  Napi::Value Scan(const Napi::CallbackInfo &info);
+  void Close(const Napi::CallbackInfo &info);
+
+  bool errorIfClosed(const Napi::CallbackInfo &info, const char *pApiName);
+  const char *record(size_t i) const { return records_ + i * reclen_; }
+  size_t lowerBound(const std::string &key) const;
+  Napi::Value createRecordObject(Napi::Env env, size_t i) const;
+  Napi::Value find(const Napi::CallbackInfo &info, bool equal,
+                   const char *pApiName);
+  void unmap();
+
+  std::vector<LayoutItem> layout_;
+  int key_i_;
+  size_t keypos_;
+  size_t keylen_;
+  size_t reclen_;
+  size_t count_;       // of records
+  void *map_;          // null after close()
+  size_t maplen_;
+  const char *records_; // in the mapping
+};
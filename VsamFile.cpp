@@ -6,6 +6,7 @@
  */
 #include <assert.h>
 #include <dynit.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 #include <algorithm>
@@ -22,6 +23,8 @@
 
 static std::string &createErrorMsg(std::string &errmsg, int err, int err2,
                                    int r15, const std::string &errPrefix);
+static std::string &createErrorMsg(UvWorkData *pdata, int err, int err2,
+                                   int r15, const std::string &errPrefix);
 
 #if 0
 // Currently not used, but keep it in case it's needed.
@@ -38,11 +41,12 @@ int VsamFile::freadRecord(UvWorkData *pdata, int *pr15, bool expectEOF,
                           const char *pDisplayPrefix, const char *pErrPrefix) {
   size_t nread = fread(pdata->recbuf_, 1, reclen_, stream_);
   *pr15 = R15;
+  currecValid_ = false;
   if (feof(stream_)) {
     if (expectEOF)
       return 0;
     std::string msg = std::string(pDisplayPrefix) + " - unexpected EOF";
-    createErrorMsg(pdata->errmsg_, errno, __errno2(), *pr15, msg.c_str());
+    createErrorMsg(pdata, errno, __errno2(), *pr15, msg.c_str());
     pdata->rc_ = 1;
     return pdata->rc_;
   }
@@ -65,16 +69,18 @@ int VsamFile::freadRecord(UvWorkData *pdata, int *pr15, bool expectEOF,
 #if defined(DEBUG) || defined(DEBUG_CRUD)
       displayRecord(pdata->recbuf_, msg.c_str());
 #endif
+      currec_.assign(pdata->recbuf_, reclen_);
+      currecValid_ = true;
       return 0;
     }
     if (nread <= reclen_ && !ferr)
       return 0;
-    createErrorMsg(pdata->errmsg_, errno, __errno2(), *pr15, msg.c_str());
+    createErrorMsg(pdata, errno, __errno2(), *pr15, msg.c_str());
   } else if (!ferr) {
     std::string msg = pDisplayPrefix;
     msg += std::string("; read ") + std::to_string(nread) + " of " +
            std::to_string(reclen_) + " bytes but ferror() is OFF";
-    createErrorMsg(pdata->errmsg_, errno, __errno2(), *pr15, msg.c_str());
+    createErrorMsg(pdata, errno, __errno2(), *pr15, msg.c_str());
   } else
     assert(0);
 
@@ -109,13 +115,15 @@ int VsamFile::FindExecute(UvWorkData *pdata, const char *buf, int buflen) {
       return 0;
     assert(0);
   } else if (r15 == 8) {
+    currecValid_ = false;
     pdata->errmsg_ = "no record found";
     // flocate() returns only 0 or EOF (-1)
     assert(pdata->rc_ == EOF);
     pdata->rc_ = r15;
   } else {
     assert(pdata->rc_ != 0);
-    createErrorMsg(pdata->errmsg_, errno, __errno2(), r15,
+    currecValid_ = false;
+    createErrorMsg(pdata, errno, __errno2(), r15,
                    "find error: flocate() failed");
   }
   return pdata->rc_;
@@ -143,6 +151,8 @@ void VsamFile::FindUpdateExecute(UvWorkData *pdata) {
   int r15;
 
   for (pdata->count_ = 0; pdata->rc_ == 0;) {
+    if (isCancelled(pdata))
+      break;
     for (auto i = pdata->pFieldsToUpdate_->begin();
          i != pdata->pFieldsToUpdate_->end(); ++i) {
 #ifdef DEBUG
@@ -167,7 +177,7 @@ void VsamFile::FindUpdateExecute(UvWorkData *pdata) {
     if (pdata->rc_ != 0)
       break;
     pdata->count_++;
-    if (pdata->keybuf_len_ == keylen_) {
+    if (pdata->keybuf_len_ == keylen_ && !aixPath_) {
 #ifdef DEBUG
       fprintf(stderr,"FindUpdateExecute: key length provided is the same as the record's key length, stop search.\n");
 #endif
@@ -211,12 +221,14 @@ void VsamFile::FindDeleteExecute(UvWorkData *pdata) {
   int r15;
 
   for (pdata->count_ = 0; pdata->rc_ == 0;) {
+    if (isCancelled(pdata))
+      break;
     pdata->rc_ = 1;
     DeleteExecute(pdata);
     if (pdata->rc_ != 0)
       break;
     pdata->count_++;
-    if (pdata->keybuf_len_ == keylen_) {
+    if (pdata->keybuf_len_ == keylen_ && !aixPath_) {
 #ifdef DEBUG
       fprintf(stderr,"FindDeleteExecute: key length provided is the same as the record's key length, stop search.\n");
 #endif
@@ -248,6 +260,575 @@ void VsamFile::FindDeleteExecute(UvWorkData *pdata) {
   }
 }
 
+int VsamFile::ScanExecute(UvWorkData *pdata, const char *pApiName,
+                          const std::function<void(UvWorkData *)> &visit) {
+  DCHECK(pdata->pScanRange_ != nullptr);
+  const ScanRange &range = *pdata->pScanRange_;
+  if (pdata->recbuf_ == nullptr) {
+    pdata->recbuf_ = (char *)malloc(reclen_);
+    DCHECK(pdata->recbuf_ != nullptr);
+  }
+  pdata->equality_ = range.from.empty() ? __KEY_FIRST : __KEY_GE;
+  pdata->rc_ = FindExecute(pdata, range.from.data(), range.from.length());
+  pdata->count_ = 0;
+  if (pdata->rc_ == 8) {
+    // no record at or after the start of the range
+    pdata->errmsg_ = "";
+    pdata->rc_ = 0;
+    return 0;
+  }
+  std::string displayPrefix = std::string("fread() in ") + pApiName;
+  std::string errPrefix = std::string(pApiName) + " error: fread failed";
+  int r15;
+  size_t skipped = 0;
+
+  while (pdata->rc_ == 0) {
+    if (isCancelled(pdata))
+      break;
+    if (!range.to.empty() && memcmp(pdata->recbuf_ + keypos_, range.to.data(),
+                                    range.to.length()) > 0) {
+#ifdef DEBUG
+      fprintf(stderr, "ScanExecute: record key is past the range, stop\n");
+#endif
+      break;
+    }
+    bool matches = range.matches(pdata->recbuf_);
+    if (matches && skipped < range.afterCount &&
+        memcmp(pdata->recbuf_ + keypos_, range.from.data(),
+               range.from.length()) == 0) {
+      // returned in the previous page
+      skipped++;
+    } else if (matches) {
+      pdata->rc_ = 1;
+      visit(pdata);
+      if (pdata->rc_ != 0)
+        break;
+      pdata->count_++;
+      if (range.maxCount > 0 && pdata->count_ >= range.maxCount)
+        break;
+    }
+#ifdef DEBUG_CRUD
+    assert(fgetpos(stream_, &freadpos_) == 0);
+#endif
+    if (freadRecord(pdata, &r15, true, displayPrefix.c_str(),
+                    errPrefix.c_str()) != 0)
+      break;
+    if (feof(stream_))
+      break;
+  }
+  return pdata->rc_;
+}
+
+void VsamFile::ExportExecute(UvWorkData *pdata) {
+  DCHECK(pdata->rc_ != 0);
+  DCHECK(pdata->pExport_ != nullptr);
+  const size_t bufferSize = 1024 * 1024;
+  RecordExport &exp = *pdata->pExport_;
+  const bool snapshot = exp.format == RecordExport::SNAPSHOT;
+  const std::string apiName = snapshot ? "snapshotTo" : "exportTo";
+  // a snapshot replaces path only once complete, as it may be mapped
+  const std::string &path = snapshot ? exp.path + ".tmp" : exp.path;
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    createErrorMsg(pdata, errno, 0, 0,
+                   apiName + " error: open() of " + path + " failed");
+    return;
+  }
+  std::string out;
+  out.reserve(bufferSize + reclen_ * 8);
+  SnapshotHeader header;
+  if (exp.format == RecordExport::CSV) {
+    for (auto f = exp.fields.begin(); f != exp.fields.end(); ++f) {
+      if (f != exp.fields.begin())
+        out += ',';
+      appendCsvField(out, layout_[*f].name);
+    }
+    out += '\n';
+  } else if (snapshot) {
+    header.nfields = layout_.size();
+    header.reclen = reclen_;
+    header.keypos = keypos_;
+    header.keylen = keylen_;
+    header.encode(out, layout_); // with count 0 until the end
+  }
+  bool writeError = false;
+  int writeErrno = 0;
+  auto flush = [&]() {
+    // big sequential writes of the output buffer, then report the progress
+    for (size_t n = 0; n < out.length() && !writeError;) {
+      ssize_t rc = ::write(fd, out.data() + n, out.length() - n);
+      if (rc < 0) {
+        writeError = true;
+        writeErrno = errno;
+      } else
+        n += rc;
+    }
+    out.clear();
+    if (exp.progress != nullptr)
+      napi_call_threadsafe_function(
+          exp.progress, new RecordExport::Progress{pdata->count_, nullptr},
+          napi_tsfn_blocking);
+  };
+
+  ScanExecute(pdata, "exportTo", [&](UvWorkData *pdata) {
+    if (exp.format == RecordExport::NDJSON) {
+      appendJson(out, pdata->recbuf_, exp.fields);
+      out += '\n';
+    } else if (exp.format == RecordExport::CSV) {
+      appendCsv(out, pdata->recbuf_, exp.fields);
+      out += '\n';
+    } else if (snapshot)
+      out.append(pdata->recbuf_, reclen_);
+    else
+      appendRaw(out, pdata->recbuf_, exp.fields);
+    if (out.length() >= bufferSize) {
+      pdata->count_++; // count_ is incremented after this returns
+      flush();
+      pdata->count_--;
+    }
+    pdata->rc_ = writeError ? 1 : 0;
+  });
+  if (pdata->rc_ == 0)
+    flush();
+  if (snapshot && pdata->rc_ == 0 && !writeError) {
+    header.count = pdata->count_;
+    header.encode(out, layout_);
+    if (::pwrite(fd, out.data(), SnapshotHeader::SIZE, 0) !=
+        (ssize_t)SnapshotHeader::SIZE) {
+      writeError = true;
+      writeErrno = errno;
+    }
+  }
+  if (writeError) {
+    createErrorMsg(pdata, writeErrno, 0, 0,
+                   apiName + " error: write() to " + path + " failed");
+    pdata->rc_ = 1;
+  }
+  if (::close(fd) != 0 && pdata->rc_ == 0) {
+    createErrorMsg(pdata, errno, 0, 0,
+                   apiName + " error: close() of " + path + " failed");
+    pdata->rc_ = 1;
+  }
+  if (!snapshot)
+    return;
+  if (pdata->rc_ == 0 && ::rename(path.c_str(), exp.path.c_str()) != 0) {
+    createErrorMsg(pdata, errno, 0, 0,
+                   apiName + " error: rename() of " + path + " to " +
+                       exp.path + " failed");
+    pdata->rc_ = 1;
+  }
+  if (pdata->rc_ != 0)
+    ::unlink(path.c_str());
+}
+
+// "VSAMSNAP" in ASCII
+static const char snapshotMagic[8] = {'\x56', '\x53', '\x41', '\x4d',
+                                      '\x53', '\x4e', '\x41', '\x50'};
+
+static void appendBigEndian(std::string &out, uint64_t n, int len) {
+  for (int i = len - 1; i >= 0; i--)
+    out += (char)((n >> (i * 8)) & 0xff);
+}
+
+static uint64_t getBigEndian(const char *buf, int len) {
+  uint64_t n = 0;
+  for (int i = 0; i < len; i++)
+    n = (n << 8) | (unsigned char)buf[i];
+  return n;
+}
+
+void SnapshotHeader::encode(std::string &out,
+                            const std::vector<LayoutItem> &layout) const {
+  out.append(snapshotMagic, sizeof(snapshotMagic));
+  appendBigEndian(out, VERSION, 4);
+  appendBigEndian(out, nfields, 4);
+  appendBigEndian(out, reclen, 4);
+  appendBigEndian(out, keypos, 4);
+  appendBigEndian(out, keylen, 4);
+  appendBigEndian(out, 0, 4); // reserved
+  appendBigEndian(out, count, 8);
+  out.append(SIZE - 40, 0);
+  for (auto i = layout.begin(); i != layout.end(); ++i) {
+    appendBigEndian(out, i->type, 4);
+    appendBigEndian(out, i->maxLength, 4);
+  }
+}
+
+bool SnapshotHeader::decode(const char *buf, size_t len,
+                            const std::vector<LayoutItem> &layout) {
+  if (len < SIZE || memcmp(buf, snapshotMagic, sizeof(snapshotMagic)) ||
+      getBigEndian(buf + 8, 4) != VERSION)
+    return false;
+  nfields = getBigEndian(buf + 12, 4);
+  reclen = getBigEndian(buf + 16, 4);
+  keypos = getBigEndian(buf + 20, 4);
+  keylen = getBigEndian(buf + 24, 4);
+  count = getBigEndian(buf + 32, 8);
+  if (nfields != layout.size() || reclen == 0 || len < recordOffset() ||
+      (len - recordOffset()) / reclen < count)
+    return false;
+  for (size_t i = 0; i < nfields; i++) {
+    const char *fld = buf + SIZE + i * 8;
+    if (getBigEndian(fld, 4) != (uint64_t)layout[i].type ||
+        getBigEndian(fld + 4, 4) != layout[i].maxLength ||
+        layout[i].offset + layout[i].maxLength > reclen)
+      return false;
+  }
+  return true;
+}
+
+void VsamFile::ScanJsonExecute(UvWorkData *pdata) {
+  DCHECK(pdata->rc_ != 0);
+  DCHECK(pdata->pExport_ != nullptr);
+  RecordExport &exp = *pdata->pExport_;
+  exp.output = '[';
+  ScanExecute(pdata, "scanJson", [&](UvWorkData *pdata) {
+    if (pdata->count_ > 0)
+      exp.output += ',';
+    appendJson(exp.output, pdata->recbuf_, exp.fields);
+    pdata->rc_ = 0;
+  });
+  exp.output += ']';
+}
+
+void VsamFile::FindJsonExecute(UvWorkData *pdata) {
+  // the record is formatted here rather than on the main thread
+  FindExecute(pdata);
+  if (pdata->rc_ != 0)
+    return;
+  std::vector<int> fields(layout_.size());
+  std::iota(fields.begin(), fields.end(), 0);
+  appendJson(pdata->records_, pdata->recbuf_, fields);
+}
+
+void VsamFile::ScanColumnsExecute(UvWorkData *pdata) {
+  DCHECK(pdata->rc_ != 0);
+  DCHECK(pdata->pColumns_ != nullptr);
+  RecordColumns &cols = *pdata->pColumns_;
+  ScanExecute(pdata, "scanColumns", [this, &cols](UvWorkData *pdata) {
+    const char *recbuf = pdata->recbuf_;
+    for (auto c = cols.columns.begin(); c != cols.columns.end(); ++c) {
+      const LayoutItem &item = layout_[c->field];
+      if (c->type == RecordColumns::Column::BYTES) {
+        size_t len = item.maxLength;
+        if (item.type == LayoutItem::STRING)
+          len = strnlen(recbuf + item.offset, item.maxLength);
+        c->bytes.append(recbuf + item.offset, len);
+        c->u32.push_back(c->bytes.length());
+        continue;
+      }
+      const unsigned char *fld = (const unsigned char *)recbuf + item.offset;
+      uint64_t n = 0;
+      for (size_t i = 0; i < item.maxLength; i++)
+        n = (n << 8) | fld[i];
+      if (c->type == RecordColumns::Column::UINT32)
+        c->u32.push_back(n);
+      else if (c->type == RecordColumns::Column::FLOAT64)
+        c->f64.push_back(n);
+      else
+        c->u64.push_back(n);
+    }
+    cols.length++;
+    pdata->rc_ = 0;
+  });
+}
+
+void VsamFile::ScanBatchExecute(UvWorkData *pdata) {
+  DCHECK(pdata->rc_ != 0);
+  ScanExecute(pdata, "scanBatch", [this](UvWorkData *pdata) {
+    pdata->records_.append(pdata->recbuf_, reclen_);
+    pdata->rc_ = 0;
+  });
+}
+
+void VsamFile::ScanPageExecute(UvWorkData *pdata) {
+  DCHECK(pdata->rc_ != 0);
+  // the scan is for one record more than the page, to know if there's a next
+  // page, but that record isn't kept
+  size_t limit = pdata->pScanRange_->maxCount - 1;
+  ScanExecute(pdata, "scanPage", [this, limit](UvWorkData *pdata) {
+    if (pdata->count_ < limit)
+      pdata->records_.append(pdata->recbuf_, reclen_);
+    pdata->rc_ = 0;
+  });
+}
+
+void VsamFile::FindAllExecute(UvWorkData *pdata) {
+  DCHECK(pdata->rc_ != 0);
+  DCHECK(pdata->recbuf_ == nullptr);
+  pdata->recbuf_ = (char *)malloc(reclen_);
+  DCHECK(pdata->recbuf_ != nullptr);
+  pdata->count_ = 0;
+  if (FindExecute(pdata, pdata->keybuf_, pdata->keybuf_len_) != 0) {
+    if (pdata->rc_ == 8) {
+      pdata->errmsg_ = "";
+      pdata->rc_ = 0;
+    }
+    return;
+  }
+  // all the records with the key, e.g. the duplicates of a non-unique
+  // alternate key, which a path returns one after the other
+  int r15;
+  while (pdata->rc_ == 0 && !isCancelled(pdata)) {
+    pdata->records_.append(pdata->recbuf_, reclen_);
+    pdata->count_++;
+    if (freadRecord(pdata, &r15, true, "fread() in FindAll",
+                    "findAll error: fread failed") != 0 ||
+        feof(stream_) ||
+        memcmp(pdata->recbuf_ + keypos_, pdata->keybuf_, pdata->keybuf_len_))
+      break;
+  }
+}
+
+void VsamFile::indexAdd(const char *recbuf) {
+  for (auto i = indexes_.begin(); i != indexes_.end(); ++i)
+    i->second->add(recbuf);
+}
+
+void VsamFile::indexRemove(const char *recbuf) {
+  for (auto i = indexes_.begin(); i != indexes_.end(); ++i)
+    i->second->remove(recbuf);
+}
+
+static void setIndexStats(IndexRequest &req, const FieldIndex *pindex) {
+  req.keys = pindex ? pindex->keys() : 0;
+  req.values = pindex ? pindex->values() : 0;
+  req.memoryUsage = pindex ? pindex->memoryUsage() : 0;
+}
+
+void VsamFile::BuildIndexExecute(UvWorkData *pdata) {
+  DCHECK(pdata->rc_ != 0);
+  DCHECK(pdata->pIndex_ != nullptr);
+  IndexRequest &req = *pdata->pIndex_;
+  if (pdata->pScanRange_ == nullptr)
+    pdata->pScanRange_ = new ScanRange; // all records
+  const LayoutItem &item = layout_[req.field];
+  FieldIndex *pindex =
+      new FieldIndex(item.offset, item.maxLength, keypos_, keylen_);
+  ScanExecute(pdata, "buildIndex", [pindex](UvWorkData *pdata) {
+    pindex->add(pdata->recbuf_);
+    pdata->rc_ = 0;
+  });
+  if (pdata->rc_ != 0) {
+    delete pindex;
+    return;
+  }
+  // replaces the field's index if it was already built
+  auto i = indexes_.find(req.field);
+  if (i != indexes_.end())
+    delete i->second;
+  indexes_[req.field] = pindex;
+  setIndexStats(req, pindex);
+}
+
+void VsamFile::FindByExecute(UvWorkData *pdata) {
+  DCHECK(pdata->rc_ != 0);
+  DCHECK(pdata->pIndex_ != nullptr);
+  IndexRequest &req = *pdata->pIndex_;
+  auto i = indexes_.find(req.field);
+  if (i == indexes_.end()) {
+    pdata->errmsg_ = "findBy error: no index on field '" +
+                     layout_[req.field].name +
+                     "', buildIndex() must be called first.";
+    return;
+  }
+  FieldIndex *pindex = i->second;
+  const std::string *pkeys = pindex->find(req.value.data());
+  // a copy, as the keys of records no longer found are removed
+  const std::string keys = pkeys ? *pkeys : "";
+  DCHECK(pdata->recbuf_ == nullptr);
+  pdata->recbuf_ = (char *)malloc(reclen_);
+  DCHECK(pdata->recbuf_ != nullptr);
+  pdata->equality_ = __KEY_EQ;
+  pdata->count_ = 0;
+  for (size_t k = 0; k < keys.length(); k += keylen_) {
+    if (isCancelled(pdata))
+      return;
+    pdata->rc_ = 1;
+    if (FindExecute(pdata, keys.data() + k, keylen_) == 0) {
+      // the record is found by its primary key, and checked in case it was
+      // changed by another handle since it was indexed
+      if (memcmp(pdata->recbuf_ + pindex->offset(), req.value.data(),
+                 req.value.length()) == 0) {
+        pdata->records_.append(pdata->recbuf_, reclen_);
+        pdata->count_++;
+        continue;
+      }
+    } else if (pdata->rc_ != 8)
+      return;
+    pindex->remove(req.value.data(), keys.data() + k);
+  }
+  pdata->errmsg_ = "";
+  pdata->rc_ = 0;
+}
+
+void VsamFile::IndexStatsExecute(UvWorkData *pdata) {
+  DCHECK(pdata->pIndex_ != nullptr);
+  IndexRequest &req = *pdata->pIndex_;
+  auto i = indexes_.find(req.field);
+  setIndexStats(req, i == indexes_.end() ? nullptr : i->second);
+  pdata->rc_ = i == indexes_.end() ? 8 : 0;
+}
+
+void VsamFile::LoadBeginExecute(UvWorkData *pdata) {
+  DCHECK(pdata->rc_ != 0);
+  if (stream_ == nullptr) {
+    pdata->errmsg_ = "bulkLoad error: VSAM dataset is not open.";
+    return;
+  }
+  if (aixPath_) {
+    pdata->errmsg_ =
+        "bulkLoad error: cannot load through an alternate index path.";
+    return;
+  }
+  // The dataset must be empty to be opened for load:
+  DCHECK(pdata->recbuf_ == nullptr);
+  pdata->recbuf_ = (char *)malloc(reclen_);
+  DCHECK(pdata->recbuf_ != nullptr);
+  pdata->equality_ = __KEY_FIRST;
+  if (FindExecute(pdata, nullptr, 0) != 8) {
+    if (pdata->rc_ == 0) {
+      pdata->errmsg_ = "bulkLoad error: VSAM dataset must be empty.";
+      pdata->rc_ = 1;
+    }
+    return;
+  }
+  pdata->errmsg_ = "";
+  pdata->rc_ = 1;
+
+  std::string dsname = formatDatasetName(path_);
+  fclose(stream_);
+  stream_ = fopen(dsname.c_str(), "wb,type=record");
+  int r15 = R15;
+#ifdef DEBUG
+  fprintf(stderr, "LoadBeginExecute fopen(%s, wb,type=record) returned %p\n",
+          dsname.c_str(), stream_);
+#endif
+  if (stream_ == nullptr) {
+    createErrorMsg(pdata, errno, __errno2(), r15,
+                   "bulkLoad error: fopen() for load failed");
+    stream_ = fopen(dsname.c_str(), omode_.c_str());
+    return;
+  }
+  currecValid_ = false;
+  loadKey_.clear();
+  loadCount_ = 0;
+  pdata->rc_ = 0;
+}
+
+void VsamFile::LoadExecute(UvWorkData *pdata) {
+  DCHECK(pdata->rc_ != 0);
+  DCHECK(pdata->recbuf_ != nullptr);
+  // recbuf_ has count_ records to write in ascending key order
+  size_t nrecs = pdata->count_;
+  const char *recbuf = pdata->recbuf_;
+  for (pdata->count_ = 0; pdata->count_ < nrecs; pdata->count_++) {
+    if (loadCount_ > 0 &&
+        memcmp(recbuf + keypos_, loadKey_.data(), keylen_) <= 0) {
+      pdata->errmsg_ = "bulkLoad error: the key of record " +
+                       std::to_string(loadCount_ + 1) +
+                       " is not greater than the key of the previous record.";
+      return;
+    }
+    if (fwrite(recbuf, 1, reclen_, stream_) != reclen_) {
+      createErrorMsg(pdata, errno, __errno2(), R15,
+                     "bulkLoad error: fwrite() failed");
+      return;
+    }
+    indexAdd(recbuf);
+    loadKey_.assign(recbuf + keypos_, keylen_);
+    loadCount_++;
+    recbuf += reclen_;
+  }
+  pdata->rc_ = 0;
+}
+
+void VsamFile::LoadEndExecute(UvWorkData *pdata) {
+  // reopen the dataset with the mode it was opened with
+  DCHECK(pdata->rc_ != 0);
+  if (stream_ == nullptr) {
+    pdata->errmsg_ = "bulkLoad error: VSAM dataset is not open.";
+    return;
+  }
+  std::string dsname = formatDatasetName(path_);
+  if (fclose(stream_)) {
+    stream_ = nullptr;
+    createErrorMsg(pdata, errno, __errno2(), R15,
+                   "bulkLoad error: fclose() after load failed");
+    return;
+  }
+  stream_ = fopen(dsname.c_str(), omode_.c_str());
+  if (stream_ == nullptr) {
+    createErrorMsg(pdata, errno, __errno2(), R15,
+                   "bulkLoad error: fopen() after load failed");
+    return;
+  }
+  pdata->count_ = loadCount_;
+  pdata->rc_ = 0;
+}
+
+void VsamFile::DeleteRangeExecute(UvWorkData *pdata) {
+  DCHECK(pdata->rc_ != 0);
+  ScanExecute(pdata, "deleteRange",
+              [this](UvWorkData *pdata) { DeleteExecute(pdata); });
+}
+
+void VsamFile::UpdateRangeExecute(UvWorkData *pdata) {
+  DCHECK(pdata->rc_ != 0);
+  DCHECK(pdata->recbuf_ != nullptr);
+  DCHECK(pdata->pFieldsToUpdate_ != nullptr);
+  // recbuf_ contains the fields to update, keep it aside as ScanExecute()
+  // reads each record into its own buffer:
+  char *pupdrecbuf = pdata->recbuf_;
+  pdata->recbuf_ = nullptr;
+
+  ScanExecute(pdata, "updateRange", [this, pupdrecbuf](UvWorkData *pdata) {
+    for (auto i = pdata->pFieldsToUpdate_->begin();
+         i != pdata->pFieldsToUpdate_->end(); ++i)
+      memcpy(pdata->recbuf_ + i->offset, pupdrecbuf + i->offset, i->len);
+    UpdateExecute(pdata);
+  });
+  free(pupdrecbuf);
+}
+
+void VsamFile::AggregateExecute(UvWorkData *pdata) {
+  DCHECK(pdata->rc_ != 0);
+  DCHECK(pdata->pAggregation_ != nullptr);
+  Aggregation &aggr = *pdata->pAggregation_;
+  std::string group;
+
+  ScanExecute(pdata, "aggregate", [this, &aggr, &group](UvWorkData *pdata) {
+    const char *recbuf = pdata->recbuf_;
+    if (aggr.groupBy >= 0) {
+      const LayoutItem &item = layout_[aggr.groupBy];
+      size_t len = item.maxLength;
+      if (item.type == LayoutItem::STRING)
+        len = strnlen(recbuf + item.offset, item.maxLength);
+      group.assign(recbuf + item.offset, len);
+    }
+    Aggregation::Totals &totals = aggr.groups[group];
+    if (totals.count == 0) {
+      totals.sum.resize(aggr.sum.size());
+      totals.min.resize(aggr.min.size());
+      totals.max.resize(aggr.max.size());
+    }
+    for (size_t i = 0; i < aggr.sum.size(); i++)
+      totals.sum[i].add(fieldToInteger(layout_[aggr.sum[i]], recbuf));
+    for (size_t i = 0; i < aggr.min.size(); i++) {
+      uint64_t n = fieldToInteger(layout_[aggr.min[i]], recbuf);
+      if (totals.count == 0 || n < totals.min[i])
+        totals.min[i] = n;
+    }
+    for (size_t i = 0; i < aggr.max.size(); i++) {
+      uint64_t n = fieldToInteger(layout_[aggr.max[i]], recbuf);
+      if (totals.count == 0 || n > totals.max[i])
+        totals.max[i] = n;
+    }
+    totals.count++;
+    pdata->rc_ = 0;
+  });
+}
+
 void VsamFile::ReadExecute(UvWorkData *pdata) {
   DCHECK(pdata->rc_ != 0);
   DCHECK(pdata->recbuf_ == nullptr);
@@ -286,10 +867,13 @@ void VsamFile::DeleteExecute(UvWorkData *pdata) {
   pdata->rc_ = fdelrec(stream_);
   int r15 = R15;
   if (pdata->rc_ != 0) {
-    createErrorMsg(pdata->errmsg_, errno, __errno2(), r15,
+    createErrorMsg(pdata, errno, __errno2(), r15,
                    "delete error: fdelrec() failed");
     return;
   }
+  if (currecValid_)
+    indexRemove(currec_.data());
+  currecValid_ = false;
 #if defined(DEBUG) || defined(DEBUG_CRUD)
   displayRecord(pdata->recbuf_, "fdelrec() in Delete");
 #endif
@@ -325,23 +909,112 @@ void VsamFile::WriteExecute(UvWorkData *pdata) {
 #endif
   size_t nelem = fwrite(pdata->recbuf_, 1, reclen_, stream_);
   int r15 = R15;
+  currecValid_ = false;
 #ifdef DEBUG
   fprintf(stderr, "WriteExecute fwrite() wrote %d bytes, errno=%d, errno2=%d\n",
           nelem, errno, __errno2());
 #endif
   if (nelem != reclen_) {
     if (r15 == 8)
-      createErrorMsg(pdata->errmsg_, errno, __errno2(), r15,
+      createErrorMsg(pdata, errno, __errno2(), r15,
                      "write error: an attempt was made to store a record with "
                      "a duplicate key");
     else
-      createErrorMsg(pdata->errmsg_, errno, __errno2(), r15,
+      createErrorMsg(pdata, errno, __errno2(), r15,
                      "write error: fwrite() failed");
     return;
   }
 #if defined(DEBUG) || defined(DEBUG_CRUD)
   displayRecord(pdata->recbuf_, "fwrite() in Write");
 #endif
+  indexAdd(pdata->recbuf_);
+  pdata->rc_ = 0;
+}
+
+void VsamFile::WriteBatchExecute(UvWorkData *pdata) {
+  DCHECK(pdata->pWriteBatch_ != nullptr);
+  DCHECK(pdata->recbuf_ == nullptr);
+  WriteBatch &batch = *pdata->pWriteBatch_;
+  const std::string &records = pdata->records_;
+  pdata->recbuf_ = (char *)malloc(reclen_);
+  DCHECK(pdata->recbuf_ != nullptr);
+  pdata->count_ = 0;
+  for (size_t r = 0; r < records.length(); r += reclen_) {
+    memcpy(pdata->recbuf_, records.data() + r, reclen_);
+    pdata->rc_ = 1;
+    WriteExecute(pdata);
+    if (pdata->rc_ == 0) {
+      pdata->count_++;
+      continue;
+    }
+    // a failed write doesn't stop the batch, its error is returned by key
+    batch.failedKeys.push_back(std::string(pdata->recbuf_ + keypos_, keylen_));
+    batch.errors.push_back(pdata->errmsg_);
+  }
+  pdata->errmsg_ = "";
+  pdata->rc_ = 0;
+}
+
+void VsamFile::ExecExecute(UvWorkData *pdata) {
+  DCHECK(pdata->pExec_ != nullptr);
+  ExecPipeline &pipeline = *pdata->pExec_;
+  for (auto op = pipeline.ops.begin(); op != pipeline.ops.end(); ++op) {
+    if (isCancelled(pdata)) {
+      // the ops done are returned with the error of the first one not run
+      op->rc = pdata->rc_;
+      op->result = pdata->errmsg_;
+      break;
+    }
+    if (pdata->recbuf_ != nullptr) {
+      free(pdata->recbuf_);
+      pdata->recbuf_ = nullptr;
+    }
+    // the key and fields are the op's, so they're reset before the next op
+    // or the destructor of pdata:
+    pdata->keybuf_ = &op->key[0];
+    pdata->keybuf_len_ = op->key.length();
+    pdata->equality_ = __KEY_EQ;
+    pdata->errmsg_ = "";
+    pdata->rc_ = 1;
+    switch (op->type) {
+    case ExecOp::FIND:
+      FindExecute(pdata);
+      if (pdata->rc_ == 0)
+        op->result.assign(pdata->recbuf_, reclen_);
+      else if (pdata->rc_ == 8)
+        pdata->rc_ = 0; // not an error, the result is null
+      break;
+    case ExecOp::WRITE:
+      pdata->recbuf_ = (char *)malloc(reclen_);
+      DCHECK(pdata->recbuf_ != nullptr);
+      memcpy(pdata->recbuf_, op->record.data(), reclen_);
+      WriteExecute(pdata);
+      break;
+    case ExecOp::UPDATE:
+      pdata->recbuf_ = (char *)malloc(reclen_);
+      DCHECK(pdata->recbuf_ != nullptr);
+      memcpy(pdata->recbuf_, op->record.data(), reclen_);
+      pdata->pFieldsToUpdate_ = &op->fields;
+      FindUpdateExecute(pdata);
+      pdata->pFieldsToUpdate_ = nullptr;
+      op->count = pdata->count_;
+      break;
+    case ExecOp::DELETE:
+      FindDeleteExecute(pdata);
+      op->count = pdata->count_;
+      break;
+    }
+    pdata->keybuf_ = nullptr;
+    pdata->keybuf_len_ = 0;
+    op->rc = pdata->rc_;
+    if (op->rc != 0) {
+      op->result = pdata->errmsg_;
+      if (pipeline.stopOnError)
+        break;
+    }
+  }
+  // the outcome of each op is in pExec_:
+  pdata->errmsg_ = "";
   pdata->rc_ = 0;
 }
 
@@ -354,6 +1027,10 @@ void VsamFile::UpdateExecute(UvWorkData *pdata) {
     fprintf(stderr, "%02x ", pdata->recbuf_[i]);
   fprintf(stderr, "\n");
 #endif
+  // the record as it was, to update the indexes:
+  std::string oldrec;
+  if (!indexes_.empty() && currecValid_)
+    oldrec = currec_;
   size_t nbytes = fupdate(pdata->recbuf_, reclen_, stream_);
   int r15 = R15;
 #ifdef DEBUG
@@ -361,20 +1038,47 @@ void VsamFile::UpdateExecute(UvWorkData *pdata) {
 #endif
   if (nbytes != reclen_) {
     if (r15 == 8)
-      createErrorMsg(pdata->errmsg_, errno, __errno2(), r15,
+      createErrorMsg(pdata, errno, __errno2(), r15,
                      "update error: an attempt was made to store a record with "
                      "a duplicate key");
     else
-      createErrorMsg(pdata->errmsg_, errno, __errno2(), r15,
+      createErrorMsg(pdata, errno, __errno2(), r15,
                      "update error: fupdate() failed");
     return;
   }
+  if (!oldrec.empty())
+    indexRemove(oldrec.data());
+  indexAdd(pdata->recbuf_);
+  currec_.assign(pdata->recbuf_, reclen_);
   pdata->rc_ = 0;
 #if defined(DEBUG) || defined(DEBUG_CRUD)
   displayRecord(pdata->recbuf_, "fupdate() in Update");
 #endif
 }
 
+void VsamFile::UpdateFieldsExecute(UvWorkData *pdata) {
+  DCHECK(pdata->rc_ != 0);
+  DCHECK(pdata->recbuf_ != nullptr);
+  DCHECK(pdata->pFieldsToUpdate_ != nullptr);
+  if (!currecValid_) {
+    pdata->errmsg_ =
+        std::string(pdata->pApiName_ ? pdata->pApiName_ : "update") +
+        " error: no record has been read or found to update.";
+    return;
+  }
+  // recbuf_ contains only the fields to update, merge them into the record
+  // last read:
+  char *pupdrecbuf = pdata->recbuf_;
+  pdata->recbuf_ = (char *)malloc(reclen_);
+  DCHECK(pdata->recbuf_ != nullptr);
+  memcpy(pdata->recbuf_, currec_.data(), reclen_);
+  for (auto i = pdata->pFieldsToUpdate_->begin();
+       i != pdata->pFieldsToUpdate_->end(); ++i)
+    memcpy(pdata->recbuf_ + i->offset, pupdrecbuf + i->offset, i->len);
+  free(pupdrecbuf);
+  UpdateExecute(pdata);
+}
+
 // static
 void VsamFile::DeallocExecute(UvWorkData *pdata) {
   DCHECK(pdata->rc_ != 0);
@@ -389,7 +1093,7 @@ void VsamFile::DeallocExecute(UvWorkData *pdata) {
   fprintf(stderr, "DeallocExecute remove() returned %d\n", pdata->rc_);
 #endif
   if (pdata->rc_ != 0)
-    createErrorMsg(pdata->errmsg_, errno, __errno2(), r15,
+    createErrorMsg(pdata, errno, __errno2(), r15,
                    "dealloc error: remove() failed");
 }
 
@@ -503,10 +1207,10 @@ void VsamFile::alloc(UvWorkData *pdata) {
   dyn.__normdisp = __DISP_CATLG;
   dyn.__lrecl = std::accumulate(
       layout_.begin(), layout_.end(), 0,
-      [](int n, LayoutItem &l) -> int { return n + l.maxLength; });
+      [](int n, const LayoutItem &l) -> int { return n + l.maxLength; });
   dyn.__keyoffset = std::accumulate(
       layout_.begin(), layout_.begin() + key_i_, 0,
-      [](int n, LayoutItem &l) -> int { return n + l.maxLength; });
+      [](int n, const LayoutItem &l) -> int { return n + l.maxLength; });
   dyn.__keylength = layout_[key_i_].maxLength;
   dyn.__recorg = __KS;
   if (dynalloc(&dyn) != 0) {
@@ -538,13 +1242,17 @@ int VsamFile::setKeyRecordLengths(const std::string &errPrefix) {
   fldata(stream_, nullptr, &dinfo);
   keylen_ = dinfo.__vsamkeylen;
   reclen_ = dinfo.__maxreclen;
-  if (keylen_ == layout_[key_i_].maxLength) {
+  if (aixPath_ && dinfo.__vsamtype != __KSDS_PATH &&
+      dinfo.__vsamtype != __ESDS_PATH)
+    errmsg_ = errPrefix + " error: " + path_ +
+              " is not an alternate index path, but the schema has an "
+              "alternateKey.";
+  else if (keylen_ == layout_[key_i_].maxLength)
     return 0;
-  }
-
-  errmsg_ = errPrefix + " error: key length " + std::to_string(keylen_) +
-            " doesn't match length " +
-            std::to_string(layout_[key_i_].maxLength) + " in schema.";
+  else
+    errmsg_ = errPrefix + " error: key length " + std::to_string(keylen_) +
+              " doesn't match length " +
+              std::to_string(layout_[key_i_].maxLength) + " in schema.";
 #ifdef DEBUG
   fprintf(stderr, "%s setKeyRecordLengths %s\nClosing stream %p",
           errPrefix.c_str(), errmsg_.c_str(), stream_);
@@ -555,15 +1263,22 @@ int VsamFile::setKeyRecordLengths(const std::string &errPrefix) {
 }
 
 VsamFile::VsamFile(const std::string &path,
-                   const std::vector<LayoutItem> &layout, int key_i,
-                   size_t keypos, const std::string &omode)
-    : stream_(nullptr),  path_(path), omode_(omode), layout_(layout), rc_(1),
-      key_i_(key_i), keypos_(keypos), keylen_(0) {
+                   const std::shared_ptr<const SchemaLayout> &pSchema,
+                   const std::string &omode, bool direct)
+    : stream_(nullptr), path_(path), omode_(omode), pSchema_(pSchema),
+      layout_(pSchema->layout), rc_(1), key_i_(pSchema->key_i),
+      keypos_(pSchema->keypos), keylen_(0), aixPath_(pSchema->altKey),
+      currecValid_(false), loadCount_(0), workQueued_(0), orphaned_(false),
+      envExited_(false), issuingPriority_(-1), issuingDeadlineMs_(0),
+      handleCursor_(0), streamCursor_(0),
+      direct_(direct), vsamThreadSeq_(0), defaultDeadlineMs_(0) {
 #ifdef DEBUG
   fprintf(stderr, "In VsamFile constructor for %s.\n", path_.c_str());
 #endif
   // open() or alloc() should be called directly by WrappedVsam that created
   // this.
+  if (direct_)
+    return;
   vsamThread_ = std::thread(vsamThread, this, &vsamThreadCV_,
                             &vsamThreadMmutex_, &vsamThreadQueue_);
 }
@@ -572,6 +1287,8 @@ VsamFile::~VsamFile() {
 #ifdef DEBUG
   fprintf(stderr, "~VsamFile: this=%p, stream_=%p.\n", this, stream_);
 #endif
+  for (auto i = indexes_.begin(); i != indexes_.end(); ++i)
+    delete i->second;
   if (stream_ != nullptr) {
 #ifdef DEBUG
     fprintf(stderr, "~VsamFile: fclose(%p)\n", stream_);
@@ -591,7 +1308,7 @@ void VsamFile::Close(UvWorkData *pdata) {
   fprintf(stderr, "Close fclose(%p)\n", stream_);
 #endif
   if (fclose(stream_)) {
-    createErrorMsg(pdata->errmsg_, errno, __errno2(), R15,
+    createErrorMsg(pdata, errno, __errno2(), R15,
                    "close error: fclose() failed");
     return;
   }
@@ -650,6 +1367,132 @@ size_t VsamFile::bufferToHexstr(char *hexstr, size_t hexstrlen,
   return j;
 }
 
+void VsamFile::appendFieldText(std::string &out, const LayoutItem &item,
+                               const char *recbuf) const {
+  // the field's value as a string, as returned in a record object
+  const char *fldbuf = recbuf + item.offset;
+  if (item.type == LayoutItem::STRING) {
+    out.append(fldbuf, strnlen(fldbuf, item.maxLength));
+    return;
+  }
+  char hexstr[(item.maxLength * 2) + 1];
+  bufferToHexstr(hexstr, sizeof(hexstr), fldbuf, item.maxLength);
+  out.append(hexstr);
+}
+
+// static
+void VsamFile::appendJsonString(std::string &out, const char *p, size_t len) {
+  static const char hexdigits[] = "0123456789abcdef";
+  const unsigned char *s = (const unsigned char *)p;
+  out += '"';
+  for (size_t i = 0; i < len;) {
+    unsigned char uc = s[i];
+    if (uc < 0x80) {
+      if (uc == '"' || uc == '\\') {
+        out += '\\';
+        out += (char)uc;
+      } else if (uc < 0x20) {
+        out += "\\u00";
+        out += hexdigits[uc >> 4];
+        out += hexdigits[uc & 0xf];
+      } else
+        out += (char)uc;
+      i++;
+      continue;
+    }
+    // a multi-byte sequence is copied only if it's well-formed: not overlong,
+    // nor a surrogate, nor over U+10FFFF; else its lead byte is replaced
+    size_t n = uc >= 0xc2 && uc <= 0xdf   ? 2
+               : uc >= 0xe0 && uc <= 0xef ? 3
+               : uc >= 0xf0 && uc <= 0xf4 ? 4
+                                          : 0;
+    bool valid = n > 0 && i + n <= len;
+    for (size_t j = 1; valid && j < n; j++)
+      valid = (s[i + j] & 0xc0) == 0x80;
+    if (valid && n > 2) {
+      unsigned char next = s[i + 1];
+      valid = !((uc == 0xe0 && next < 0xa0) || (uc == 0xed && next > 0x9f) ||
+                (uc == 0xf0 && next < 0x90) || (uc == 0xf4 && next > 0x8f));
+    }
+    if (!valid) {
+      out += "\\ufffd";
+      i++;
+      continue;
+    }
+    out.append(p + i, n);
+    i += n;
+  }
+  out += '"';
+}
+
+void VsamFile::appendJson(std::string &out, const char *recbuf,
+                          const std::vector<int> &fields) const {
+  std::string value;
+  out += '{';
+  for (auto f = fields.begin(); f != fields.end(); ++f) {
+    const LayoutItem &item = layout_[*f];
+    if (f != fields.begin())
+      out += ',';
+    appendJsonString(out, item.name.data(), item.name.length());
+    out += ':';
+    value.clear();
+    appendFieldText(value, item, recbuf);
+    appendJsonString(out, value.data(), value.length());
+  }
+  out += '}';
+}
+
+// static
+void VsamFile::appendCsvField(std::string &out, const std::string &value) {
+  if (value.find_first_of(",\"\r\n") == std::string::npos) {
+    out += value;
+    return;
+  }
+  out += '"';
+  for (auto c = value.begin(); c != value.end(); ++c) {
+    if (*c == '"')
+      out += '"';
+    out += *c;
+  }
+  out += '"';
+}
+
+void VsamFile::appendCsv(std::string &out, const char *recbuf,
+                         const std::vector<int> &fields) const {
+  std::string value;
+  for (auto f = fields.begin(); f != fields.end(); ++f) {
+    if (f != fields.begin())
+      out += ',';
+    value.clear();
+    appendFieldText(value, layout_[*f], recbuf);
+    appendCsvField(out, value);
+  }
+}
+
+void VsamFile::appendRaw(std::string &out, const char *recbuf,
+                         const std::vector<int> &fields) const {
+  for (auto f = fields.begin(); f != fields.end(); ++f)
+    out.append(recbuf + layout_[*f].offset, layout_[*f].maxLength);
+}
+
+// static
+uint64_t VsamFile::fieldToInteger(const LayoutItem &item, const char *recbuf) {
+  // unsigned big-endian binary integer over the whole field
+  DCHECK(isNumericField(item));
+  const unsigned char *fld = (const unsigned char *)recbuf + item.offset;
+  uint64_t n = 0;
+  for (size_t i = 0; i < item.maxLength; i++)
+    n = (n << 8) | fld[i];
+  return n;
+}
+
+int VsamFile::getFieldNum(const std::string &name) const {
+  for (size_t i = 0; i < layout_.size(); i++)
+    if (layout_[i].name == name)
+      return i;
+  return -1;
+}
+
 bool VsamFile::isStrValid(const LayoutItem &item, const std::string &str,
                           const std::string &errPrefix, std::string &errmsg) {
   size_t len = str.length();
@@ -740,20 +1583,202 @@ static std::string &createErrorMsg(std::string &errmsg, int err, int err2,
   return errmsg;
 }
 
+static std::string &createErrorMsg(UvWorkData *pdata, int err, int err2,
+                                   int r15, const std::string &errPrefix) {
+  // also keep the error codes for the promise APIs to report
+  pdata->err_ = err;
+  pdata->err2_ = err2;
+  pdata->r15_ = r15;
+  return createErrorMsg(pdata->errmsg_, err, err2, r15, errPrefix);
+}
+
+static int msgPriority(VSAM_THREAD_MSGID msgid) {
+  switch (msgid) {
+  case MSG_LOAD_BEGIN:
+  case MSG_LOAD:
+  case MSG_LOAD_END:
+  case MSG_DELETE_RANGE:
+  case MSG_UPDATE_RANGE:
+  case MSG_AGGREGATE:
+  case MSG_EXPORT:
+  case MSG_SCAN_JSON:
+  case MSG_SCAN_COLUMNS:
+  case MSG_SCAN_BATCH:
+  case MSG_BUILD_INDEX:
+  case MSG_WRITE_BATCH:
+    return PRIORITY_BATCH;
+  case MSG_CLOSE:
+  case MSG_EXIT:
+    return PRIORITY_LAST;
+  default:
+    return PRIORITY_INTERACTIVE;
+  }
+}
+
+// A write-behind batch isn't dropped, as its records were accepted already.
+static bool msgCanExpire(VSAM_THREAD_MSGID msgid) {
+  return msgid != MSG_OPEN && msgid != MSG_CLOSE && msgid != MSG_EXIT &&
+         msgid != MSG_WRITE_BATCH;
+}
+
 int VsamFile::routeToVsamThread(VSAM_THREAD_MSGID msgid,
                                 void (VsamFile::*pWorkFunc)(UvWorkData *),
                                 UvWorkData *pdata) {
+  if (direct_) {
+    // on the calling thread, which is the only one using the dataset
+    useCursor(pdata);
+    (this->*pWorkFunc)(pdata);
+    cursorUsed(pdata);
+    return pdata != nullptr ? pdata->rc_ : rc_;
+  }
   std::condition_variable cv;
   ST_VsamThreadMsg msg = {msgid, cv, pWorkFunc, pdata, -1};
   std::unique_lock<std::mutex> lck(vsamThreadMmutex_);
+  queueVsamThreadMsg(msg);
+  cv.wait(lck, [&msg] { return msg.done; });
+  return msg.rc;
+}
+
+void VsamFile::postToVsamThread(VSAM_THREAD_MSGID msgid,
+                                void (VsamFile::*pWorkFunc)(UvWorkData *),
+                                UvWorkData *pdata) {
+  DCHECK(!direct_ && pdata != nullptr);
+  PostedMsg *pposted = new PostedMsg(msgid, pWorkFunc, pdata);
+  std::unique_lock<std::mutex> lck(vsamThreadMmutex_);
+  posted_[pdata] = pposted;
+  queueVsamThreadMsg(pposted->msg);
+}
+
+int VsamFile::waitForVsamThread(UvWorkData *pdata) {
+  std::unique_lock<std::mutex> lck(vsamThreadMmutex_);
+  auto i = posted_.find(pdata);
+  if (i == posted_.end())
+    return pdata->rc_;
+  PostedMsg *pposted = i->second;
+  posted_.erase(i);
+  pposted->cv.wait(lck, [pposted] { return pposted->msg.done; });
+  int rc = pposted->msg.rc;
+  delete pposted;
+  return rc;
+}
+
+void VsamFile::queueVsamThreadMsg(ST_VsamThreadMsg &msg) {
+  UvWorkData *pdata = msg.pdata;
+  VSAM_THREAD_MSGID msgid = msg.msgid;
+  // only a class given to the request serves it ahead of those queued before
+  // it, and the others are served in order, except close and exit:
+  if (pdata != nullptr && pdata->priority_ >= 0) {
+    msg.priority = msg.statsClass = pdata->priority_;
+  } else {
+    msg.statsClass = msgPriority(msgid);
+    msg.priority = msg.statsClass == PRIORITY_LAST ? PRIORITY_LAST
+                                                   : PRIORITY_INTERACTIVE;
+  }
+  unsigned deadlineMs = 0;
+  if (pdata != nullptr && msgCanExpire(msgid))
+    deadlineMs = pdata->deadlineMs_ > 0 ? pdata->deadlineMs_
+                                        : defaultDeadlineMs_;
+  msg.deadline = deadlineMs > 0
+                     ? pdata->issued_ + std::chrono::milliseconds(deadlineMs)
+                     : std::chrono::steady_clock::time_point::max();
+  msg.queued = std::chrono::steady_clock::now();
+  msg.seq = vsamThreadSeq_++;
+  msg.done = false;
   vsamThreadQueue_.push(&msg);
   vsamThreadCV_.notify_one();
-  cv.wait(lck);
-  return msg.rc;
+}
+
+bool VsamFile::isCancelled(UvWorkData *pdata) {
+  if (pdata->pCancel_ == nullptr || !pdata->pCancel_->cancelled)
+    return false;
+  pdata->errmsg_ = "cancel error: the request " + pdata->pCancel_->reason + ".";
+  pdata->rc_ = 1;
+  return true;
+}
+
+void VsamFile::useCursor(UvWorkData *pdata) {
+  CursorState *pcursor = pdata != nullptr && pdata->pCursor_ != nullptr
+                             ? pdata->pCursor_.get()
+                             : &handleCursor_;
+  if (pcursor->id == streamCursor_ || stream_ == nullptr)
+    return;
+  // the record last read by the handle is for its update() and delete(), and
+  // is kept aside while the cursors use the stream
+  if (streamCursor_ == 0) {
+    handleCursor_.currec.swap(currec_);
+    handleCursor_.currecValid = currecValid_;
+  }
+  currecValid_ = false;
+  if (pcursor == &handleCursor_ && handleCursor_.currecValid) {
+    // fupdate() and fdelrec() need the record to be the last one read, so
+    // it's read again, which also positions the stream after it
+    currec_.swap(handleCursor_.currec);
+    if (flocate(stream_, currec_.data() + keypos_, keylen_, __KEY_EQ) == 0 &&
+        fread(&currec_[0], 1, reclen_, stream_) > 0) {
+      currecValid_ = true;
+      streamCursor_ = 0;
+      return;
+    }
+  }
+  if (pcursor->positioned) {
+    if (fsetpos(stream_, &pcursor->pos) != 0)
+      pcursor->positioned = false;
+  } else if (pcursor != &handleCursor_) {
+    // a new cursor starts at the first record
+    flocate(stream_, nullptr, 0, __KEY_FIRST);
+  }
+  streamCursor_ = pcursor->id;
+}
+
+void VsamFile::cursorUsed(UvWorkData *pdata) {
+  CursorState *pcursor = pdata != nullptr && pdata->pCursor_ != nullptr
+                             ? pdata->pCursor_.get()
+                             : &handleCursor_;
+  // fgetpos() doesn't do I/O, so it's cheaper than a flocate() to restore it
+  pcursor->positioned =
+      stream_ != nullptr && fgetpos(stream_, &pcursor->pos) == 0;
+  streamCursor_ = pcursor->id;
+}
+
+bool VsamFile::dequeued(ST_VsamThreadMsg *pmsg) {
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (pmsg->statsClass >= PRIORITY_CLASSES)
+    return false;
+  QueueStats &stats = queueStats_[pmsg->statsClass];
+  double waitMs =
+      std::chrono::duration<double, std::milli>(now - pmsg->queued).count();
+  stats.count++;
+  stats.totalWaitMs += waitMs;
+  if (waitMs > stats.maxWaitMs)
+    stats.maxWaitMs = waitMs;
+  // a request cancelled while queued isn't started:
+  if (pmsg->pdata != nullptr && isCancelled(pmsg->pdata))
+    return true;
+  if (now < pmsg->deadline)
+    return false;
+  stats.expired++;
+  pmsg->pdata->errmsg_ =
+      "timeout error: the deadline passed after waiting " +
+      std::to_string((long)waitMs) + " ms for the dataset's I/O thread.";
+  pmsg->pdata->rc_ = 1;
+  return true;
+}
+
+void VsamFile::setDefaultDeadline(unsigned ms) {
+  std::unique_lock<std::mutex> lck(vsamThreadMmutex_);
+  defaultDeadlineMs_ = ms;
+}
+
+void VsamFile::getQueueStats(QueueStats stats[PRIORITY_CLASSES],
+                             size_t *pdepth) {
+  std::unique_lock<std::mutex> lck(vsamThreadMmutex_);
+  for (int c = 0; c < PRIORITY_CLASSES; c++)
+    stats[c] = queueStats_[c];
+  *pdepth = vsamThreadQueue_.size();
 }
 
 int VsamFile::exitVsamThread() {
-  if (getVsamThreadId() == 0) {
+  if (direct_ || getVsamThreadId() == 0) {
 #ifdef DEBUG
     fprintf(stderr, "exitVsamThread thread id is 0, nothing to do.\n");
 #endif
@@ -769,9 +1794,14 @@ int VsamFile::exitVsamThread() {
   std::condition_variable cv;
   ST_VsamThreadMsg msg = {MSG_EXIT, cv, nullptr, nullptr, -1};
   std::unique_lock<std::mutex> lck(vsamThreadMmutex_);
+  msg.priority = msg.statsClass = PRIORITY_LAST;
+  msg.deadline = std::chrono::steady_clock::time_point::max();
+  msg.queued = std::chrono::steady_clock::now();
+  msg.seq = vsamThreadSeq_++;
+  msg.done = false;
   vsamThreadQueue_.push(&msg);
   vsamThreadCV_.notify_one();
-  cv.wait(lck);
+  cv.wait(lck, [&msg] { return msg.done; });
   if (vsamThread_.joinable()) {
 #ifdef DEBUG
     fprintf(stderr, "exitVsamThread calling join() on thread %d...",
@@ -6,10 +6,19 @@
  */
 
 #pragma once
+#include "FieldIndex.h"
 #include <napi.h>
+#include <uv.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
 #include <queue>
 #include <string>
 #include <thread>
+#include <unordered_map>
 
 #ifdef DEBUG
 #define DCHECK_WITH_MSG(condition, message)                                    \
@@ -34,8 +43,19 @@ struct LayoutItem {
   size_t minLength;
   size_t maxLength;
   DataType type;
-  LayoutItem(std::string &n, size_t mn, size_t mx, DataType t)
-      : name(n), minLength(mn), maxLength(mx), type(t) {}
+  size_t offset; // of the field in the record
+  LayoutItem(std::string &n, size_t mn, size_t mx, DataType t, size_t ofs)
+      : name(n), minLength(mn), maxLength(mx), type(t), offset(ofs) {}
+};
+
+// A schema parsed once, by compileSchema() or by the open of a dataset, and
+// shared by the datasets opened with it; it's never changed once parsed.
+struct SchemaLayout {
+  std::vector<LayoutItem> layout;
+  int key_i;
+  int keypos;
+  bool altKey; // the key is the alternate key of a path
+  SchemaLayout() : key_i(0), keypos(0), altKey(false) {}
 };
 
 struct FieldToUpdate {
@@ -51,10 +71,235 @@ struct FieldToUpdate {
 #endif
 };
 
+// A comparison of a record field against a value, evaluated natively for
+// each record visited by the range APIs; both sides are compared as raw bytes
+// over the field's maxLength, i.e. in the same order as VSAM orders keys.
+struct RecordFilter {
+  enum Op { EQ, NE, LT, LE, GT, GE };
+
+  size_t offset;
+  size_t len;
+  Op op;
+  std::string value; // field bytes, padded with 0x00 up to len
+  RecordFilter(size_t ofs, size_t len, Op op, const std::string &val)
+      : offset(ofs), len(len), op(op), value(val) {}
+
+  bool matches(const char *recbuf) const {
+    int c = memcmp(recbuf + offset, value.data(), len);
+    switch (op) {
+    case EQ: return c == 0;
+    case NE: return c != 0;
+    case LT: return c < 0;
+    case LE: return c <= 0;
+    case GT: return c > 0;
+    case GE: return c >= 0;
+    }
+    return false;
+  }
+};
+
+// Records to visit in a range API: all records whose key is >= from and whose
+// initial key bytes are <= to, that satisfy all filters.
+struct ScanRange {
+  std::string from; // empty to start at the first record
+  std::string to;   // empty to stop at the last record
+  std::vector<RecordFilter> filters;
+  size_t maxCount; // 0 for no limit
+  // for scanPage(), the number of records with the key from, that satisfy the
+  // filters, which are skipped as they were in the previous page (more than 1
+  // for the duplicates of a non-unique alternate key)
+  size_t afterCount;
+  ScanRange() : maxCount(0), afterCount(0) {}
+
+  bool matches(const char *recbuf) const {
+    for (auto f = filters.begin(); f != filters.end(); ++f)
+      if (!f->matches(recbuf))
+        return false;
+    return true;
+  }
+};
+
+// Accumulators for aggregate(), filled on the VSAM thread; the layout indexes
+// in sum, min and max must refer to numeric fields (see isNumericField()).
+struct Aggregation {
+  // a sum of the 64-bit values of a field, exact in 128 bits
+  struct Sum {
+    uint64_t low, high;
+    Sum() : low(0), high(0) {}
+    void add(uint64_t n) { high += (low += n) < n; }
+  };
+  struct Totals {
+    size_t count;
+    std::vector<Sum> sum;
+    std::vector<uint64_t> min, max;
+    Totals() : count(0) {}
+  };
+
+  int groupBy; // layout index of the group-by field, or -1
+  std::vector<int> sum, min, max;
+  std::unordered_map<std::string, Totals> groups; // single "" group if no groupBy
+  Aggregation() : groupBy(-1) {}
+};
+
+struct UvWorkData;
+
+// Output of exportTo(), written on the VSAM thread; progress is called from
+// there through a thread-safe function, null if no progress callback.
+struct RecordExport {
+  enum Format { NDJSON, RAW, CSV, SNAPSHOT };
+  // data of a call to progress, pdata is set for the final one
+  struct Progress {
+    size_t count;
+    UvWorkData *pdata;
+  };
+
+  Format format;
+  std::vector<int> fields; // layout indexes of the fields to write
+  std::string path;
+  std::string output; // for scanJson(), the JSON array instead of a file
+  napi_threadsafe_function progress;
+  RecordExport() : format(NDJSON), progress(nullptr) {}
+};
+
+// Header of a snapshotTo() file, stored big-endian so that the file can be
+// read on any platform. It's followed by a (type, maxLength) pair of 32-bit
+// integers for each field of the layout, then by the records in key order.
+struct SnapshotHeader {
+  static const size_t SIZE = 64;
+  static const uint32_t VERSION = 1;
+
+  uint32_t nfields;
+  uint32_t reclen;
+  uint32_t keypos;
+  uint32_t keylen;
+  uint64_t count; // of records
+  SnapshotHeader() : nfields(0), reclen(0), keypos(0), keylen(0), count(0) {}
+
+  size_t recordOffset() const { return SIZE + nfields * 8; }
+  void encode(std::string &out, const std::vector<LayoutItem> &layout) const;
+  // Returns false if buf isn't a snapshot or doesn't match layout
+  bool decode(const char *buf, size_t len,
+              const std::vector<LayoutItem> &layout);
+};
+
+// Columns of scanColumns(), filled on the VSAM thread: a numeric field (see
+// isNumericField()) is stored by value, in the narrowest type that holds all
+// its values exactly; any other field is stored as its bytes, with offsets.
+struct RecordColumns {
+  struct Column {
+    enum Type { UINT32, FLOAT64, BIGUINT64, BYTES };
+
+    int field; // layout index
+    Type type;
+    std::vector<uint32_t> u32; // UINT32 values, or BYTES offsets into bytes
+    std::vector<double> f64;
+    std::vector<uint64_t> u64;
+    std::string bytes;
+    Column(int fld, Type t) : field(fld), type(t) {}
+  };
+
+  std::vector<Column> columns;
+  size_t length; // number of records
+  RecordColumns() : length(0) {}
+};
+
+// Request of buildIndex(), findBy() or indexStats() on the index of a field;
+// the statistics of the index are set on return.
+struct IndexRequest {
+  int field;         // layout index
+  std::string value; // for findBy(), padded with 0x00 to the field's maxLength
+  size_t keys, values, memoryUsage;
+  IndexRequest() : field(-1), keys(0), values(0), memoryUsage(0) {}
+};
+
+// A batch of write-behind records, written in key order by the VSAM thread;
+// the records are in UvWorkData::records_, and those that couldn't be written
+// are returned with their error.
+struct WriteBatch {
+  void *pOwner; // the WrappedVsam, referenced until the batch is complete
+  std::vector<std::string> failedKeys, errors;
+  WriteBatch(void *powner) : pOwner(powner) {}
+};
+
+// An operation of exec(), encoded before it's run by the VSAM thread, and its
+// outcome:
+struct ExecOp {
+  enum Type { FIND, WRITE, UPDATE, DELETE } type;
+  std::string key;                   // of FIND, UPDATE and DELETE
+  std::string record;                // of WRITE, or the fields of UPDATE
+  std::vector<FieldToUpdate> fields; // of UPDATE
+  int rc;                            // 0 if done, -1 if not run
+  size_t count;       // of records updated or deleted
+  std::string result; // the record found, or the error if rc isn't 0
+  ExecOp(Type t) : type(t), rc(-1), count(0) {}
+};
+
+struct ExecPipeline {
+  std::vector<ExecOp> ops;
+  bool stopOnError;
+  ExecPipeline() : stopOnError(true) {}
+};
+
+// Priority classes of the messages to the VSAM thread: a request is only
+// served ahead of those queued before it if it's given a higher class, as
+// the messages are otherwise served in order of arrival. The time in queue
+// is reported by class, by default interactive for point operations and
+// batch for those over many records; close and exit are served after any
+// other message queued.
+enum VsamPriority {
+  PRIORITY_INTERACTIVE,
+  PRIORITY_BATCH,
+  PRIORITY_CLASSES,
+  PRIORITY_LAST = PRIORITY_CLASSES
+};
+
+// Time spent by the messages of a priority class in the VSAM thread's queue:
+struct QueueStats {
+  size_t count, expired;
+  double totalWaitMs, maxWaitMs;
+  QueueStats() : count(0), expired(0), totalWaitMs(0), maxWaitMs(0) {}
+};
+
+// The async requests on a dataset issued and not complete, limited by
+// setMaxInFlight(); those over the limit wait if wait is true, otherwise they
+// fail as busy. Only used by the main thread.
+struct InFlightLimit {
+  size_t count, max; // max is 0 if there's no limit
+  bool wait;
+  std::deque<uv_work_t *> waiting;
+  InFlightLimit() : count(0), max(0), wait(false) {}
+};
+
+// Cancellation of the async requests issued with an AbortSignal or a timeout:
+// set by the main thread, and checked by the VSAM thread before a request is
+// started and between the records it reads.
+struct CancelState {
+  std::atomic<bool> cancelled;
+  std::string reason; // set before cancelled
+  std::vector<uv_work_t *> requests; // not complete, only used by main thread
+  CancelState() : cancelled(false) {}
+};
+
+// The position of a cursor of openCursor() in the dataset, or that of the
+// dataset handle itself (id 0); only used by the VSAM thread once created.
+struct CursorState {
+  unsigned long id;
+  fpos_t pos;
+  bool positioned; // pos is valid
+  // the handle's record last read, kept while a cursor uses the stream:
+  std::string currec;
+  bool currecValid;
+  CursorState(unsigned long i) : id(i), positioned(false), currecValid(false) {}
+};
+
 class VsamFile;
 
 // This is the 'data' member in uv_work_t request:
 struct UvWorkData {
+  // A key of up to this length, i.e. any VSAM key, is stored in the request
+  // itself rather than in a malloc'd buffer:
+  static const size_t KEY_INLINE_SIZE = 256;
+
   UvWorkData(VsamFile *pVsamFile, Napi::Function cbfunc, Napi::Env env,
              const std::string &path = "", char *recbuf = nullptr,
              char *keybuf = nullptr, size_t keybuf_len = 0, int equality = 0,
@@ -62,14 +307,20 @@ struct UvWorkData {
       : pVsamFile_(pVsamFile), cb_(Napi::Persistent(cbfunc)), env_(env),
         path_(path), recbuf_(recbuf), keybuf_(keybuf), keybuf_len_(keybuf_len),
         equality_(equality), pFieldsToUpdate_(pFieldsToUpdate), rc_(1),
-        count_(1) {}
+        count_(1), err_(0), err2_(0), r15_(0), pScanRange_(nullptr),
+        pAggregation_(nullptr), pExport_(nullptr), pColumns_(nullptr),
+        pIndex_(nullptr), pWriteBatch_(nullptr), pExec_(nullptr),
+        priority_(-1), deadlineMs_(0),
+        issued_(std::chrono::steady_clock::now()), pExecute_(nullptr),
+        pComplete_(nullptr), deferred_(nullptr), pOwner_(nullptr),
+        pApiName_(nullptr) {}
 
   ~UvWorkData() {
     if (recbuf_) {
       free(recbuf_);
       recbuf_ = nullptr;
     }
-    if (keybuf_) {
+    if (keybuf_ && keybuf_ != keyInline_) {
       free(keybuf_);
       keybuf_ = nullptr;
     }
@@ -77,6 +328,44 @@ struct UvWorkData {
       delete pFieldsToUpdate_;
       pFieldsToUpdate_ = nullptr;
     }
+    if (pScanRange_) {
+      delete pScanRange_;
+      pScanRange_ = nullptr;
+    }
+    if (pAggregation_) {
+      delete pAggregation_;
+      pAggregation_ = nullptr;
+    }
+    if (pExport_) {
+      delete pExport_;
+      pExport_ = nullptr;
+    }
+    if (pColumns_) {
+      delete pColumns_;
+      pColumns_ = nullptr;
+    }
+    if (pIndex_) {
+      delete pIndex_;
+      pIndex_ = nullptr;
+    }
+    if (pWriteBatch_) {
+      delete pWriteBatch_;
+      pWriteBatch_ = nullptr;
+    }
+    if (pExec_) {
+      delete pExec_;
+      pExec_ = nullptr;
+    }
+    for (auto i = followers_.begin(); i != followers_.end(); ++i)
+      delete *i;
+  }
+
+  void setKey(const char *key, size_t len) {
+    DCHECK(keybuf_ == nullptr);
+    keybuf_ = len <= KEY_INLINE_SIZE ? keyInline_ : (char *)malloc(len);
+    DCHECK(keybuf_ != nullptr);
+    memcpy(keybuf_, key, len);
+    keybuf_len_ = len;
   }
 
   VsamFile *pVsamFile_;
@@ -84,13 +373,37 @@ struct UvWorkData {
   Napi::Env env_;
   std::string path_;
   char *recbuf_;
-  char *keybuf_;
+  char *keybuf_; // keyInline_, malloc'd, or borrowed by exec()
   size_t keybuf_len_;
+  char keyInline_[KEY_INLINE_SIZE];
   int equality_;
   std::vector<FieldToUpdate> *pFieldsToUpdate_;
   int rc_;
   size_t count_; // of records updated or deleted to report back
   std::string errmsg_;
+  int err_, err2_, r15_; // errno, __errno2() and R15 of the failed I/O, if any
+  ScanRange *pScanRange_;
+  Aggregation *pAggregation_;
+  RecordExport *pExport_;
+  RecordColumns *pColumns_;
+  IndexRequest *pIndex_;
+  WriteBatch *pWriteBatch_;
+  ExecPipeline *pExec_;
+  // callbacks of identical finds issued while this one was in flight:
+  std::vector<Napi::FunctionReference *> followers_;
+  int priority_;        // VsamPriority, or -1 for that of the message
+  unsigned deadlineMs_; // after issued_ to start, or 0 for the default
+  std::chrono::steady_clock::time_point issued_;
+  // of the async request, for WrappedVsam::queueWork():
+  uv_work_cb pExecute_;
+  uv_after_work_cb pComplete_;
+  std::shared_ptr<CancelState> pCancel_; // null if it can't be cancelled
+  std::shared_ptr<CursorState> pCursor_; // null for the dataset handle
+  std::string records_; // of scanBatch() or findAll(), one after the other
+  napi_deferred deferred_; // for a promise API, instead of cb_
+  void *pOwner_; // the WrappedVsam of openAsync() or closeAsync(), referenced
+                 // until it's complete
+  const char *pApiName_; // of the errors set on the VSAM thread, if not fixed
 };
 
 typedef enum {
@@ -103,6 +416,23 @@ typedef enum {
   MSG_FIND,
   MSG_FIND_UPDATE,
   MSG_FIND_DELETE,
+  MSG_LOAD_BEGIN,
+  MSG_LOAD,
+  MSG_LOAD_END,
+  MSG_DELETE_RANGE,
+  MSG_UPDATE_RANGE,
+  MSG_AGGREGATE,
+  MSG_EXPORT,
+  MSG_SCAN_JSON,
+  MSG_SCAN_COLUMNS,
+  MSG_SCAN_BATCH,
+  MSG_FIND_ALL,
+  MSG_BUILD_INDEX,
+  MSG_FIND_BY,
+  MSG_INDEX_STATS,
+  MSG_WRITE_BATCH,
+  MSG_EXEC,
+  MSG_SCAN_PAGE,
   MSG_EXIT
 } VSAM_THREAD_MSGID;
 
@@ -112,22 +442,90 @@ typedef struct {
   void (VsamFile::*pWorkFunc)(UvWorkData *);
   UvWorkData *pdata;
   int rc;
+  int priority;                                   // VsamPriority to serve it
+  int statsClass;                                 // VsamPriority of its stats
+  std::chrono::steady_clock::time_point deadline; // max() if none
+  std::chrono::steady_clock::time_point queued;
+  unsigned long seq; // order of arrival
+  bool done;
 } ST_VsamThreadMsg;
 
+// The VSAM thread serves its messages by priority class, then order of
+// arrival; a deadline only drops a message that waited past it, so that the
+// requests of a class are done in the order they were issued:
+struct VsamThreadMsgOrder {
+  bool operator()(const ST_VsamThreadMsg *a, const ST_VsamThreadMsg *b) const {
+    if (a->priority != b->priority)
+      return a->priority > b->priority;
+    return a->seq > b->seq;
+  }
+};
+typedef std::priority_queue<ST_VsamThreadMsg *,
+                            std::vector<ST_VsamThreadMsg *>, VsamThreadMsgOrder>
+    VsamThreadQueue;
+
+// A message queued by postToVsamThread(), which outlives the call:
+struct PostedMsg {
+  std::condition_variable cv;
+  ST_VsamThreadMsg msg;
+  PostedMsg(VSAM_THREAD_MSGID msgid, void (VsamFile::*pWorkFunc)(UvWorkData *),
+            UvWorkData *pdata)
+      : msg{msgid, cv, pWorkFunc, pdata, -1} {}
+};
+
 class VsamFile {
 public:
-  VsamFile(const std::string &path, const std::vector<LayoutItem> &layout,
-           int key_i, size_t keypos, const std::string &omode);
+  VsamFile(const std::string &path,
+           const std::shared_ptr<const SchemaLayout> &pSchema,
+           const std::string &omode, bool direct = false);
   ~VsamFile();
 
   int getKeyNum() const { return key_i_; }
   size_t getRecordLength() const { return reclen_; }
+  size_t getKeyPosition() const { return keypos_; }
+  size_t getKeyLength() const { return keylen_; }
+  std::map<std::string, UvWorkData *> &getPendingFinds() {
+    return pendingFinds_;
+  }
+  // Called when a request that can change records is issued: the finds in
+  // flight can't be shared by those issued after it.
+  void fencePendingFinds() { pendingFinds_.clear(); }
+  InFlightLimit &getInFlight() { return inFlight_; }
+  // The uv requests queued on this object and not complete yet: it's only
+  // deleted once they're all complete, see WrappedVsam::workDone().
+  void workQueued() { workQueued_++; }
+  size_t getWorkQueued() const { return workQueued_; }
+  // returns true if it was the last request of an orphaned object
+  bool workComplete() { return --workQueued_ == 0 && orphaned_; }
+  // envExited is true if its environment exited, with the callbacks and
+  // promises of its requests
+  void orphan(bool envExited) {
+    orphaned_ = true;
+    envExited_ = envExited;
+  }
+  bool isEnvExited() const { return envExited_; }
+  // the cancellation of the async requests being issued, if any
+  std::shared_ptr<CancelState> &getIssuingCancel() { return issuingCancel_; }
+  // the { priority, deadline } options of the async call being issued, set
+  // by index.js around it
+  void setIssuingQueue(int priority, unsigned deadlineMs) {
+    issuingPriority_ = priority;
+    issuingDeadlineMs_ = deadlineMs;
+  }
+  int getIssuingPriority() const { return issuingPriority_; }
+  unsigned getIssuingDeadline() const { return issuingDeadlineMs_; }
+  // the cursor whose requests are being issued, if any
+  std::shared_ptr<CursorState> &getIssuingCursor() { return issuingCursor_; }
   int getLastError(std::string &errmsg) const {
     errmsg = errmsg_;
     return rc_;
   }
-  std::vector<LayoutItem> &getLayout() { return layout_; }
+  const std::vector<LayoutItem> &getLayout() const { return layout_; }
+  int getFieldNum(const std::string &name) const;
   bool isDatasetOpen() const { return (stream_ != nullptr); }
+  // opened with {direct: true}: the I/O is done on the calling thread, which
+  // is only allowed for the sync APIs
+  bool isDirect() const { return direct_; }
   bool isReadOnly() const {
     const char *omode = omode_.c_str();
     if (strchr(omode, 'w') || strchr(omode, 'a') || strchr(omode, '+'))
@@ -147,6 +545,10 @@ public:
   static size_t hexstrToBuffer(char *hexbuf, size_t buflen, const char *hexstr);
   static size_t bufferToHexstr(char *hexstr, size_t hexstrlen, const char *hexbuf,
                             size_t hexbuflen);
+  static bool isNumericField(const LayoutItem &item) {
+    return item.type == LayoutItem::HEXADECIMAL && item.maxLength <= 8;
+  }
+  static uint64_t fieldToInteger(const LayoutItem &item, const char *recbuf);
 
   /* static because WrappedVsam::Close() delete its VsamFile object */
   static void DeallocExecute(UvWorkData *pdata);
@@ -163,42 +565,132 @@ public:
   void FindUpdateExecute(UvWorkData *pdata);
   void FindDeleteExecute(UvWorkData *pdata);
   void UpdateExecute(UvWorkData *pdata);
+  void UpdateFieldsExecute(UvWorkData *pdata);
   void WriteExecute(UvWorkData *pdata);
   void DeleteExecute(UvWorkData *pdata);
+  void LoadBeginExecute(UvWorkData *pdata);
+  void LoadExecute(UvWorkData *pdata);
+  void LoadEndExecute(UvWorkData *pdata);
+  void DeleteRangeExecute(UvWorkData *pdata);
+  void UpdateRangeExecute(UvWorkData *pdata);
+  void AggregateExecute(UvWorkData *pdata);
+  void ExportExecute(UvWorkData *pdata);
+  void ScanJsonExecute(UvWorkData *pdata);
+  void FindJsonExecute(UvWorkData *pdata);
+  void ScanColumnsExecute(UvWorkData *pdata);
+  void ScanBatchExecute(UvWorkData *pdata);
+  void ScanPageExecute(UvWorkData *pdata);
+  void FindAllExecute(UvWorkData *pdata);
+  void BuildIndexExecute(UvWorkData *pdata);
+  void FindByExecute(UvWorkData *pdata);
+  void IndexStatsExecute(UvWorkData *pdata);
+  void WriteBatchExecute(UvWorkData *pdata);
+  void ExecExecute(UvWorkData *pdata);
+
+  /* Serialize the given fields of a record, appending to out */
+  void appendJson(std::string &out, const char *recbuf,
+                  const std::vector<int> &fields) const;
+  void appendCsv(std::string &out, const char *recbuf,
+                 const std::vector<int> &fields) const;
+  void appendRaw(std::string &out, const char *recbuf,
+                 const std::vector<int> &fields) const;
 
   int routeToVsamThread(VSAM_THREAD_MSGID msgid,
                         void (VsamFile::*pWorkFunc)(UvWorkData *),
                         UvWorkData *pdata = nullptr);
+  // Queues the message without waiting for it, so that it's served before
+  // those routed after the call; waitForVsamThread(pdata) then waits for it
+  // to be done and returns its rc.
+  void postToVsamThread(VSAM_THREAD_MSGID msgid,
+                        void (VsamFile::*pWorkFunc)(UvWorkData *),
+                        UvWorkData *pdata);
+  int waitForVsamThread(UvWorkData *pdata);
   void detachVsamThread() { vsamThread_.detach(); }
+  // called by the VSAM thread, with the queue locked, for the message taken
+  // from the queue; returns true if it's cancelled or its deadline has passed
+  bool dequeued(ST_VsamThreadMsg *pmsg);
+  // returns true, with the error set, if the request is cancelled
+  bool isCancelled(UvWorkData *pdata);
+  // called by the VSAM thread before and after a request, to restore the
+  // position of its cursor if another one used the stream last, then save it
+  void useCursor(UvWorkData *pdata);
+  void cursorUsed(UvWorkData *pdata);
+  void setDefaultDeadline(unsigned ms);
+  // on the main thread, which is the one setting it
+  unsigned getDefaultDeadline() const { return defaultDeadlineMs_; }
+  void getQueueStats(QueueStats stats[PRIORITY_CLASSES], size_t *pdepth);
   int exitVsamThread();
   int getVsamThreadId() { return vsamThread_.native_handle().__ & 0x7fffffff; }
 
 private:
+  // with the queue locked:
+  void queueVsamThreadMsg(ST_VsamThreadMsg &msg);
   int setKeyRecordLengths(const std::string &errPrefix);
   int FindExecute(UvWorkData *pdata, const char *buf, int buflen);
   void displayRecord(const char *recbuf, const char *pPrefix);
   int freadRecord(UvWorkData *pdata, int *pr15, bool expectEOF,
                    const char *pDisplayPrefix, const char *pErrPrefix);
+  int ScanExecute(UvWorkData *pdata, const char *pApiName,
+                  const std::function<void(UvWorkData *)> &visit);
+  void indexAdd(const char *recbuf);
+  void indexRemove(const char *recbuf);
+  void appendFieldText(std::string &out, const LayoutItem &item,
+                       const char *recbuf) const;
+  // a JSON string, with any byte that isn't valid UTF-8 replaced by U+FFFD
+  static void appendJsonString(std::string &out, const char *p, size_t len);
+  // a CSV field, quoted if it has a comma, a quote or a line break
+  static void appendCsvField(std::string &out, const std::string &value);
 
 private:
   FILE *stream_;
   std::string path_;
   std::string omode_;
-  std::vector<LayoutItem> layout_;
+  std::shared_ptr<const SchemaLayout> pSchema_;
+  const std::vector<LayoutItem> &layout_; // of pSchema_
   int rc_;
   std::string errmsg_;
   int key_i_;
   size_t keypos_;
   size_t keylen_, reclen_;
+  bool aixPath_; // opened through an alternate index path, key_i_ is its key
+  // the record last read or found, for merging a partial update into:
+  std::string currec_;
+  bool currecValid_;
+  // for bulkLoad(), the key of the last record loaded and number of records:
+  std::string loadKey_;
+  size_t loadCount_;
+  // indexes of buildIndex() by layout index, updated by writes and deletes
+  std::map<int, FieldIndex *> indexes_;
+  // the findeq and findge in flight by equality and key, for single-flight;
+  // only used by the main thread
+  std::map<std::string, UvWorkData *> pendingFinds_;
+  InFlightLimit inFlight_; // only used by the main thread
+  size_t workQueued_;       // only used by the main thread
+  bool orphaned_; // no longer referenced by its WrappedVsam, see orphan()
+  bool envExited_;
+  std::shared_ptr<CancelState> issuingCancel_; // only used by the main thread
+  int issuingPriority_;        // only used by the main thread
+  unsigned issuingDeadlineMs_; // only used by the main thread
+  std::shared_ptr<CursorState> issuingCursor_; // only used by the main thread
+  // only used by the VSAM thread: the handle's own position, and the id of
+  // the cursor, or 0 for the handle, that used the stream last
+  CursorState handleCursor_;
+  unsigned long streamCursor_;
 #ifdef DEBUG_CRUD
   // to read the record before delete((err)) for display
   fpos_t freadpos_; // =fgetpos() before fread()
 #endif
 
 private:
+  bool direct_; // no VSAM thread, see isDirect()
   // These are used only if dataset is opened in read/write mode:
   std::thread vsamThread_;
   std::condition_variable vsamThreadCV_;
   std::mutex vsamThreadMmutex_;
-  std::queue<ST_VsamThreadMsg *> vsamThreadQueue_;
+  VsamThreadQueue vsamThreadQueue_;
+  // guarded by vsamThreadMmutex_:
+  unsigned long vsamThreadSeq_;
+  unsigned defaultDeadlineMs_;
+  QueueStats queueStats_[PRIORITY_CLASSES];
+  std::map<UvWorkData *, PostedMsg *> posted_;
 };
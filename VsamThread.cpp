@@ -21,6 +21,23 @@ static const char *getMessageStr(VSAM_THREAD_MSGID msgid) {
   case MSG_READ: return "READ";
   case MSG_FIND_UPDATE: return "FIND_UPDATE";
   case MSG_FIND_DELETE: return "FIND_DELETE";
+  case MSG_LOAD_BEGIN: return "LOAD_BEGIN";
+  case MSG_LOAD: return "LOAD";
+  case MSG_LOAD_END: return "LOAD_END";
+  case MSG_DELETE_RANGE: return "DELETE_RANGE";
+  case MSG_UPDATE_RANGE: return "UPDATE_RANGE";
+  case MSG_AGGREGATE: return "AGGREGATE";
+  case MSG_EXPORT: return "EXPORT";
+  case MSG_SCAN_JSON: return "SCAN_JSON";
+  case MSG_SCAN_COLUMNS: return "SCAN_COLUMNS";
+  case MSG_SCAN_BATCH: return "SCAN_BATCH";
+  case MSG_FIND_ALL: return "FIND_ALL";
+  case MSG_BUILD_INDEX: return "BUILD_INDEX";
+  case MSG_FIND_BY: return "FIND_BY";
+  case MSG_INDEX_STATS: return "INDEX_STATS";
+  case MSG_WRITE_BATCH: return "WRITE_BATCH";
+  case MSG_EXEC: return "EXEC";
+  case MSG_SCAN_PAGE: return "SCAN_PAGE";
   case MSG_EXIT: return "EXIT";
   default: return "UNKNOWN";
   }
@@ -31,7 +48,7 @@ static const char *getMessageStr(VSAM_THREAD_MSGID msgid) {
 int gettid() { return (int)(pthread_self().__ & 0x7fffffff); }
 
 void vsamThread(VsamFile *pVsamFile, std::condition_variable *pcv,
-                std::mutex *pmtx, std::queue<ST_VsamThreadMsg *> *pqueue) {
+                std::mutex *pmtx, VsamThreadQueue *pqueue) {
 #ifdef DEBUG
   fprintf(stderr, "vsamThread tid=%d started.\n", gettid());
 #endif
@@ -43,8 +60,9 @@ void vsamThread(VsamFile *pVsamFile, std::condition_variable *pcv,
 
     if (pqueue->empty())
       continue;
-    pmsg = pqueue->front();
+    pmsg = pqueue->top();
     pqueue->pop();
+    bool expired = pVsamFile->dequeued(pmsg);
 
 #if defined(DEBUG) || defined(DEBUG_CRUD)
     fflush(stderr);
@@ -62,8 +80,38 @@ void vsamThread(VsamFile *pVsamFile, std::condition_variable *pcv,
     case MSG_READ:
     case MSG_FIND_UPDATE:
     case MSG_FIND_DELETE:
-      (pVsamFile->*(pmsg->pWorkFunc))(pmsg->pdata);
+    case MSG_LOAD_BEGIN:
+    case MSG_LOAD:
+    case MSG_LOAD_END:
+    case MSG_DELETE_RANGE:
+    case MSG_UPDATE_RANGE:
+    case MSG_AGGREGATE:
+    case MSG_EXPORT:
+    case MSG_SCAN_JSON:
+    case MSG_SCAN_COLUMNS:
+    case MSG_SCAN_BATCH:
+    case MSG_FIND_ALL:
+    case MSG_BUILD_INDEX:
+    case MSG_FIND_BY:
+    case MSG_INDEX_STATS:
+    case MSG_WRITE_BATCH:
+    case MSG_EXEC:
+    case MSG_SCAN_PAGE:
+      if (expired) {
+        // the error is set by dequeued()
+      } else if (pmsg->msgid == MSG_CLOSE) {
+        (pVsamFile->*(pmsg->pWorkFunc))(pmsg->pdata);
+      } else {
+        // the queue isn't locked while the message is processed, so that
+        // the messages sent meanwhile are queued by their priority
+        lck.unlock();
+        pVsamFile->useCursor(pmsg->pdata);
+        (pVsamFile->*(pmsg->pWorkFunc))(pmsg->pdata);
+        pVsamFile->cursorUsed(pmsg->pdata);
+        lck.lock();
+      }
       pmsg->rc = pmsg->pdata->rc_;
+      pmsg->done = true;
       if (pmsg->msgid == MSG_CLOSE) {
         pVsamFile->detachVsamThread();
         pmsg->cv.notify_one();
@@ -77,6 +125,7 @@ void vsamThread(VsamFile *pVsamFile, std::condition_variable *pcv,
       break;
     case MSG_EXIT:
       pmsg->rc = 0;
+      pmsg->done = true;
       pVsamFile->detachVsamThread();
       pmsg->cv.notify_one();
 #ifdef DEBUG
@@ -91,6 +140,7 @@ void vsamThread(VsamFile *pVsamFile, std::condition_variable *pcv,
               gettid(), pmsg->msgid);
 #endif
       pVsamFile->detachVsamThread();
+      pmsg->done = true;
       pmsg->cv.notify_one();
       assert(0);
     }
@@ -12,4 +12,4 @@
 
 int gettid();
 void vsamThread(VsamFile *pVsamFile, std::condition_variable *pcv,
-                std::mutex *pmtx, std::queue<ST_VsamThreadMsg *> *pqueue);
+                std::mutex *pmtx, VsamThreadQueue *pqueue);
@@ -5,17 +5,20 @@
  * restricted by GSA ADP Schedule Contract with IBM Corp.
  */
 #include <assert.h>
+#include <limits.h>
 #include <stdio.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <sstream>
 
 #include "WrappedVsam.h"
+#include "CompiledSchema.h"
+#include "RecordBatch.h"
+#include "Snapshot.h"
 #include "VsamThread.h"
 
 
-Napi::FunctionReference WrappedVsam::constructor_;
-
 static void throwError(const Napi::CallbackInfo &info, int errArgNum,
                        CbFirstArgType firstArgType, bool isTypeErr,
                        const char *fmt, ...) {
@@ -57,13 +60,15 @@ static void throwError(const Napi::CallbackInfo &info, int errArgNum,
 
 bool WrappedVsam::errorIfNotOpen(const Napi::CallbackInfo &info, int errArgNum,
                                  CbFirstArgType firstArgType,
-                                 const char *pApiName) {
-  if (pVsamFile_ == nullptr) {
+                                 const char *pApiName, bool fence) {
+  if (pVsamFile_ == nullptr || closing_) {
     Napi::HandleScope scope(info.Env());
     throwError(info, errArgNum, firstArgType, false,
                "%s error: VSAM dataset is not open.", pApiName);
     return true;
   }
+  if (fence && !staged_.empty())
+    writeStaged(info.Env());
   return false;
 }
 
@@ -112,6 +117,243 @@ void WrappedVsam::FindDeleteComplete(uv_work_t *req, int status) {
   FindUpdateComplete(req, status);
 }
 
+void WrappedVsam::LoadComplete(uv_work_t *req, int status) {
+  FindUpdateComplete(req, status);
+}
+
+void WrappedVsam::ExportComplete(uv_work_t *req, int status) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  napi_threadsafe_function progress = pdata->pExport_->progress;
+  if (progress == nullptr) {
+    FindUpdateComplete(req, status);
+    return;
+  }
+  delete req;
+  // Call back through progress, so it's after the last progress call
+  if (status == UV_ECANCELED)
+    delete pdata;
+  else
+    napi_call_threadsafe_function(
+        progress, new RecordExport::Progress{pdata->count_, pdata},
+        napi_tsfn_nonblocking);
+  napi_release_threadsafe_function(progress, napi_tsfn_release);
+}
+
+void WrappedVsam::CallExportProgress(napi_env env, napi_value jsProgress,
+                                     void *context, void *data) {
+  RecordExport::Progress *p = static_cast<RecordExport::Progress *>(data);
+  UvWorkData *pdata = p->pdata;
+  if (env != nullptr) {
+    Napi::Env napiEnv(env);
+    if (pdata == nullptr)
+      Napi::Function(env, jsProgress)
+          .Call(napiEnv.Global(), {Napi::Number::New(napiEnv, p->count)});
+    else if (pdata->rc_ != 0)
+      pdata->cb_.Call(napiEnv.Global(),
+                      {Napi::Number::New(napiEnv, pdata->count_),
+                       Napi::String::New(napiEnv, pdata->errmsg_)});
+    else
+      pdata->cb_.Call(napiEnv.Global(),
+                      {Napi::Number::New(napiEnv, pdata->count_),
+                       napiEnv.Null()});
+  }
+  if (pdata != nullptr)
+    delete pdata;
+  delete p;
+}
+
+void WrappedVsam::ScanJsonComplete(uv_work_t *req, int status) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  delete req;
+
+  if (status == UV_ECANCELED) {
+    delete pdata;
+    return;
+  }
+  Napi::HandleScope scope(pdata->env_);
+  DCHECK(pdata->cb_ != nullptr && pdata->env_ != nullptr);
+  if (pdata->rc_ != 0)
+    pdata->cb_.Call(
+        pdata->env_.Global(),
+        {pdata->env_.Null(), Napi::String::New(pdata->env_, pdata->errmsg_)});
+  else
+    pdata->cb_.Call(
+        pdata->env_.Global(),
+        {createOwnedBuffer(pdata->env_,
+                          new std::string(std::move(pdata->pExport_->output))),
+         pdata->env_.Null()});
+  delete pdata;
+}
+
+void WrappedVsam::ScanColumnsComplete(uv_work_t *req, int status) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  delete req;
+
+  if (status == UV_ECANCELED) {
+    delete pdata;
+    return;
+  }
+  Napi::HandleScope scope(pdata->env_);
+  DCHECK(pdata->cb_ != nullptr && pdata->env_ != nullptr);
+  if (pdata->rc_ != 0)
+    pdata->cb_.Call(
+        pdata->env_.Global(),
+        {pdata->env_.Null(), Napi::String::New(pdata->env_, pdata->errmsg_)});
+  else
+    pdata->cb_.Call(pdata->env_.Global(),
+                    {createColumnsObject(pdata), pdata->env_.Null()});
+  delete pdata;
+}
+
+void WrappedVsam::ScanBatchComplete(uv_work_t *req, int status) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  delete req;
+
+  if (status == UV_ECANCELED) {
+    delete pdata;
+    return;
+  }
+  Napi::HandleScope scope(pdata->env_);
+  DCHECK(pdata->cb_ != nullptr && pdata->env_ != nullptr);
+  if (pdata->rc_ != 0)
+    pdata->cb_.Call(
+        pdata->env_.Global(),
+        {pdata->env_.Null(), Napi::String::New(pdata->env_, pdata->errmsg_)});
+  else
+    pdata->cb_.Call(pdata->env_.Global(),
+                    {createBatchObject(pdata), pdata->env_.Null()});
+  delete pdata;
+}
+
+void WrappedVsam::ScanPageComplete(uv_work_t *req, int status) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  delete req;
+
+  if (status == UV_ECANCELED) {
+    delete pdata;
+    return;
+  }
+  Napi::HandleScope scope(pdata->env_);
+  DCHECK(pdata->cb_ != nullptr && pdata->env_ != nullptr);
+  if (pdata->rc_ != 0)
+    pdata->cb_.Call(
+        pdata->env_.Global(),
+        {pdata->env_.Null(), Napi::String::New(pdata->env_, pdata->errmsg_)});
+  else
+    pdata->cb_.Call(pdata->env_.Global(),
+                    {createPageObject(pdata), pdata->env_.Null()});
+  delete pdata;
+}
+
+void WrappedVsam::FindAllComplete(uv_work_t *req, int status) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  delete req;
+
+  if (status == UV_ECANCELED) {
+    delete pdata;
+    return;
+  }
+  Napi::HandleScope scope(pdata->env_);
+  DCHECK(pdata->cb_ != nullptr && pdata->env_ != nullptr);
+  if (pdata->rc_ != 0)
+    pdata->cb_.Call(
+        pdata->env_.Global(),
+        {pdata->env_.Null(), Napi::String::New(pdata->env_, pdata->errmsg_)});
+  else
+    pdata->cb_.Call(pdata->env_.Global(),
+                    {createRecordArray(pdata), pdata->env_.Null()});
+  delete pdata;
+}
+
+void WrappedVsam::BuildIndexComplete(uv_work_t *req, int status) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  delete req;
+
+  if (status == UV_ECANCELED) {
+    delete pdata;
+    return;
+  }
+  Napi::HandleScope scope(pdata->env_);
+  DCHECK(pdata->cb_ != nullptr && pdata->env_ != nullptr);
+  if (pdata->rc_ != 0)
+    pdata->cb_.Call(
+        pdata->env_.Global(),
+        {pdata->env_.Null(), Napi::String::New(pdata->env_, pdata->errmsg_)});
+  else
+    pdata->cb_.Call(pdata->env_.Global(),
+                    {createIndexStats(pdata), pdata->env_.Null()});
+  delete pdata;
+}
+
+void WrappedVsam::WriteBatchComplete(uv_work_t *req, int status) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  if (status == UV_ECANCELED) {
+    // the batch was posted to the VSAM thread already, and its records were
+    // reported as written, so it's run to completion all the same
+    pdata->rc_ = pdata->pVsamFile_->waitForVsamThread(pdata);
+  }
+  if (dropIfEnvExited(req))
+    return;
+  VsamFile *pVsamFile = pdata->pVsamFile_;
+  delete req;
+
+  Napi::HandleScope scope(pdata->env_);
+  DCHECK(pdata->pWriteBatch_ != nullptr);
+  const WriteBatch &batch = *pdata->pWriteBatch_;
+  WrappedVsam *obj = static_cast<WrappedVsam *>(batch.pOwner);
+  Napi::Env env = pdata->env_;
+  DCHECK(obj->batchesWriting_ > 0);
+  obj->batchesWriting_--;
+  for (size_t i = 0; i < batch.failedKeys.size(); i++)
+    obj->writeFailures_.push_back(
+        std::make_pair(batch.failedKeys[i], batch.errors[i]));
+  delete pdata;
+  // the batches are written in the order they're posted, so flush() is done
+  // once none is left:
+  if (obj->batchesWriting_ == 0 && !obj->flushCallbacks_.empty())
+    obj->completeFlush(env);
+  obj->Unref();
+  workDone(pVsamFile);
+}
+
+void WrappedVsam::ExecComplete(uv_work_t *req, int status) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  delete req;
+
+  if (status == UV_ECANCELED) {
+    delete pdata;
+    return;
+  }
+  Napi::HandleScope scope(pdata->env_);
+  DCHECK(pdata->cb_ != nullptr && pdata->env_ != nullptr);
+  if (pdata->rc_ != 0) {
+    pdata->cb_.Call(
+        pdata->env_.Global(),
+        {pdata->env_.Null(), Napi::String::New(pdata->env_, pdata->errmsg_)});
+    delete pdata;
+    return;
+  }
+  std::string errmsg;
+  Napi::Value results = createExecResults(pdata, "exec", errmsg);
+  pdata->cb_.Call(pdata->env_.Global(),
+                  {results, errmsg.empty()
+                                ? pdata->env_.Null()
+                                : Napi::String::New(pdata->env_, errmsg)});
+  delete pdata;
+}
+
+void WrappedVsam::FindByComplete(uv_work_t *req, int status) {
+  FindAllComplete(req, status);
+}
+
+void WrappedVsam::DeleteRangeComplete(uv_work_t *req, int status) {
+  FindUpdateComplete(req, status);
+}
+
+void WrappedVsam::UpdateRangeComplete(uv_work_t *req, int status) {
+  FindUpdateComplete(req, status);
+}
+
 void WrappedVsam::DeleteComplete(uv_work_t *req, int status) {
   DefaultComplete(req, status);
 }
@@ -128,6 +370,26 @@ void WrappedVsam::DeallocComplete(uv_work_t *req, int status) {
   DefaultComplete(req, status);
 }
 
+void WrappedVsam::AggregateComplete(uv_work_t *req, int status) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  delete req;
+
+  if (status == UV_ECANCELED) {
+    delete pdata;
+    return;
+  }
+  Napi::HandleScope scope(pdata->env_);
+  DCHECK(pdata->cb_ != nullptr && pdata->env_ != nullptr);
+  if (pdata->rc_ != 0)
+    pdata->cb_.Call(
+        pdata->env_.Global(),
+        {pdata->env_.Null(), Napi::String::New(pdata->env_, pdata->errmsg_)});
+  else
+    pdata->cb_.Call(pdata->env_.Global(),
+                    {createAggregateObject(pdata), pdata->env_.Null()});
+  delete pdata;
+}
+
 Napi::Value WrappedVsam::createRecordObject(UvWorkData *pdata) {
   if (pdata->recbuf_ == nullptr)
     return pdata->env_.Null();
@@ -136,49 +398,287 @@ Napi::Value WrappedVsam::createRecordObject(UvWorkData *pdata) {
   const char *recbuf = pdata->recbuf_;
   VsamFile *obj = pdata->pVsamFile_;
   DCHECK(obj != nullptr);
-  std::vector<LayoutItem> &layout = obj->getLayout();
+  const std::vector<LayoutItem> &layout = obj->getLayout();
 
   for (auto i = layout.begin(); i != layout.end(); ++i) {
-    if (i->type == LayoutItem::STRING) {
-      std::string str(recbuf, i->maxLength + 1);
-      str[i->maxLength] = 0;
-      record.Set(i->name, Napi::String::New(pdata->env_, str.c_str()));
-    } else if (i->type == LayoutItem::HEXADECIMAL) {
-      char hexstr[(i->maxLength * 2) + 1];
-      VsamFile::bufferToHexstr(hexstr, sizeof(hexstr), recbuf, i->maxLength);
-      record.Set(i->name, Napi::String::New(pdata->env_, hexstr));
-    }
+    record.Set(i->name, createFieldValue(pdata->env_, *i, recbuf));
     recbuf += i->maxLength;
   }
   return record;
 }
 
+Napi::Value WrappedVsam::createFieldValue(Napi::Env env, const LayoutItem &item,
+                                          const char *fldbuf) {
+  if (item.type == LayoutItem::STRING) {
+    std::string str(fldbuf, item.maxLength + 1);
+    str[item.maxLength] = 0;
+    return Napi::String::New(env, str.c_str());
+  }
+  DCHECK(item.type == LayoutItem::HEXADECIMAL);
+  char hexstr[(item.maxLength * 2) + 1];
+  VsamFile::bufferToHexstr(hexstr, sizeof(hexstr), fldbuf, item.maxLength);
+  return Napi::String::New(env, hexstr);
+}
+
+static Napi::Value createAggregateValue(Napi::Env env, const LayoutItem &item,
+                                        uint64_t high, uint64_t low) {
+  // a BigInt for a field wider than 6 bytes, whose values can be past 2^53,
+  // as in scanColumns(), else a Number
+  if (item.maxLength <= 6)
+    return Napi::Number::New(env, (double)high * 18446744073709551616.0 +
+                                      (double)low);
+  uint64_t words[2] = {low, high};
+  napi_value value;
+  if (napi_create_bigint_words(env, 0, high != 0 ? 2 : 1, words, &value) !=
+      napi_ok)
+    return env.Null();
+  return Napi::Value(env, value);
+}
+
+static Napi::Object createTotalsObject(Napi::Env env, const Aggregation &aggr,
+                                       const Aggregation::Totals *ptotals,
+                                       const std::vector<LayoutItem> &layout) {
+  // ptotals is null if no record was aggregated
+  Napi::Object obj = Napi::Object::New(env);
+  obj.Set("count", Napi::Number::New(env, ptotals ? ptotals->count : 0));
+  Napi::Object sum = Napi::Object::New(env);
+  for (size_t i = 0; i < aggr.sum.size(); i++) {
+    const LayoutItem &item = layout[aggr.sum[i]];
+    sum.Set(item.name,
+            ptotals ? createAggregateValue(env, item, ptotals->sum[i].high,
+                                           ptotals->sum[i].low)
+                    : createAggregateValue(env, item, 0, 0));
+  }
+  obj.Set("sum", sum);
+  Napi::Object min = Napi::Object::New(env);
+  for (size_t i = 0; i < aggr.min.size(); i++) {
+    const LayoutItem &item = layout[aggr.min[i]];
+    min.Set(item.name, ptotals ? createAggregateValue(env, item, 0,
+                                                      ptotals->min[i])
+                               : env.Null());
+  }
+  obj.Set("min", min);
+  Napi::Object max = Napi::Object::New(env);
+  for (size_t i = 0; i < aggr.max.size(); i++) {
+    const LayoutItem &item = layout[aggr.max[i]];
+    max.Set(item.name, ptotals ? createAggregateValue(env, item, 0,
+                                                      ptotals->max[i])
+                               : env.Null());
+  }
+  obj.Set("max", max);
+  return obj;
+}
+
+template <typename T>
+static Napi::Value createTypedArray(Napi::Env env, std::vector<T> &values,
+                                    napi_typedarray_type type) {
+  // The ArrayBuffer takes ownership of the values, so they aren't copied
+  size_t length = values.size();
+  Napi::ArrayBuffer buffer;
+  if (length == 0)
+    buffer = Napi::ArrayBuffer::New(env, 0);
+  else {
+    std::vector<T> *pvalues = new std::vector<T>(std::move(values));
+    buffer = Napi::ArrayBuffer::New(
+        env, pvalues->data(), length * sizeof(T),
+        [](Napi::Env, void *, std::vector<T> *pvalues) { delete pvalues; },
+        pvalues);
+  }
+  napi_value result;
+  if (napi_create_typedarray(env, type, length, buffer, 0, &result) !=
+      napi_ok)
+    return env.Null();
+  return Napi::Value(env, result);
+}
+
+Napi::Value WrappedVsam::createColumnsObject(UvWorkData *pdata) {
+  DCHECK(pdata->pColumns_ != nullptr);
+  RecordColumns &cols = *pdata->pColumns_;
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  const std::vector<LayoutItem> &layout = obj->getLayout();
+  Napi::Env env = pdata->env_;
+
+  Napi::Object result = Napi::Object::New(env);
+  Napi::Object columns = Napi::Object::New(env);
+  for (auto c = cols.columns.begin(); c != cols.columns.end(); ++c) {
+    const std::string &name = layout[c->field].name;
+    switch (c->type) {
+    case RecordColumns::Column::UINT32:
+      columns.Set(name, createTypedArray(env, c->u32, napi_uint32_array));
+      break;
+    case RecordColumns::Column::FLOAT64:
+      columns.Set(name, createTypedArray(env, c->f64, napi_float64_array));
+      break;
+    case RecordColumns::Column::BIGUINT64:
+      columns.Set(name, createTypedArray(env, c->u64, napi_biguint64_array));
+      break;
+    case RecordColumns::Column::BYTES: {
+      Napi::Object column = Napi::Object::New(env);
+      column.Set("offsets", createTypedArray(env, c->u32, napi_uint32_array));
+      column.Set("data", createOwnedBuffer(
+                             env, new std::string(std::move(c->bytes))));
+      columns.Set(name, column);
+      break;
+    }
+    }
+  }
+  result.Set("length", Napi::Number::New(env, cols.length));
+  result.Set("columns", columns);
+  return result;
+}
+
+Napi::Value WrappedVsam::createRecordArray(UvWorkData *pdata) {
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  const std::vector<LayoutItem> &layout = obj->getLayout();
+  size_t reclen = obj->getRecordLength();
+  Napi::Array records = Napi::Array::New(pdata->env_, pdata->count_);
+  for (size_t n = 0; n < pdata->count_; n++) {
+    const char *recbuf = pdata->records_.data() + n * reclen;
+    Napi::Object record = Napi::Object::New(pdata->env_);
+    for (auto i = layout.begin(); i != layout.end(); ++i)
+      record.Set(i->name,
+                 createFieldValue(pdata->env_, *i, recbuf + i->offset));
+    records.Set(n, record);
+  }
+  return records;
+}
+
+// The continuation token of scanPage() is the key of the last record of the
+// page in hexadecimal, then the number of records returned with that key, as
+// it can be a duplicate of a non-unique alternate key; the caller is not
+// meant to look into it.
+static std::string createPageToken(const char *key, size_t keylen,
+                                   size_t count) {
+  static const char digits[] = "0123456789abcdef";
+  std::string token("p");
+  for (size_t i = 0; i < keylen; i++) {
+    token += digits[(unsigned char)key[i] >> 4];
+    token += digits[(unsigned char)key[i] & 0x0f];
+  }
+  return token + "." + std::to_string(count);
+}
+
+static bool decodePageToken(const std::string &token, size_t keylen,
+                            std::string &key, size_t &count) {
+  size_t dot = 1 + keylen * 2;
+  if (token.length() <= dot + 1 || token.length() > dot + 10 ||
+      token[0] != 'p' || token[dot] != '.' ||
+      token.find_first_not_of("0123456789abcdef", 1) != dot ||
+      token.find_first_not_of("0123456789", dot + 1) != std::string::npos)
+    return false;
+  count = std::stoul(token.substr(dot + 1));
+  if (count == 0)
+    return false;
+  key.resize(keylen);
+  VsamFile::hexstrToBuffer(&key[0], keylen, token.c_str() + 1);
+  return true;
+}
+
+Napi::Value WrappedVsam::createPageObject(UvWorkData *pdata) {
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  size_t reclen = obj->getRecordLength();
+  // count_ is one more than the records kept if there's a next page
+  bool more = pdata->count_ > pdata->pScanRange_->maxCount - 1;
+  pdata->count_ = pdata->records_.length() / reclen;
+  Napi::Object page = Napi::Object::New(pdata->env_);
+  page.Set("records", createRecordArray(pdata));
+  if (more && pdata->count_ > 0) {
+    // the records with the last key are at the end of the page, after those
+    // skipped with it at the start, if any
+    size_t keypos = obj->getKeyPosition(), keylen = obj->getKeyLength();
+    const char *lastkey =
+        pdata->records_.data() + (pdata->count_ - 1) * reclen + keypos;
+    size_t n = 1;
+    while (n < pdata->count_ &&
+           memcmp(lastkey - n * reclen, lastkey, keylen) == 0)
+      n++;
+    const ScanRange &range = *pdata->pScanRange_;
+    if (n == pdata->count_ && range.afterCount > 0 &&
+        memcmp(range.from.data(), lastkey, keylen) == 0)
+      n += range.afterCount;
+    page.Set("next", createPageToken(lastkey, keylen, n));
+  } else
+    page.Set("next", pdata->env_.Null());
+  return page;
+}
+
+Napi::Value WrappedVsam::createBatchObject(UvWorkData *pdata) {
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  return RecordBatch::New(
+      pdata->env_, getAddonData(pdata->env_)->recordBatchConstructor,
+      obj->getLayout(), obj->getKeyNum(), obj->getRecordLength(),
+      pdata->records_);
+}
+
+Napi::Value WrappedVsam::createAggregateObject(UvWorkData *pdata) {
+  DCHECK(pdata->pAggregation_ != nullptr);
+  const Aggregation &aggr = *pdata->pAggregation_;
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  const std::vector<LayoutItem> &layout = obj->getLayout();
+
+  if (aggr.groupBy < 0) {
+    auto i = aggr.groups.find("");
+    return createTotalsObject(pdata->env_, aggr,
+                              i == aggr.groups.end() ? nullptr : &i->second,
+                              layout);
+  }
+  const LayoutItem &item = layout[aggr.groupBy];
+  Napi::Object result = Napi::Object::New(pdata->env_);
+  Napi::Object groups = Napi::Object::New(pdata->env_);
+  size_t count = 0;
+  std::string fldbuf;
+  for (auto i = aggr.groups.begin(); i != aggr.groups.end(); ++i) {
+    fldbuf = i->first;
+    fldbuf.resize(item.maxLength, 0);
+    groups.Set(createFieldValue(pdata->env_, item, fldbuf.data()),
+               createTotalsObject(pdata->env_, aggr, &i->second, layout));
+    count += i->second.count;
+  }
+  result.Set("count", Napi::Number::New(pdata->env_, count));
+  result.Set("groups", groups);
+  return result;
+}
+
 void WrappedVsam::ReadComplete(uv_work_t *req, int status) {
   UvWorkData *pdata = (UvWorkData *)(req->data);
   delete req;
 
+  if (pdata->keybuf_ != nullptr) {
+    // no longer in flight for single-flight
+    std::map<std::string, UvWorkData *> &pending =
+        pdata->pVsamFile_->getPendingFinds();
+    auto i = pending.find(
+        pendingFindKey(pdata->equality_, pdata->keybuf_, pdata->keybuf_len_));
+    if (i != pending.end() && i->second == pdata)
+      pending.erase(i);
+  }
   if (status == UV_ECANCELED) {
     delete pdata;
     return;
   }
   Napi::HandleScope scope(pdata->env_);
   DCHECK(pdata->cb_ != nullptr && pdata->env_ != nullptr);
-  if (pdata->rc_ != 0) {
-    pdata->cb_.Call(
-        pdata->env_.Global(),
-        {pdata->env_.Null(), Napi::String::New(pdata->env_, pdata->errmsg_)});
-    delete pdata;
-    return;
-  }
-  if (pdata->recbuf_ == nullptr) {
-    pdata->cb_.Call(pdata->env_.Global(),
-                    {pdata->env_.Null(), pdata->env_.Null()});
-    delete pdata;
-    return;
+  // the callback of the find, then those of the identical finds issued while
+  // it was in flight, each one with its own record object:
+  std::vector<Napi::FunctionReference *> cbs(1, &pdata->cb_);
+  cbs.insert(cbs.end(), pdata->followers_.begin(), pdata->followers_.end());
+  for (auto cb = cbs.begin(); cb != cbs.end(); ++cb) {
+    if (pdata->rc_ != 0)
+      (*cb)->Call(
+          pdata->env_.Global(),
+          {pdata->env_.Null(), Napi::String::New(pdata->env_, pdata->errmsg_)});
+    else if (pdata->recbuf_ == nullptr)
+      (*cb)->Call(pdata->env_.Global(),
+                  {pdata->env_.Null(), pdata->env_.Null()});
+    else
+      (*cb)->Call(pdata->env_.Global(),
+                  {createRecordObject(pdata), pdata->env_.Null()});
   }
-
-  Napi::Value record = createRecordObject(pdata);
-  pdata->cb_.Call(pdata->env_.Global(), {record, pdata->env_.Null()});
   delete pdata;
 }
 
@@ -228,56 +728,228 @@ void WrappedVsam::UpdateExecute(uv_work_t *req) {
   UvWorkData *pdata = (UvWorkData *)(req->data);
   VsamFile *obj = pdata->pVsamFile_;
   DCHECK(obj != nullptr);
-  obj->routeToVsamThread(MSG_UPDATE, &VsamFile::UpdateExecute, pdata);
+  obj->routeToVsamThread(MSG_UPDATE,
+                         pdata->pFieldsToUpdate_
+                             ? &VsamFile::UpdateFieldsExecute
+                             : &VsamFile::UpdateExecute,
+                         pdata);
 }
 
-void WrappedVsam::DeallocExecute(uv_work_t *req) {
+void WrappedVsam::AggregateExecute(uv_work_t *req) {
   UvWorkData *pdata = (UvWorkData *)(req->data);
-  DCHECK(pdata->pVsamFile_ == nullptr);
-  DCHECK(pdata->path_.length() > 0);
-  VsamFile::DeallocExecute(pdata);
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  obj->routeToVsamThread(MSG_AGGREGATE, &VsamFile::AggregateExecute, pdata);
 }
 
-WrappedVsam::WrappedVsam(const Napi::CallbackInfo &info)
-    : Napi::ObjectWrap<WrappedVsam>(info) {
-  if (info.Length() != 6) {
-    Napi::HandleScope scope(info.Env());
-    throwError(
-        info, -1, ARG0_TYPE_NONE, true, //-1 throws an exception, not callback
-        "Internal Error: wrong number of arguments to WrappedVsam constructor: "
+void WrappedVsam::LoadExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  obj->routeToVsamThread(MSG_LOAD, &VsamFile::LoadExecute, pdata);
+}
+
+void WrappedVsam::ExportExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  obj->routeToVsamThread(MSG_EXPORT, &VsamFile::ExportExecute, pdata);
+}
+
+void WrappedVsam::ScanJsonExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  obj->routeToVsamThread(MSG_SCAN_JSON, &VsamFile::ScanJsonExecute, pdata);
+}
+
+void WrappedVsam::FindJsonExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  obj->routeToVsamThread(MSG_FIND, &VsamFile::FindJsonExecute, pdata);
+}
+
+void WrappedVsam::ScanColumnsExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  obj->routeToVsamThread(MSG_SCAN_COLUMNS, &VsamFile::ScanColumnsExecute,
+                         pdata);
+}
+
+void WrappedVsam::ScanBatchExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  obj->routeToVsamThread(MSG_SCAN_BATCH, &VsamFile::ScanBatchExecute, pdata);
+}
+
+void WrappedVsam::ScanPageExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  obj->routeToVsamThread(MSG_SCAN_PAGE, &VsamFile::ScanPageExecute, pdata);
+}
+
+void WrappedVsam::FindAllExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  obj->routeToVsamThread(MSG_FIND_ALL, &VsamFile::FindAllExecute, pdata);
+}
+
+void WrappedVsam::BuildIndexExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  obj->routeToVsamThread(MSG_BUILD_INDEX, &VsamFile::BuildIndexExecute, pdata);
+}
+
+void WrappedVsam::WriteBatchExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  // posted by queueWork(), ahead of what's issued after it
+  obj->waitForVsamThread(pdata);
+}
+
+void WrappedVsam::ExecExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  obj->routeToVsamThread(MSG_EXEC, &VsamFile::ExecExecute, pdata);
+}
+
+void WrappedVsam::FindByExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  obj->routeToVsamThread(MSG_FIND_BY, &VsamFile::FindByExecute, pdata);
+}
+
+void WrappedVsam::DeleteRangeExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  obj->routeToVsamThread(MSG_DELETE_RANGE, &VsamFile::DeleteRangeExecute,
+                         pdata);
+}
+
+void WrappedVsam::UpdateRangeExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *obj = pdata->pVsamFile_;
+  DCHECK(obj != nullptr);
+  obj->routeToVsamThread(MSG_UPDATE_RANGE, &VsamFile::UpdateRangeExecute,
+                         pdata);
+}
+
+void WrappedVsam::DeallocExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  DCHECK(pdata->pVsamFile_ == nullptr);
+  DCHECK(pdata->path_.length() > 0);
+  VsamFile::DeallocExecute(pdata);
+}
+
+WrappedVsam::WrappedVsam(const Napi::CallbackInfo &info)
+    : Napi::ObjectWrap<WrappedVsam>(info), pAddonData_(nullptr),
+      pVsamFile_(nullptr), closing_(false), writeBehind_(0),
+      batchesWriting_(0), lastCancelId_(0), lastCursorId_(0) {
+  if (info.Length() != 6) {
+    Napi::HandleScope scope(info.Env());
+    throwError(
+        info, -1, ARG0_TYPE_NONE, true, //-1 throws an exception, not callback
+        "Internal Error: wrong number of arguments to WrappedVsam constructor: "
         "got %d, expected 6.",
         info.Length());
     return;
   }
 
   path_ = static_cast<std::string>(info[0].As<Napi::String>());
-  Napi::Buffer<std::vector<LayoutItem>> b =
-      info[1].As<Napi::Buffer<std::vector<LayoutItem>>>();
-  std::vector<LayoutItem> layout =
-      *(static_cast<std::vector<LayoutItem> *>(b.Data()));
-  int key_i = static_cast<int>(info[2].As<Napi::Number>().Int32Value());
-  int keypos = static_cast<int>(info[3].As<Napi::Number>().Int32Value());
+  // the layout is shared, not copied, with the caller and other datasets
+  const std::shared_ptr<const SchemaLayout> &pSchema =
+      *info[1].As<Napi::External<std::shared_ptr<const SchemaLayout>>>().Data();
   const std::string &omode =
-      static_cast<std::string>(info[4].As<Napi::String>());
-  bool alloc(static_cast<bool>(info[5].As<Napi::Boolean>()));
+      static_cast<std::string>(info[2].As<Napi::String>());
+  bool alloc(static_cast<bool>(info[3].As<Napi::Boolean>()));
+  // the dataset is opened by OpenExecute() or AllocExecute() if it's async
+  bool async(static_cast<bool>(info[4].As<Napi::Boolean>()));
+  // the dataset has no VSAM thread if it's only used by the sync APIs
+  bool direct(static_cast<bool>(info[5].As<Napi::Boolean>()));
 
-  pVsamFile_ = new VsamFile(path_, layout, key_i, keypos, omode);
+  pVsamFile_ = new VsamFile(path_, pSchema, omode, direct);
 #if defined(DEBUG) || defined(XDEBUG)
   fprintf(stderr, "WrappedVsam this=%p created pVsamFile_=%p\n", this,
           pVsamFile_);
 #endif
-  pVsamFile_->routeToVsamThread(MSG_OPEN,
-                                alloc ? &VsamFile::alloc : &VsamFile::open);
+  if (!async)
+    pVsamFile_->routeToVsamThread(MSG_OPEN,
+                                  alloc ? &VsamFile::alloc : &VsamFile::open);
+  pAddonData_ = getAddonData(info.Env());
+  pAddonData_->objects.insert(this);
 }
 
 WrappedVsam::~WrappedVsam() {
 #if defined(DEBUG) || defined(XDEBUG)
   fprintf(stderr, "~WrappedVsam this=%p, deleteVsamFileObj...\n", this);
 #endif
+  if (pAddonData_)
+    pAddonData_->objects.erase(this);
   deleteVsamFileObj();
 }
 
-void WrappedVsam::deleteVsamFileObj() {
+// static
+AddonData *WrappedVsam::getAddonData(Napi::Env env) {
+  void *data = nullptr;
+  napi_status status = napi_get_instance_data(env, &data);
+  assert(status == napi_ok && data != nullptr);
+  return static_cast<AddonData *>(data);
+}
+
+// static
+uv_loop_t *WrappedVsam::eventLoop(Napi::Env env) {
+  // the loop of the main or worker thread of env, not uv_default_loop()
+  return getAddonData(env)->loop;
+}
+
+// static
+void WrappedVsam::Cleanup(void *arg) {
+  // Called when the environment exits, e.g. on exit of a worker thread:
+  // close the datasets still open and stop their VSAM threads.
+  AddonData *pAddonData = static_cast<AddonData *>(arg);
+  for (auto i = pAddonData->objects.begin(); i != pAddonData->objects.end();
+       ++i) {
+    WrappedVsam *p = *i;
+#if defined(DEBUG) || defined(XDEBUG)
+    fprintf(stderr, "Cleanup this=%p, pVsamFile_=%p...\n", p, p->pVsamFile_);
+#endif
+    p->pAddonData_ = nullptr;
+    if (p->pVsamFile_ == nullptr)
+      continue;
+    // with requests still on the thread pool, it's closed and deleted by the
+    // last one to complete instead
+    if (p->pVsamFile_->isDatasetOpen() &&
+        p->pVsamFile_->getWorkQueued() == 0) {
+      Napi::Function dummy;
+      UvWorkData uvdata(nullptr, dummy, nullptr);
+      p->pVsamFile_->routeToVsamThread(MSG_CLOSE, &VsamFile::Close, &uvdata);
+    }
+    p->deleteVsamFileObj(true);
+  }
+  pAddonData->objects.clear();
+  for (auto i = pAddonData->later.begin(); i != pAddonData->later.end(); ++i)
+    dropRequest(*i);
+  pAddonData->later.clear();
+  uv_close((uv_handle_t *)pAddonData->laterAsync,
+           [](uv_handle_t *handle) { delete (uv_async_t *)handle; });
+}
+
+// static
+void WrappedVsam::DeleteAddonData(napi_env env, void *data, void *hint) {
+  delete static_cast<AddonData *>(data);
+}
+
+void WrappedVsam::deleteVsamFileObj(bool envExited) {
   if (pVsamFile_ == nullptr) {
 #ifdef DEBUG
     fprintf(stderr,
@@ -285,6 +957,20 @@ void WrappedVsam::deleteVsamFileObj() {
 #endif
     return;
   }
+  if (pVsamFile_->getWorkQueued() > 0) {
+    // the thread pool may still use it: the requests waiting to be started
+    // are dropped, and the last one in flight deletes it in workDone()
+    InFlightLimit &inFlight = pVsamFile_->getInFlight();
+    while (!inFlight.waiting.empty()) {
+      uv_work_t *request = inFlight.waiting.front();
+      inFlight.waiting.pop_front();
+      removeCancellable(request);
+      ((UvWorkData *)(request->data))->pComplete_(request, UV_ECANCELED);
+    }
+    pVsamFile_->orphan(envExited);
+    pVsamFile_ = nullptr;
+    return;
+  }
 #ifdef DEBUG
   fprintf(stderr, "deleteVsamFileObj calling vsamExitThread...\n");
 #endif
@@ -322,33 +1008,113 @@ Napi::Object WrappedVsam::Init(Napi::Env env, Napi::Object exports) {
                    InstanceMethod("writeSync", &WrappedVsam::WriteSync),
                    InstanceMethod("delete", &WrappedVsam::Delete),
                    InstanceMethod("deleteSync", &WrappedVsam::DeleteSync),
+                   InstanceMethod("readAsync", &WrappedVsam::ReadAsync),
+                   InstanceMethod("findAsync", &WrappedVsam::FindEqAsync),
+                   InstanceMethod("findeqAsync", &WrappedVsam::FindEqAsync),
+                   InstanceMethod("findgeAsync", &WrappedVsam::FindGeAsync),
+                   InstanceMethod("findfirstAsync",
+                                  &WrappedVsam::FindFirstAsync),
+                   InstanceMethod("findlastAsync",
+                                  &WrappedVsam::FindLastAsync),
+                   InstanceMethod("writeAsync", &WrappedVsam::WriteAsync),
+                   InstanceMethod("updateAsync", &WrappedVsam::UpdateAsync),
+                   InstanceMethod("deleteAsync", &WrappedVsam::DeleteAsync),
+                   InstanceMethod("_loadBegin", &WrappedVsam::LoadBegin),
+                   InstanceMethod("_loadBatch", &WrappedVsam::LoadBatch),
+                   InstanceMethod("_loadEnd", &WrappedVsam::LoadEnd),
+                   InstanceMethod("deleteRange", &WrappedVsam::DeleteRange),
+                   InstanceMethod("deleteRangeSync",
+                                  &WrappedVsam::DeleteRangeSync),
+                   InstanceMethod("updateRange", &WrappedVsam::UpdateRange),
+                   InstanceMethod("updateRangeSync",
+                                  &WrappedVsam::UpdateRangeSync),
+                   InstanceMethod("aggregate", &WrappedVsam::Aggregate),
+                   InstanceMethod("aggregateSync", &WrappedVsam::AggregateSync),
+                   InstanceMethod("exportTo", &WrappedVsam::ExportTo),
+                   InstanceMethod("findJson", &WrappedVsam::FindJson),
+                   InstanceMethod("findJsonSync", &WrappedVsam::FindJsonSync),
+                   InstanceMethod("scanJson", &WrappedVsam::ScanJson),
+                   InstanceMethod("scanJsonSync", &WrappedVsam::ScanJsonSync),
+                   InstanceMethod("scanColumns", &WrappedVsam::ScanColumns),
+                   InstanceMethod("scanColumnsSync",
+                                  &WrappedVsam::ScanColumnsSync),
+                   InstanceMethod("scanBatch", &WrappedVsam::ScanBatch),
+                   InstanceMethod("scanBatchSync", &WrappedVsam::ScanBatchSync),
+                   InstanceMethod("scanPage", &WrappedVsam::ScanPage),
+                   InstanceMethod("scanPageSync", &WrappedVsam::ScanPageSync),
+                   InstanceMethod("snapshotTo", &WrappedVsam::SnapshotTo),
+                   InstanceMethod("findAll", &WrappedVsam::FindAll),
+                   InstanceMethod("findAllSync", &WrappedVsam::FindAllSync),
+                   InstanceMethod("buildIndex", &WrappedVsam::BuildIndex),
+                   InstanceMethod("buildIndexSync",
+                                  &WrappedVsam::BuildIndexSync),
+                   InstanceMethod("findBy", &WrappedVsam::FindBy),
+                   InstanceMethod("findBySync", &WrappedVsam::FindBySync),
+                   InstanceMethod("indexStats", &WrappedVsam::IndexStats),
+                   InstanceMethod("setWriteBehind",
+                                  &WrappedVsam::SetWriteBehind),
+                   InstanceMethod("flush", &WrappedVsam::Flush),
+                   InstanceMethod("exec", &WrappedVsam::Exec),
+                   InstanceMethod("setDeadline", &WrappedVsam::SetDeadline),
+                   InstanceMethod("queueStats", &WrappedVsam::QueueStats_),
+                   InstanceMethod("setMaxInFlight",
+                                  &WrappedVsam::SetMaxInFlight),
+                   InstanceMethod("execSync", &WrappedVsam::ExecSync),
+                   InstanceMethod("_beginCancellable",
+                                  &WrappedVsam::BeginCancellable),
+                   InstanceMethod("_endCancellable",
+                                  &WrappedVsam::EndCancellable),
+                   InstanceMethod("_beginQueueOptions",
+                                  &WrappedVsam::BeginQueueOptions),
+                   InstanceMethod("_endQueueOptions",
+                                  &WrappedVsam::EndQueueOptions),
+                   InstanceMethod("_cancel", &WrappedVsam::Cancel),
+                   InstanceMethod("_cancelDone", &WrappedVsam::CancelDone),
+                   InstanceMethod("_openCursor", &WrappedVsam::OpenCursor),
+                   InstanceMethod("_useCursor", &WrappedVsam::UseCursor),
+                   InstanceMethod("_closeCursor", &WrappedVsam::CloseCursor),
                    InstanceMethod("close", &WrappedVsam::Close),
+                   InstanceMethod("closeAsync", &WrappedVsam::CloseAsync),
                    InstanceMethod("dealloc", &WrappedVsam::Dealloc)});
 
-  constructor_ = Napi::Persistent(func);
-  constructor_.SuppressDestruct();
+  AddonData *pAddonData = new AddonData;
+  pAddonData->constructor = Napi::Persistent(func);
+  Napi::Function batchFunc = RecordBatch::Init(env);
+  pAddonData->recordBatchConstructor = Napi::Persistent(batchFunc);
+  Napi::Function snapshotFunc = Snapshot::Init(env);
+  pAddonData->snapshotConstructor = Napi::Persistent(snapshotFunc);
+  Napi::Function schemaFunc = CompiledSchema::Init(env);
+  pAddonData->compiledSchemaConstructor = Napi::Persistent(schemaFunc);
+  napi_status status = napi_get_uv_event_loop(env, &pAddonData->loop);
+  assert(status == napi_ok);
+  status = napi_set_instance_data(env, pAddonData, DeleteAddonData, nullptr);
+  assert(status == napi_ok);
+  status = napi_add_env_cleanup_hook(env, Cleanup, pAddonData);
+  assert(status == napi_ok);
+  pAddonData->laterAsync = new uv_async_t;
+  uv_async_init(pAddonData->loop, pAddonData->laterAsync, LaterComplete);
+  pAddonData->laterAsync->data = pAddonData;
+  // only referenced while there are requests to complete
+  uv_unref((uv_handle_t *)pAddonData->laterAsync);
 
   exports.Set("WrappedVsam", func);
+  exports.Set("RecordBatch", batchFunc);
+  exports.Set("Snapshot", snapshotFunc);
+  exports.Set("CompiledSchema", schemaFunc);
   return exports;
 }
 
 // static
-Napi::Object WrappedVsam::Construct(const Napi::CallbackInfo &info,
-                                    bool alloc) {
+bool WrappedVsam::parseSchema(const Napi::CallbackInfo &info,
+                              const Napi::Object &schema, const char *pApiName,
+                              std::vector<LayoutItem> &layout, int &key_i,
+                              int &keypos, bool *paltKey) {
   Napi::Env env = info.Env();
-  Napi::EscapableHandleScope scope(env);
-  const char *pApiName = alloc ? "allocSync" : "openSync";
-
-  std::string path(static_cast<std::string>(info[0].As<Napi::String>()));
-  const Napi::Object &schema = info[1].ToObject();
-  const std::string &mode =
-      info.Length() == 2
-          ? "rb+,type=record"
-          : (static_cast<std::string>(info[2].As<Napi::String>()));
   const Napi::Array &properties = schema.GetPropertyNames();
-  std::vector<LayoutItem> layout;
-  int key_i = 0; // for its data type - default to first field if no "key" found
-  int curpos = 0, keypos = 0;
+  key_i = 0; // for its data type - default to first field if no "key" found
+  keypos = 0;
+  int curpos = 0;
+  int altkey_i = -1, altkeypos = 0;
 
   for (size_t i = 0; i < properties.Length(); ++i) {
     std::string name(static_cast<std::string>(
@@ -358,7 +1124,7 @@ Napi::Object WrappedVsam::Construct(const Napi::CallbackInfo &info,
     if (item.IsEmpty()) {
       throwError(info, -1, ARG0_TYPE_NONE, false,
                  "%s error in JSON: item %d is empty.", pApiName, i + 1);
-      return env.Null().ToObject();
+      return false;
     }
 
     int minLength = 0; // minLength is optional, default 0 unless it's a key
@@ -369,7 +1135,7 @@ Napi::Object WrappedVsam::Construct(const Napi::CallbackInfo &info,
             info, -1, ARG0_TYPE_NONE, true,
             "%s error in JSON (item %d): minLength value must be numeric.",
             pApiName, i + 1);
-        return env.Null().ToObject();
+        return false;
       } else if (!vminLength.IsEmpty()) {
         minLength = vminLength.ToNumber().Int32Value();
         if (minLength < 0) {
@@ -377,7 +1143,7 @@ Napi::Object WrappedVsam::Construct(const Napi::CallbackInfo &info,
               info, -1, ARG0_TYPE_NONE, true,
               "%s error in JSON (item %d): minLength value cannot be negative.",
               pApiName, i + 1);
-          return env.Null().ToObject();
+          return false;
         }
       }
     }
@@ -387,14 +1153,14 @@ Napi::Object WrappedVsam::Construct(const Napi::CallbackInfo &info,
       throwError(info, -1, ARG0_TYPE_NONE, true,
                  "%s error in JSON (item %d): maxLength must be specified.",
                  pApiName, i + 1);
-      return env.Null().ToObject();
+      return false;
     }
     const Napi::Value &vmaxLength = item.Get("maxLength");
     if (!vmaxLength.IsNumber()) {
       throwError(info, -1, ARG0_TYPE_NONE, true,
                  "%s error in JSON (item %d): maxLength must be numeric.",
                  pApiName, i + 1);
-      return env.Null().ToObject();
+      return false;
     } else {
       maxLength = vmaxLength.ToNumber().Int32Value();
       if (maxLength <= 0) {
@@ -402,7 +1168,7 @@ Napi::Object WrappedVsam::Construct(const Napi::CallbackInfo &info,
                    "%s error in JSON (item %d): maxLength value must be "
                    "greater than 0.",
                    pApiName, i + 1);
-        return env.Null().ToObject();
+        return false;
       }
     }
 
@@ -411,7 +1177,7 @@ Napi::Object WrappedVsam::Construct(const Napi::CallbackInfo &info,
                  "%s error in JSON (item %d): minLength cannot be greater than "
                  "maxLength.",
                  pApiName, i + 1);
-      return env.Null().ToObject();
+      return false;
     }
 
     if (item.Has("type")) {
@@ -421,31 +1187,49 @@ Napi::Object WrappedVsam::Construct(const Napi::CallbackInfo &info,
 
       if (!strcmp(stype.c_str(), "string")) {
         layout.push_back(
-            LayoutItem(name, minLength, maxLength, LayoutItem::STRING));
+            LayoutItem(name, minLength, maxLength, LayoutItem::STRING, curpos));
       } else if (!strcmp(stype.c_str(), "hexadecimal")) {
-        layout.push_back(
-            LayoutItem(name, minLength, maxLength, LayoutItem::HEXADECIMAL));
+        layout.push_back(LayoutItem(name, minLength, maxLength,
+                                    LayoutItem::HEXADECIMAL, curpos));
       } else {
         throwError(info, -1, ARG0_TYPE_NONE, true,
                    "%s error in JSON (item %d): \"type\" must be either "
                    "\"string\" or \"hexadecimal\"",
                    pApiName, i + 1);
-        return env.Null().ToObject();
+        return false;
       }
       if (!strcmp(name.c_str(), "key")) {
         key_i = i;
         keypos = curpos;
       }
+      if (item.Has("alternateKey") && item.Get("alternateKey").ToBoolean()) {
+        if (altkey_i >= 0) {
+          throwError(info, -1, ARG0_TYPE_NONE, true,
+                     "%s error in JSON (item %d): only one field can be the "
+                     "alternateKey.",
+                     pApiName, i + 1);
+          return false;
+        }
+        altkey_i = i;
+        altkeypos = curpos;
+      }
     } else {
       throwError(
           info, -1, ARG0_TYPE_NONE, true,
           "%s error in JSON (item %d): \"type\" must be specified (string "
           "or hexadecimal)",
           pApiName, i + 1);
-      return env.Null().ToObject();
+      return false;
     }
     curpos += maxLength;
   }
+  if (altkey_i >= 0) {
+    // opened through a path, the dataset's key is the alternate key
+    key_i = altkey_i;
+    keypos = altkeypos;
+  }
+  if (paltKey != nullptr)
+    *paltKey = altkey_i >= 0;
   const Napi::Object &item =
       schema.Get(properties.Get(key_i)).As<Napi::Object>();
   DCHECK(!item.IsEmpty());
@@ -457,16 +1241,64 @@ Napi::Object WrappedVsam::Construct(const Napi::CallbackInfo &info,
                  "%s error in JSON (item %d): minLength of key '%s' must be "
                  "greater than 0.",
                  pApiName, key_i + 1, layout[key_i].name.c_str());
-      return env.Null().ToObject();
+      return false;
     }
   } else
     layout[key_i].minLength = 1;
 
-  Napi::Object obj = constructor_.New(
+  return true;
+}
+
+// static
+Napi::Object WrappedVsam::Construct(const Napi::CallbackInfo &info,
+                                    bool alloc, const char *pApiName,
+                                    bool async) {
+  Napi::Env env = info.Env();
+  Napi::EscapableHandleScope scope(env);
+
+  std::string path(static_cast<std::string>(info[0].As<Napi::String>()));
+  const Napi::Object &schema = info[1].ToObject();
+  const std::string &mode =
+      info.Length() == 2 || !info[2].IsString()
+          ? "rb+,type=record"
+          : (static_cast<std::string>(info[2].As<Napi::String>()));
+  // the options object, if any, is the last argument after the schema
+  bool direct = false;
+  if (info.Length() > 2 && info[info.Length() - 1].IsObject()) {
+    const Napi::Value &vdirect =
+        info[info.Length() - 1].ToObject().Get("direct");
+    if (!vdirect.IsUndefined() && !vdirect.IsBoolean()) {
+      throwError(info, -1, ARG0_TYPE_NONE, true,
+                 "%s error: direct must be a boolean.", pApiName);
+      return env.Null().ToObject();
+    }
+    direct = vdirect.ToBoolean();
+  }
+  // a schema of compileSchema() is used as is, any other is parsed
+  std::shared_ptr<const SchemaLayout> pSchema =
+      CompiledSchema::get(env, info[1]);
+  if (pSchema == nullptr) {
+    std::shared_ptr<SchemaLayout> pParsed = std::make_shared<SchemaLayout>();
+    if (!parseSchema(info, schema, pApiName, pParsed->layout, pParsed->key_i,
+                     pParsed->keypos, &pParsed->altKey))
+      return env.Null().ToObject();
+    pSchema = pParsed;
+  }
+  if (alloc && pSchema->altKey) {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "%s error in JSON: alternateKey can only be used to open an "
+               "alternate index path.",
+               pApiName);
+    return env.Null().ToObject();
+  }
+
+  Napi::Object obj = getAddonData(env)->constructor.New(
       {Napi::String::New(env, path),
-       Napi::Buffer<std::vector<LayoutItem>>::Copy(env, &layout, layout.size()),
-       Napi::Number::New(env, key_i), Napi::Number::New(env, keypos),
-       Napi::String::New(env, mode), Napi::Boolean::New(env, alloc)});
+       Napi::External<std::shared_ptr<const SchemaLayout>>::New(env, &pSchema),
+       Napi::String::New(env, mode), Napi::Boolean::New(env, alloc),
+       Napi::Boolean::New(env, async), Napi::Boolean::New(env, direct)});
+  if (async)
+    return scope.Escape(napi_value(obj)).ToObject();
   std::string errmsg;
   WrappedVsam *p = Napi::ObjectWrap<WrappedVsam>::Unwrap(obj);
   if (!p || !p->pVsamFile_ || p->pVsamFile_->getLastError(errmsg) ||
@@ -495,20 +1327,108 @@ Napi::Object WrappedVsam::AllocSync(const Napi::CallbackInfo &info) {
                "VSAM dataset name, schema JSON object.");
     return info.Env().Null().ToObject();
   }
-  return Construct(info, true);
+  return Construct(info, true, "allocSync");
 }
 
 // static
 Napi::Object WrappedVsam::OpenSync(const Napi::CallbackInfo &info) {
   if ((info.Length() < 2 || !info[0].IsString() || !info[1].IsObject()) ||
-      (info.Length() == 3 && !info[2].IsString()) || (info.Length() > 3)) {
+      (info.Length() == 3 && !info[2].IsString() && !info[2].IsObject()) ||
+      (info.Length() == 4 && (!info[2].IsString() || !info[3].IsObject())) ||
+      (info.Length() > 4)) {
     Napi::HandleScope scope(info.Env());
     throwError(info, -1, ARG0_TYPE_NONE, true,
                "openSync error: openSync() expects arguments: VSAM dataset "
-               "name, schema JSON object, optional fopen() mode.");
+               "name, schema JSON object, optional fopen() mode, optional "
+               "options.");
     return info.Env().Null().ToObject();
   }
-  return Construct(info, false);
+  return Construct(info, false, "openSync");
+}
+
+// static
+Napi::Value WrappedVsam::ConstructAsync(const Napi::CallbackInfo &info,
+                                        bool alloc, const char *pApiName) {
+  // the schema is validated as for openSync() or allocSync(), then fopen(),
+  // or dynalloc() and fopen(), run on the thread pool
+  Napi::Env env = info.Env();
+  Napi::Object obj = Construct(info, alloc, pApiName, true);
+  if (env.IsExceptionPending())
+    return rejectPending(env);
+  WrappedVsam *p = Napi::ObjectWrap<WrappedVsam>::Unwrap(obj);
+  Napi::Function dummycb;
+  UvWorkData *pdata = new UvWorkData(p->pVsamFile_, dummycb, env);
+  napi_value promise;
+  if (napi_create_promise(env, &pdata->deferred_, &promise) != napi_ok) {
+    delete pdata;
+    p->deleteVsamFileObj();
+    Napi::Error::New(env).ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  pdata->pOwner_ = p;
+  p->Ref(); // until OpenComplete()
+  uv_work_t *request = new uv_work_t;
+  request->data = pdata;
+  p->pVsamFile_->workQueued();
+  uv_queue_work(eventLoop(env), request, alloc ? AllocExecute : OpenExecute,
+                OpenComplete);
+  return Napi::Value(env, promise);
+}
+
+// static
+Napi::Value WrappedVsam::AllocAsync(const Napi::CallbackInfo &info) {
+  if (info.Length() != 2 || !info[0].IsString() || !info[1].IsObject()) {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "allocAsync error: allocAsync() expects arguments: "
+               "VSAM dataset name, schema JSON object.");
+    return rejectPending(info.Env());
+  }
+  return ConstructAsync(info, true, "allocAsync");
+}
+
+// static
+Napi::Value WrappedVsam::OpenAsync(const Napi::CallbackInfo &info) {
+  if ((info.Length() < 2 || !info[0].IsString() || !info[1].IsObject()) ||
+      (info.Length() == 3 && !info[2].IsString()) || (info.Length() > 3)) {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "openAsync error: openAsync() expects arguments: VSAM dataset "
+               "name, schema JSON object, optional fopen() mode.");
+    return rejectPending(info.Env());
+  }
+  return ConstructAsync(info, false, "openAsync");
+}
+
+void WrappedVsam::OpenExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  pdata->pVsamFile_->routeToVsamThread(MSG_OPEN, &VsamFile::open);
+}
+
+void WrappedVsam::AllocExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  pdata->pVsamFile_->routeToVsamThread(MSG_OPEN, &VsamFile::alloc);
+}
+
+void WrappedVsam::OpenComplete(uv_work_t *req, int status) {
+  if (dropIfEnvExited(req))
+    return;
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *pVsamFile = pdata->pVsamFile_;
+  delete req;
+  Napi::HandleScope scope(pdata->env_);
+  WrappedVsam *p = static_cast<WrappedVsam *>(pdata->pOwner_);
+  Napi::Object obj = p->Value();
+  if (status != UV_ECANCELED && p->pVsamFile_ != nullptr &&
+      p->pVsamFile_->getLastError(pdata->errmsg_) == 0 &&
+      p->pVsamFile_->isDatasetOpen())
+    pdata->rc_ = 0;
+  else {
+    if (pdata->errmsg_.empty())
+      pdata->errmsg_ = "open error: failed to construct VsamFile object.";
+    p->deleteVsamFileObj();
+  }
+  settlePromise(pdata, obj);
+  p->Unref();
+  workDone(pVsamFile);
 }
 
 // static
@@ -527,8 +1447,21 @@ void WrappedVsam::Close(const Napi::CallbackInfo &info) {
 #ifdef DEBUG
   fprintf(stderr, "Closing VSAM dataset...\n");
 #endif
-  if (errorIfNotOpen(info, -1, ARG0_TYPE_NONE, "close"))
+  if (errorIfNotOpen(info, -1, ARG0_TYPE_NONE, "close", false))
+    return;
+  if (batchesWriting_ > 0 || !staged_.empty()) {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, -1, ARG0_TYPE_NONE, false,
+               "close error: write-behind records must be flushed first.");
+    return;
+  }
+  if (!pVsamFile_->getInFlight().waiting.empty()) {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, -1, ARG0_TYPE_NONE, false,
+               "close error: %d requests are waiting to be started.",
+               (int)pVsamFile_->getInFlight().waiting.size());
     return;
+  }
   static Napi::Function dummy;
   UvWorkData uvdata(nullptr, dummy, nullptr);
   pVsamFile_->routeToVsamThread(MSG_CLOSE, &VsamFile::Close, &uvdata);
@@ -544,8 +1477,81 @@ void WrappedVsam::Close(const Napi::CallbackInfo &info) {
   deleteVsamFileObj();
 }
 
+Napi::Value WrappedVsam::CloseAsync(const Napi::CallbackInfo &info) {
+  if (errorIfNotOpen(info, -1, ARG0_TYPE_NONE, "closeAsync", false))
+    return rejectPending(info.Env());
+  if (info.Length() != 0) {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "closeAsync error: closeAsync() expects no argument.");
+    return rejectPending(info.Env());
+  }
+  if (pVsamFile_->isDirect()) {
+    throwError(info, -1, ARG0_TYPE_NONE, false,
+               "closeAsync error: the dataset was opened with "
+               "{direct: true}, call close() instead.");
+    return rejectPending(info.Env());
+  }
+  if (batchesWriting_ > 0 || !staged_.empty()) {
+    throwError(info, -1, ARG0_TYPE_NONE, false,
+               "closeAsync error: write-behind records must be flushed "
+               "first.");
+    return rejectPending(info.Env());
+  }
+  // the VSAM thread ends with the close, so nothing can be queued after it
+  if (pVsamFile_->getInFlight().count > 0 ||
+      !pVsamFile_->getInFlight().waiting.empty()) {
+    throwError(info, -1, ARG0_TYPE_NONE, false,
+               "closeAsync error: %d requests are in flight or waiting to be "
+               "started.",
+               (int)(pVsamFile_->getInFlight().count +
+                     pVsamFile_->getInFlight().waiting.size()));
+    return rejectPending(info.Env());
+  }
+  Napi::Env env = info.Env();
+  Napi::Function dummycb;
+  UvWorkData *pdata = new UvWorkData(pVsamFile_, dummycb, env);
+  napi_value promise;
+  if (napi_create_promise(env, &pdata->deferred_, &promise) != napi_ok) {
+    delete pdata;
+    Napi::Error::New(env).ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  pdata->pOwner_ = this;
+  closing_ = true;
+  Ref(); // until CloseComplete()
+  uv_work_t *request = new uv_work_t;
+  request->data = pdata;
+  pVsamFile_->workQueued();
+  uv_queue_work(eventLoop(env), request, CloseExecute, CloseComplete);
+  return Napi::Value(env, promise);
+}
+
+void WrappedVsam::CloseExecute(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  pdata->pVsamFile_->routeToVsamThread(MSG_CLOSE, &VsamFile::Close, pdata);
+}
+
+void WrappedVsam::CloseComplete(uv_work_t *req, int status) {
+  if (dropIfEnvExited(req))
+    return;
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *pVsamFile = pdata->pVsamFile_;
+  delete req;
+  Napi::HandleScope scope(pdata->env_);
+  WrappedVsam *p = static_cast<WrappedVsam *>(pdata->pOwner_);
+  p->closing_ = false;
+  if (status == UV_ECANCELED)
+    pdata->errmsg_ = "closeAsync error: the close was cancelled.";
+  else if (pdata->rc_ == 0)
+    p->deleteVsamFileObj();
+  settlePromise(pdata, pdata->env_.Undefined());
+  p->Unref();
+  workDone(pVsamFile);
+}
+
 void WrappedVsam::Delete(const Napi::CallbackInfo &info) {
-  if (info.Length() == 2 && info[0].IsString() && info[1].IsFunction()) {
+  if (info.Length() == 2 && (info[0].IsString() || info[0].IsBuffer()) &&
+      info[1].IsFunction()) {
     FindDelete_(info, "delete", nullptr, 1); // callback arg #
   } else if (info.Length() == 3 && info[0].IsObject() && info[1].IsNumber() &&
              info[2].IsFunction()) {
@@ -558,7 +1564,7 @@ void WrappedVsam::Delete(const Napi::CallbackInfo &info) {
                "delete error: delete() expects arguments: "
                "(err), or: "
                "key-string, (count, err), or: "
-               "key-buffer, key-buffer-length, (count, err).");
+               "key-buffer[, key-buffer-length], (count, err).");
   }
 }
 
@@ -578,7 +1584,7 @@ int WrappedVsam::Delete_(const Napi::CallbackInfo &info, UvWorkData **ppdata) {
   uv_work_t *request = new uv_work_t;
   Napi::Function cb = info[0].As<Napi::Function>();
   request->data = new UvWorkData(pVsamFile_, cb, info.Env());
-  uv_queue_work(uv_default_loop(), request, DeleteExecute, DeleteComplete);
+  queueWork(request, DeleteExecute, DeleteComplete);
   return 0;
 }
 
@@ -588,7 +1594,7 @@ Napi::Value WrappedVsam::DeleteSync(const Napi::CallbackInfo &info) {
   int rc;
   bool findDelete = true;
 
-  if ((info.Length() == 1 && info[0].IsString()) ||
+  if ((info.Length() == 1 && (info[0].IsString() || info[0].IsBuffer())) ||
       (info.Length() == 2 && info[0].IsObject() && info[1].IsNumber())) {
     if (FindDelete_(info, "deleteSync", &pdata))
       return Napi::Number::New(info.Env(), 0);
@@ -600,11 +1606,12 @@ Napi::Value WrappedVsam::DeleteSync(const Napi::CallbackInfo &info) {
     throwError(info, -1, ARG0_TYPE_NONE, true,
                "deleteSync error: deleteSync() expects arguments: "
                "key-string, "
-               "or: key-buffer, key-buffer-length.");
+               "or: key-buffer[, key-buffer-length].");
     return Napi::Number::New(info.Env(), 0);
   }
 
   assert(pdata != nullptr);
+  pVsamFile_->fencePendingFinds();
 
   if (findDelete) {
     rc = pVsamFile_->routeToVsamThread(MSG_FIND_DELETE,
@@ -638,62 +1645,40 @@ int WrappedVsam::Write_(const Napi::CallbackInfo &info, const char *pApiName,
                         UvWorkData **ppdata) {
   CbFirstArgType firstArgType =
       ppdata == nullptr ? ARG0_TYPE_ERR : ARG0_TYPE_NONE;
-  if (errorIfNotOpen(info, 0, firstArgType, pApiName))
+  // a record staged isn't written before those staged ahead of it
+  if (errorIfNotOpen(info, 0, firstArgType, pApiName,
+                     writeBehind_ == 0 || ppdata != nullptr))
     return -1;
   Napi::HandleScope scope(info.Env());
 
-  const Napi::Object &record = info[0].ToObject();
   int reclen = pVsamFile_->getRecordLength();
   char *recbuf = (char *)malloc(reclen);
   DCHECK(recbuf != nullptr && reclen > 0);
-  memset(recbuf, 0, reclen);
-  char *fldbuf = recbuf;
-  std::vector<LayoutItem> &layout = pVsamFile_->getLayout();
   std::string errmsg;
 
-  for (auto i = layout.begin(); i != layout.end(); ++i) {
-    const Napi::Value &field = record.Get(i->name);
+  if (!encodeRecord(info[0].ToObject(), pApiName, recbuf, errmsg)) {
+    free(recbuf);
+    throwError(info, 0, firstArgType, true, errmsg.c_str());
+    return -1;
+  }
 
-    if (i->type == LayoutItem::STRING || i->type == LayoutItem::HEXADECIMAL) {
-#ifdef DEBUG
-      if (field.IsUndefined()) {
-        fprintf(stderr,
-                "%s value of %s was not set, will attempt to set it to "
-                "all 0x00\n",
-                pApiName, i->name.c_str());
-      }
-#endif
-      const std::string &str =
-          field.IsUndefined() ? ""
-                              : static_cast<std::string>(
-                                    Napi::String(info.Env(), field.ToString()));
-      if (i->type == LayoutItem::STRING) {
-        if (!VsamFile::isStrValid(*i, str, pApiName, errmsg)) {
-          free(recbuf);
-          throwError(info, 0, firstArgType, true, errmsg.c_str());
-          return -1;
-        }
-        DCHECK(str.length() <= i->maxLength);
-        DCHECK((fldbuf - recbuf) + str.length() <= reclen);
-        if (str.length() > 0)
-          memcpy(fldbuf, str.c_str(), str.length());
-      } else {
-        if (!VsamFile::isHexStrValid(*i, str, pApiName, errmsg)) {
-          free(recbuf);
-          throwError(info, 0, firstArgType, true, errmsg.c_str());
-          return -1;
-        }
-        DCHECK((fldbuf - recbuf) + i->maxLength <= reclen);
-        VsamFile::hexstrToBuffer(fldbuf, i->maxLength, str.c_str());
-      }
-    } else {
-      free(recbuf);
-      throwError(info, 0, firstArgType, true,
-                 "%s error: unexpected JSON data type %d for %s.", pApiName,
-                 i->type, i->name.c_str());
-      return -1;
+  if (writeBehind_ > 0 && ppdata == nullptr) {
+    // staged, replacing a record with the same key that isn't written yet
+    std::string key(recbuf + pVsamFile_->getKeyPosition(),
+                    pVsamFile_->getKeyLength());
+    staged_[key].assign(recbuf, reclen);
+    free(recbuf);
+    if (staged_.size() >= writeBehind_)
+      writeStaged(info.Env());
+    if (info.Length() > 1) {
+      uv_work_t *request = new uv_work_t;
+      Napi::Function cb = info[1].As<Napi::Function>();
+      UvWorkData *pdata = new UvWorkData(pVsamFile_, cb, info.Env());
+      pdata->rc_ = 0;
+      request->data = pdata;
+      completeLater(request, WriteComplete);
     }
-    fldbuf += i->maxLength;
+    return 0;
   }
 
   if (ppdata != nullptr) {
@@ -705,12 +1690,13 @@ int WrappedVsam::Write_(const Napi::CallbackInfo &info, const char *pApiName,
   uv_work_t *request = new uv_work_t;
   Napi::Function cb = info[1].As<Napi::Function>();
   request->data = new UvWorkData(pVsamFile_, cb, info.Env(), "", recbuf);
-  uv_queue_work(uv_default_loop(), request, WriteExecute, WriteComplete);
+  queueWork(request, WriteExecute, WriteComplete);
   return 0;
 }
 
 void WrappedVsam::Write(const Napi::CallbackInfo &info) {
-  if (info.Length() == 2 && info[0].IsObject() && info[1].IsFunction())
+  if ((info.Length() == 2 && info[0].IsObject() && info[1].IsFunction()) ||
+      (writeBehind_ > 0 && info.Length() == 1 && info[0].IsObject()))
     Write_(info, "write");
   else {
     Napi::HandleScope scope(info.Env());
@@ -731,6 +1717,7 @@ Napi::Value WrappedVsam::WriteSync(const Napi::CallbackInfo &info) {
                "writeSync error: writeSync() expects arguments: record.");
     return Napi::Number::New(info.Env(), 0);
   }
+  pVsamFile_->fencePendingFinds();
   int rc =
       pVsamFile_->routeToVsamThread(MSG_WRITE, &VsamFile::WriteExecute, pdata);
   if (rc || pdata->rc_) {
@@ -743,8 +1730,8 @@ Napi::Value WrappedVsam::WriteSync(const Napi::CallbackInfo &info) {
 }
 
 void WrappedVsam::Update(const Napi::CallbackInfo &info) {
-  if (info.Length() == 3 && info[0].IsString() && info[1].IsObject() &&
-      info[2].IsFunction()) {
+  if (info.Length() == 3 && (info[0].IsString() || info[0].IsBuffer()) &&
+      info[1].IsObject() && info[2].IsFunction()) {
     FindUpdate_(info, "update", nullptr, 1, 2); // record and callback arg #s
   } else if (info.Length() == 4 && info[0].IsObject() && info[1].IsNumber() &&
              info[2].IsObject() && info[3].IsFunction()) {
@@ -757,12 +1744,14 @@ void WrappedVsam::Update(const Napi::CallbackInfo &info) {
                "update error: update() expects arguments: "
                "record, (err), "
                "or: key-string, record, (count, err), "
-               "or: key-buffer, key-buffer-length, record, (count, err).");
+               "or: key-buffer[, key-buffer-length], record, (count, err).");
   }
 }
 
 int WrappedVsam::Update_(const Napi::CallbackInfo &info, const char *pApiName,
                          UvWorkData **ppdata) {
+  // Only the fields set in the record are encoded; if any field is not set,
+  // those set are merged on the VSAM thread into the record last read.
   CbFirstArgType firstArgType =
       ppdata == nullptr ? ARG0_TYPE_ERR : ARG0_TYPE_NONE;
   if (errorIfNotOpen(info, 0, firstArgType, pApiName))
@@ -774,59 +1763,36 @@ int WrappedVsam::Update_(const Napi::CallbackInfo &info, const char *pApiName,
   char *recbuf = (char *)malloc(reclen);
   DCHECK(recbuf != nullptr);
   memset(recbuf, 0, reclen);
-  char *fldbuf = recbuf;
-  std::vector<LayoutItem> &layout = pVsamFile_->getLayout();
+  std::vector<FieldToUpdate> *pupd = new std::vector<FieldToUpdate>;
   std::string errmsg;
 
-  for (auto i = layout.begin(); i != layout.end(); ++i) {
-    const Napi::Value &field = record.Get(i->name);
-    if (field.IsUndefined()) {
-      free(recbuf);
-      throwError(info, 0, firstArgType, true,
-                 "%s error: update value for %s has not been set.", pApiName,
-                 i->name.c_str());
-      return -1;
-    }
-    if (i->type == LayoutItem::STRING || i->type == LayoutItem::HEXADECIMAL) {
-      const std::string &str =
-          static_cast<std::string>(Napi::String(info.Env(), field.ToString()));
-      if (i->type == LayoutItem::STRING) {
-        if (!VsamFile::isStrValid(*i, str, pApiName, errmsg)) {
-          free(recbuf);
-          throwError(info, 0, firstArgType, true, errmsg.c_str());
-          return -1;
-        }
-        DCHECK(str.length() <= i->maxLength);
-        if (str.length() > 0)
-          memcpy(fldbuf, str.c_str(), str.length());
-      } else {
-        if (!VsamFile::isHexStrValid(*i, str, pApiName, errmsg)) {
-          free(recbuf);
-          throwError(info, 0, firstArgType, true, errmsg.c_str());
-          return -1;
-        }
-        VsamFile::hexstrToBuffer(fldbuf, i->maxLength, str.c_str());
-      }
-      fldbuf += i->maxLength;
-    } else {
-      free(recbuf);
-      throwError(info, 0, firstArgType, true,
-                 "%s error: unexpected data type %d for %s.", pApiName, i->type,
-                 i->name.c_str());
-      return -1;
-    }
+  if (!encodeFieldsToUpdate(record, pApiName, recbuf, pupd, errmsg)) {
+    free(recbuf);
+    delete pupd;
+    throwError(info, 0, firstArgType, true, errmsg.c_str());
+    return -1;
+  }
+  if (pupd->size() == pVsamFile_->getLayout().size()) {
+    // all fields are set, no need to merge
+    delete pupd;
+    pupd = nullptr;
   }
 
   if (ppdata != nullptr) {
     // called for a sync API
     Napi::Function dummycb;
-    *ppdata = new UvWorkData(pVsamFile_, dummycb, info.Env(), "", recbuf);
+    *ppdata = new UvWorkData(pVsamFile_, dummycb, info.Env(), "", recbuf,
+                             nullptr, 0, 0, pupd);
+    (*ppdata)->pApiName_ = pApiName;
     return 0;
   }
   uv_work_t *request = new uv_work_t;
   Napi::Function cb = info[1].As<Napi::Function>();
-  request->data = new UvWorkData(pVsamFile_, cb, info.Env(), "", recbuf);
-  uv_queue_work(uv_default_loop(), request, UpdateExecute, UpdateComplete);
+  UvWorkData *pdata = new UvWorkData(pVsamFile_, cb, info.Env(), "", recbuf,
+                                     nullptr, 0, 0, pupd);
+  pdata->pApiName_ = pApiName;
+  request->data = pdata;
+  queueWork(request, UpdateExecute, UpdateComplete);
   return 0;
 }
 
@@ -836,7 +1802,8 @@ Napi::Value WrappedVsam::UpdateSync(const Napi::CallbackInfo &info) {
   int rc;
   bool findUpdate = true;
 
-  if (info.Length() == 2 && info[0].IsString() && info[1].IsObject()) {
+  if (info.Length() == 2 && (info[0].IsString() || info[0].IsBuffer()) &&
+      info[1].IsObject()) {
     if (FindUpdate_(info, "updateSync", &pdata, 1,
                     -1)) // record and callback arg #s
       return Napi::Number::New(info.Env(), 0);
@@ -853,11 +1820,12 @@ Napi::Value WrappedVsam::UpdateSync(const Napi::CallbackInfo &info) {
                "updateSync error: updateSync() expects arguments: "
                "record, "
                "or: key-string, record, "
-               "or: key-buffer, key-buffer-length, record.");
+               "or: key-buffer[, key-buffer-length], record.");
     return Napi::Number::New(info.Env(), 0);
   }
 
   assert(pdata != nullptr);
+  pVsamFile_->fencePendingFinds();
 
   if (findUpdate) {
     rc = pVsamFile_->routeToVsamThread(MSG_FIND_UPDATE,
@@ -875,8 +1843,11 @@ Napi::Value WrappedVsam::UpdateSync(const Napi::CallbackInfo &info) {
     delete pdata;
     return Napi::Number::New(info.Env(), count);
   } else {
-    rc = pVsamFile_->routeToVsamThread(MSG_UPDATE, &VsamFile::UpdateExecute,
-                                       pdata);
+    rc = pVsamFile_->routeToVsamThread(
+        MSG_UPDATE,
+        pdata->pFieldsToUpdate_ ? &VsamFile::UpdateFieldsExecute
+                                : &VsamFile::UpdateExecute,
+        pdata);
     if (rc || pdata->rc_) {
       throwError(info, -1, ARG0_TYPE_NONE, true, pdata->errmsg_.c_str());
       delete pdata;
@@ -888,7 +1859,8 @@ Napi::Value WrappedVsam::UpdateSync(const Napi::CallbackInfo &info) {
 }
 
 void WrappedVsam::FindEq(const Napi::CallbackInfo &info) {
-  if (info.Length() == 2 && info[0].IsString() && info[1].IsFunction())
+  if (info.Length() == 2 && (info[0].IsString() || info[0].IsBuffer()) &&
+      info[1].IsFunction())
     Find(info, __KEY_EQ, "find", 1);
   else if (info.Length() == 3 && info[0].IsObject() && info[1].IsNumber() &&
            info[2].IsFunction())
@@ -898,13 +1870,14 @@ void WrappedVsam::FindEq(const Napi::CallbackInfo &info) {
     throwError(info, 1, ARG0_TYPE_NULL, true,
                "find error: find() expects arguments: "
                "key-string, (record, err), "
-               "or key-buffer, key-buffer-length, (record, err).");
+               "or key-buffer[, key-buffer-length], (record, err).");
   }
 }
 
 Napi::Value WrappedVsam::FindSync_(const Napi::CallbackInfo &info,
                                    UvWorkData *pdata) {
   assert(pdata != nullptr);
+  pdata->pCursor_ = pVsamFile_->getIssuingCursor();
   int rc =
       pVsamFile_->routeToVsamThread(MSG_FIND, &VsamFile::FindExecute, pdata);
   if (rc || pdata->rc_) {
@@ -925,21 +1898,22 @@ Napi::Value WrappedVsam::FindEqSync(const Napi::CallbackInfo &info) {
   Napi::HandleScope scope(info.Env());
   UvWorkData *pdata = nullptr;
   if ((info.Length() == 2 && info[0].IsObject() && info[1].IsNumber()) ||
-      (info.Length() == 1 && info[0].IsString())) {
+      (info.Length() == 1 && (info[0].IsString() || info[0].IsBuffer()))) {
     if (Find(info, __KEY_EQ, "findSync", -1, &pdata, ARG0_TYPE_NONE))
       return info.Env().Null();
   } else {
     throwError(info, -1, ARG0_TYPE_NONE, true,
                "findSync error: findSync() expects arguments: "
                "key-string, "
-               "or key-buffer, key-buffer-length.");
+               "or key-buffer[, key-buffer-length].");
     return info.Env().Null();
   }
   return FindSync_(info, pdata);
 }
 
 void WrappedVsam::FindGe(const Napi::CallbackInfo &info) {
-  if (info.Length() == 2 && info[0].IsString() && info[1].IsFunction()) {
+  if (info.Length() == 2 && (info[0].IsString() || info[0].IsBuffer()) &&
+      info[1].IsFunction()) {
     Find(info, __KEY_GE, "findge", 1);
   } else if (info.Length() == 3 && info[0].IsObject() && info[1].IsNumber() &&
              info[2].IsFunction()) {
@@ -949,7 +1923,7 @@ void WrappedVsam::FindGe(const Napi::CallbackInfo &info) {
     throwError(info, 1, ARG0_TYPE_NULL, true,
                "findge error: findge() expects arguments: "
                "or key-string, (record, err), "
-               "or key-buffer, key-buffer-length, (record, err).");
+               "or key-buffer[, key-buffer-length], (record, err).");
   }
 }
 
@@ -957,14 +1931,14 @@ Napi::Value WrappedVsam::FindGeSync(const Napi::CallbackInfo &info) {
   Napi::HandleScope scope(info.Env());
   UvWorkData *pdata = nullptr;
   if ((info.Length() == 2 && info[0].IsObject() && info[1].IsNumber()) ||
-      (info.Length() == 1 && info[0].IsString())) {
+      (info.Length() == 1 && (info[0].IsString() || info[0].IsBuffer()))) {
     if (Find(info, __KEY_GE, "findgeSync", -1, &pdata, ARG0_TYPE_NONE))
       return info.Env().Null();
   } else {
     throwError(info, -1, ARG0_TYPE_NONE, true,
                "findgeSync error: findgeSync() expects arguments: "
                "key-string, "
-               "or key-buffer, key-buffer-length.");
+               "or key-buffer[, key-buffer-length].");
     return info.Env().Null();
   }
   return FindSync_(info, pdata);
@@ -1027,16 +2001,38 @@ int WrappedVsam::Find(const Napi::CallbackInfo &info, int equality,
   if (errorIfNotOpen(info, 1, firstArgType, pApiName))
     return -1;
   Napi::HandleScope scope(info.Env());
-  std::string key;
-  char *keybuf = nullptr;
+  // the key is decoded on the stack, then copied into the request, which
+  // keeps it inline; a Buffer key is read in place (with its byteOffset)
+  char keystack[UvWorkData::KEY_INLINE_SIZE];
+  std::string keyheap;
+  const char *keybuf = nullptr;
   size_t keybuf_len = 0;
   int key_i = pVsamFile_->getKeyNum();
-  std::vector<LayoutItem> &layout = pVsamFile_->getLayout();
+  const std::vector<LayoutItem> &layout = pVsamFile_->getLayout();
+  char *decodebuf = keystack;
+  if (layout[key_i].maxLength > sizeof(keystack)) {
+    keyheap.resize(layout[key_i].maxLength);
+    decodebuf = &keyheap[0];
+  }
   std::string errmsg;
 
   if (equality != __KEY_LAST && equality != __KEY_FIRST) {
-    if (info[0].IsString()) {
-      key = static_cast<std::string>(info[0].As<Napi::String>());
+    size_t len;
+    // the length is taken first, as a string too long for the buffer is cut
+    // at a character boundary, which can leave it shorter than the buffer
+    if (info[0].IsString() && layout[key_i].type == LayoutItem::STRING &&
+        decodebuf == keystack &&
+        napi_get_value_string_utf8(info.Env(), info[0], nullptr, 0, &len) ==
+            napi_ok &&
+        len < sizeof(keystack) && len >= layout[key_i].minLength &&
+        len <= layout[key_i].maxLength &&
+        napi_get_value_string_utf8(info.Env(), info[0], keystack,
+                                   sizeof(keystack), &len) == napi_ok) {
+      // a valid string key, read without a std::string
+      keybuf = keystack;
+      keybuf_len = len;
+    } else if (info[0].IsString()) {
+      std::string key = info[0].As<Napi::String>();
 #ifdef DEBUG
       fprintf(stderr, "%s key=<%s>\n", pApiName, key.c_str());
 #endif
@@ -1045,36 +2041,39 @@ int WrappedVsam::Find(const Napi::CallbackInfo &info, int equality,
           throwError(info, 1, firstArgType, true, errmsg.c_str());
           return -1;
         }
-        keybuf = (char *)malloc(layout[key_i].maxLength);
-        keybuf_len = VsamFile::hexstrToBuffer(keybuf, layout[key_i].maxLength,
-                                              key.c_str());
+        keybuf_len = VsamFile::hexstrToBuffer(
+            decodebuf, layout[key_i].maxLength, key.c_str());
       } else {
         if (!VsamFile::isStrValid(layout[key_i], key, pApiName, errmsg)) {
           throwError(info, 1, firstArgType, true, errmsg.c_str());
           return -1;
         }
-        keybuf = (char *)malloc(layout[key_i].maxLength);
         keybuf_len = key.length();
-        memcpy(keybuf, key.c_str(), keybuf_len);
+        memcpy(decodebuf, key.c_str(), keybuf_len);
       }
-    } else if (info[0].IsObject()) {
-      const char *ubuf = info[0].As<Napi::Buffer<char>>().Data();
-      if (!info[1].IsNumber()) {
-        throwError(info, 1, firstArgType, true,
-                   "%s error: buffer argument must be followed by its length.",
-                   pApiName);
-        return -1;
+      keybuf = decodebuf;
+    } else if (info[0].IsBuffer()) {
+      // a Buffer or any Uint8Array, also a view into a larger one
+      const Napi::Buffer<char> &ubuf = info[0].As<Napi::Buffer<char>>();
+      keybuf_len = ubuf.Length();
+      if (info[1].IsNumber()) {
+        uint32_t argLen = info[1].As<Napi::Number>().Uint32Value();
+        if (argLen > keybuf_len) {
+          throwError(info, 1, firstArgType, true,
+                     "%s error: key-buffer-length %u exceeds the length %zu "
+                     "of the buffer.",
+                     pApiName, argLen, keybuf_len);
+          return -1;
+        }
+        keybuf_len = argLen;
       }
-      keybuf_len = info[1].As<Napi::Number>().Uint32Value();
-      if (!VsamFile::isHexBufValid(layout[key_i], ubuf, keybuf_len, pApiName,
-                                   errmsg)) {
+      keybuf = ubuf.Data();
+      if (!VsamFile::isHexBufValid(layout[key_i], keybuf, keybuf_len,
+                                   pApiName, errmsg)) {
         throwError(info, 1, firstArgType, true, errmsg.c_str());
         return -1;
       }
       DCHECK(keybuf_len > 0);
-      keybuf = (char *)malloc(keybuf_len);
-      DCHECK(keybuf != nullptr);
-      memcpy(keybuf, ubuf, keybuf_len);
     } else {
       throwError(info, 1, firstArgType, true,
                  "%s error: first argument must be "
@@ -1087,19 +2086,65 @@ int WrappedVsam::Find(const Napi::CallbackInfo &info, int equality,
     // called for a sync API
     Napi::Function dummycb;
     *ppdata = new UvWorkData(pVsamFile_, dummycb, info.Env(), "", pUpdateRecBuf,
-                             keybuf, keybuf_len, equality, pFieldsToUpdate);
+                             nullptr, 0, equality, pFieldsToUpdate);
+    if (keybuf != nullptr)
+      (*ppdata)->setKey(keybuf, keybuf_len);
     return 0;
   }
 
-  uv_work_t *request = new uv_work_t;
   Napi::Function cb = info[callbackArg].As<Napi::Function>();
-
-  request->data = new UvWorkData(pVsamFile_, cb, info.Env(), "", pUpdateRecBuf,
-                                 keybuf, keybuf_len, equality, pFieldsToUpdate);
-  uv_queue_work(uv_default_loop(), request, pExecuteFunc, pCompleteFunc);
+  // single-flight: a findeq or findge with the same key as one in flight gets
+  // its result, instead of doing another flocate()
+  std::map<std::string, UvWorkData *> &pending = pVsamFile_->getPendingFinds();
+  std::string pendingKey;
+  // (not if it can be cancelled, as the others sharing it couldn't be, if
+  // it's on a cursor, which it positions, or if it has a deadline or a
+  // class, whose error or wait the others sharing it didn't ask for)
+  if (pExecuteFunc == FindExecute && pCompleteFunc == ReadComplete &&
+      (equality == __KEY_EQ || equality == __KEY_GE) &&
+      pVsamFile_->getIssuingCancel() == nullptr &&
+      pVsamFile_->getIssuingCursor() == nullptr &&
+      pVsamFile_->getIssuingDeadline() == 0 &&
+      pVsamFile_->getDefaultDeadline() == 0 &&
+      pVsamFile_->getIssuingPriority() < 0) {
+    pendingKey = pendingFindKey(equality, keybuf, keybuf_len);
+    auto i = pending.find(pendingKey);
+    if (i != pending.end()) {
+      i->second->followers_.push_back(
+          new Napi::FunctionReference(Napi::Persistent(cb)));
+      return 0;
+    }
+  }
+  uv_work_t *request = new uv_work_t;
+  UvWorkData *pdata =
+      new UvWorkData(pVsamFile_, cb, info.Env(), "", pUpdateRecBuf, nullptr, 0,
+                     equality, pFieldsToUpdate);
+  if (keybuf != nullptr)
+    pdata->setKey(keybuf, keybuf_len);
+  request->data = pdata;
+  // shared only once it's queued or waiting, not if it's refused
+  if (queueWork(request, pExecuteFunc, pCompleteFunc) && !pendingKey.empty())
+    pending[pendingKey] = pdata;
   return 0;
 }
 
+// static
+bool WrappedVsam::isMutating(uv_work_cb pExecuteFunc) {
+  return pExecuteFunc == WriteExecute || pExecuteFunc == WriteBatchExecute ||
+         pExecuteFunc == UpdateExecute ||
+         pExecuteFunc == DeleteExecute || pExecuteFunc == FindUpdateExecute ||
+         pExecuteFunc == FindDeleteExecute || pExecuteFunc == LoadExecute ||
+         pExecuteFunc == DeleteRangeExecute ||
+         pExecuteFunc == UpdateRangeExecute || pExecuteFunc == ExecExecute ||
+         pExecuteFunc == DeallocExecute;
+}
+
+// static
+std::string WrappedVsam::pendingFindKey(int equality, const char *keybuf,
+                                        size_t keybuf_len) {
+  return std::string(1, (char)equality) + std::string(keybuf, keybuf_len);
+}
+
 void WrappedVsam::Read(const Napi::CallbackInfo &info) {
   if (errorIfNotOpen(info, 1, ARG0_TYPE_NULL, "read"))
     return;
@@ -1112,7 +2157,7 @@ void WrappedVsam::Read(const Napi::CallbackInfo &info) {
   uv_work_t *request = new uv_work_t;
   Napi::Function cb = info[0].As<Napi::Function>();
   request->data = new UvWorkData(pVsamFile_, cb, info.Env());
-  uv_queue_work(uv_default_loop(), request, ReadExecute, ReadComplete);
+  queueWork(request, ReadExecute, ReadComplete);
 }
 
 Napi::Value WrappedVsam::ReadSync(const Napi::CallbackInfo &info) {
@@ -1126,6 +2171,7 @@ Napi::Value WrappedVsam::ReadSync(const Napi::CallbackInfo &info) {
   }
   Napi::Function dummycb;
   UvWorkData *pdata = new UvWorkData(pVsamFile_, dummycb, info.Env());
+  pdata->pCursor_ = pVsamFile_->getIssuingCursor();
   int rc =
       pVsamFile_->routeToVsamThread(MSG_READ, &VsamFile::ReadExecute, pdata);
   if (rc || pdata->rc_) {
@@ -1156,7 +2202,8 @@ void WrappedVsam::Dealloc(const Napi::CallbackInfo &info) {
   uv_work_t *request = new uv_work_t;
   Napi::Function cb = info[0].As<Napi::Function>();
   request->data = new UvWorkData(pVsamFile_, cb, info.Env(), path_);
-  uv_queue_work(uv_default_loop(), request, DeallocExecute, DeallocComplete);
+  uv_queue_work(eventLoop(info.Env()), request, DeallocExecute,
+                DeallocComplete);
 }
 
 int WrappedVsam::FindUpdate_(const Napi::CallbackInfo &info,
@@ -1168,62 +2215,36 @@ int WrappedVsam::FindUpdate_(const Napi::CallbackInfo &info,
   const int errArg = 1;
   CbFirstArgType firstArgType =
       ppdata == nullptr ? ARG0_TYPE_0 : ARG0_TYPE_NONE;
-  if (errorIfNotOpen(info, errArg, firstArgType, pApiName))
+  // the staged records are sent by Find(), unless one is updated in place
+  if (errorIfNotOpen(info, errArg, firstArgType, pApiName, ppdata != nullptr))
     return -1;
 
   Napi::HandleScope scope(info.Env());
-  const Napi::Object &record = info[recArg].ToObject();
   int reclen = pVsamFile_->getRecordLength();
   char *recbuf = (char *)malloc(reclen);
   DCHECK(recbuf != nullptr);
   memset(recbuf, 0, reclen);
-  char *fldbuf = recbuf;
   std::vector<FieldToUpdate> *pupd = new std::vector<FieldToUpdate>;
-  std::vector<LayoutItem> &layout = pVsamFile_->getLayout();
   std::string errmsg;
 
-  for (auto i = layout.begin(); i != layout.end(); ++i) {
-    const Napi::Value &field = record.Get(i->name);
-    if (field.IsUndefined()) {
-      fldbuf += i->maxLength;
-      continue;
-    }
-    if (i->type == LayoutItem::STRING || i->type == LayoutItem::HEXADECIMAL) {
-      const std::string &str =
-          static_cast<std::string>(Napi::String(info.Env(), field.ToString()));
-      if (i->type == LayoutItem::STRING) {
-        if (!VsamFile::isStrValid(*i, str, pApiName, errmsg)) {
-          free(recbuf);
-          delete pupd;
-          throwError(info, errArg, firstArgType, true, errmsg.c_str());
-          return -1;
-        }
-        DCHECK(str.length() <= i->maxLength);
-        if (str.length() > 0)
-          memcpy(fldbuf, str.c_str(), str.length());
-      } else {
-        if (!VsamFile::isHexStrValid(*i, str, pApiName, errmsg)) {
-          free(recbuf);
-          delete pupd;
-          throwError(info, errArg, firstArgType, true, errmsg.c_str());
-          return -1;
-        }
-        VsamFile::hexstrToBuffer(fldbuf, i->maxLength, str.c_str());
-      }
-#ifdef DEBUG
-      pupd->push_back(FieldToUpdate((int)(fldbuf - recbuf), i->maxLength,
-                                    i->name, i->type));
-#else
-      pupd->push_back(FieldToUpdate((int)(fldbuf - recbuf), i->maxLength));
-#endif
-      fldbuf += i->maxLength;
-    } else {
-      free(recbuf);
-      delete pupd;
-      throwError(info, errArg, firstArgType, true,
-                 "Error: unexpected data type %d.", i->type);
-      return -1;
-    }
+  if (!encodeFieldsToUpdate(info[recArg].ToObject(), pApiName, recbuf, pupd,
+                            errmsg)) {
+    free(recbuf);
+    delete pupd;
+    throwError(info, errArg, firstArgType, true, errmsg.c_str());
+    return -1;
+  }
+  if (ppdata == nullptr && updateStaged(info, recArg, recbuf, *pupd)) {
+    free(recbuf);
+    delete pupd;
+    // the count is 1, as for the record found by key
+    uv_work_t *request = new uv_work_t;
+    Napi::Function cb = info[cbArg].As<Napi::Function>();
+    UvWorkData *pdata = new UvWorkData(pVsamFile_, cb, info.Env());
+    pdata->rc_ = 0;
+    request->data = pdata;
+    completeLater(request, FindUpdateComplete);
+    return 0;
   }
   int rc = Find(info, __KEY_EQ, pApiName, cbArg, ppdata, firstArgType,
                 FindUpdateExecute, FindUpdateComplete, recbuf, pupd);
@@ -1234,6 +2255,39 @@ int WrappedVsam::FindUpdate_(const Napi::CallbackInfo &info,
   return rc;
 }
 
+bool WrappedVsam::updateStaged(const Napi::CallbackInfo &info, int recArg,
+                               const char *pUpdateRecBuf,
+                               const std::vector<FieldToUpdate> &fields) {
+  // An update by key of a record staged by write-behind is done on the staged
+  // record, so the batch writes it once, updated. Only a full-length key is
+  // looked up, as a shorter one is a generic key for find().
+  if (writeBehind_ == 0 || staged_.empty())
+    return false;
+  std::string key, errmsg;
+  if (!encodeKey(info[0], "update", key, errmsg))
+    return false;
+  if (recArg == 2) {
+    uint32_t len = info[1].As<Napi::Number>().Uint32Value();
+    if (len < key.length())
+      key.resize(len);
+  }
+  if (key.length() != pVsamFile_->getKeyLength())
+    return false;
+  auto staged = staged_.find(key);
+  if (staged == staged_.end())
+    return false;
+  // the key of a record can't be changed by an update, which the dataset
+  // reports, so that's left to it
+  size_t keypos = pVsamFile_->getKeyPosition();
+  for (auto i = fields.begin(); i != fields.end(); ++i)
+    if (i->offset < keypos + key.length() && keypos < i->offset + i->len &&
+        memcmp(pUpdateRecBuf + keypos, key.data(), key.length()) != 0)
+      return false;
+  for (auto i = fields.begin(); i != fields.end(); ++i)
+    memcpy(&staged->second[i->offset], pUpdateRecBuf + i->offset, i->len);
+  return true;
+}
+
 int WrappedVsam::FindDelete_(const Napi::CallbackInfo &info,
                              const char *pApiName, UvWorkData **ppdata,
                              const int cbArg) {
@@ -1246,3 +2300,2223 @@ int WrappedVsam::FindDelete_(const Napi::CallbackInfo &info,
   return Find(info, __KEY_EQ, pApiName, cbArg, ppdata, firstArgType,
               FindDeleteExecute, FindDeleteComplete);
 }
+
+// static
+bool WrappedVsam::encodeField(const LayoutItem &item, const std::string &str,
+                              char *fldbuf, const char *pApiName,
+                              std::string &errmsg) {
+  if (item.type == LayoutItem::STRING) {
+    if (!VsamFile::isStrValid(item, str, pApiName, errmsg))
+      return false;
+    memset(fldbuf, 0, item.maxLength);
+    if (str.length() > 0)
+      memcpy(fldbuf, str.c_str(), str.length());
+    return true;
+  }
+  DCHECK(item.type == LayoutItem::HEXADECIMAL);
+  if (!VsamFile::isHexStrValid(item, str, pApiName, errmsg))
+    return false;
+  VsamFile::hexstrToBuffer(fldbuf, item.maxLength, str.c_str());
+  return true;
+}
+
+bool WrappedVsam::encodeKey(const Napi::Value &value, const char *pApiName,
+                            std::string &key, std::string &errmsg) {
+  return encodeKey(pVsamFile_->getLayout()[pVsamFile_->getKeyNum()], value,
+                   pApiName, key, errmsg);
+}
+
+// static
+bool WrappedVsam::encodeKey(const LayoutItem &item, const Napi::Value &value,
+                            const char *pApiName, std::string &key,
+                            std::string &errmsg) {
+  if (value.IsString()) {
+    const std::string &str = static_cast<std::string>(value.As<Napi::String>());
+    if (item.type == LayoutItem::HEXADECIMAL) {
+      if (!VsamFile::isHexStrValid(item, str, pApiName, errmsg))
+        return false;
+      key.resize(item.maxLength);
+      key.resize(VsamFile::hexstrToBuffer(&key[0], item.maxLength, str.c_str()));
+    } else {
+      if (!VsamFile::isStrValid(item, str, pApiName, errmsg))
+        return false;
+      key = str;
+    }
+  } else if (value.IsBuffer()) {
+    Napi::Buffer<char> buf = value.As<Napi::Buffer<char>>();
+    if (!VsamFile::isHexBufValid(item, buf.Data(), buf.Length(), pApiName,
+                                 errmsg))
+      return false;
+    key.assign(buf.Data(), buf.Length());
+  } else {
+    errmsg = std::string(pApiName) +
+             " error: key must be either a string or a Buffer object.";
+    return false;
+  }
+  return true;
+}
+
+bool WrappedVsam::parseScanRange(const Napi::Object &options,
+                                 const char *pApiName, ScanRange *prange,
+                                 std::string &errmsg, bool withKeys) {
+  return parseScanRange(pVsamFile_->getLayout(), pVsamFile_->getKeyNum(),
+                        options, pApiName, prange, errmsg, withKeys);
+}
+
+// static
+bool WrappedVsam::parseScanRange(const std::vector<LayoutItem> &layout,
+                                 int key_i, const Napi::Object &options,
+                                 const char *pApiName, ScanRange *prange,
+                                 std::string &errmsg, bool withKeys) {
+  static const struct {
+    const char *name;
+    RecordFilter::Op op;
+  } ops[] = {{"==", RecordFilter::EQ}, {"!=", RecordFilter::NE},
+             {"<", RecordFilter::LT},  {"<=", RecordFilter::LE},
+             {">", RecordFilter::GT},  {">=", RecordFilter::GE}};
+
+  if (withKeys) {
+    const Napi::Value &from = options.Get("from");
+    if (!from.IsUndefined() &&
+        !encodeKey(layout[key_i], from, pApiName, prange->from, errmsg))
+      return false;
+    const Napi::Value &to = options.Get("to");
+    if (!to.IsUndefined() &&
+        !encodeKey(layout[key_i], to, pApiName, prange->to, errmsg))
+      return false;
+  }
+
+  const Napi::Value &limit = options.Get("limit");
+  if (!limit.IsUndefined()) {
+    if (!limit.IsNumber() || limit.As<Napi::Number>().Int64Value() < 0) {
+      errmsg = std::string(pApiName) +
+               " error: limit must be a number greater than or equal to 0.";
+      return false;
+    }
+    prange->maxCount = limit.As<Napi::Number>().Int64Value();
+  }
+
+  const Napi::Value &filter = options.Get("filter");
+  if (filter.IsUndefined())
+    return true;
+  if (!filter.IsArray()) {
+    errmsg = std::string(pApiName) +
+             " error: filter must be an array of {field, op, value} objects.";
+    return false;
+  }
+  const Napi::Array &conds = filter.As<Napi::Array>();
+  for (uint32_t c = 0; c < conds.Length(); c++) {
+    const Napi::Value &vcond = conds.Get(c);
+    if (!vcond.IsObject()) {
+      errmsg = std::string(pApiName) + " error: filter item " +
+               std::to_string(c + 1) + " must be a {field, op, value} object.";
+      return false;
+    }
+    const Napi::Object &cond = vcond.As<Napi::Object>();
+    const Napi::Value &field = cond.Get("field");
+    const std::string &name =
+        field.IsString() ? static_cast<std::string>(field.As<Napi::String>())
+                         : "";
+    int i = layout.size() - 1;
+    for (; i >= 0 && layout[i].name != name; i--)
+      ;
+    if (i < 0) {
+      errmsg = std::string(pApiName) + " error: filter item " +
+               std::to_string(c + 1) + " must name a field of the schema.";
+      return false;
+    }
+    RecordFilter::Op op = RecordFilter::EQ;
+    const Napi::Value &vop = cond.Get("op");
+    if (!vop.IsUndefined()) {
+      const std::string &sop =
+          vop.IsString() ? static_cast<std::string>(vop.As<Napi::String>())
+                         : "";
+      size_t o = 0;
+      for (; o < sizeof(ops) / sizeof(ops[0]) && sop != ops[o].name; o++)
+        ;
+      if (o == sizeof(ops) / sizeof(ops[0])) {
+        errmsg = std::string(pApiName) + " error: filter item " +
+                 std::to_string(c + 1) +
+                 " op must be one of ==, !=, <, <=, > or >=.";
+        return false;
+      }
+      op = ops[o].op;
+    }
+    const Napi::Value &value = cond.Get("value");
+    // minLength doesn't apply to the value compared against:
+    LayoutItem item(layout[i]);
+    item.minLength = 0;
+    std::string fldbuf(item.maxLength, 0);
+    if (!encodeField(item,
+                     value.IsUndefined()
+                         ? ""
+                         : static_cast<std::string>(value.ToString()),
+                     &fldbuf[0], pApiName, errmsg))
+      return false;
+    prange->filters.push_back(
+        RecordFilter(item.offset, item.maxLength, op, fldbuf));
+  }
+  return true;
+}
+
+// static
+bool WrappedVsam::parseQueueOptions(const Napi::Object &options,
+                                    const char *pApiName, int *ppriority,
+                                    unsigned *pdeadlineMs,
+                                    std::string &errmsg) {
+  const Napi::Value &priority = options.Get("priority");
+  if (!priority.IsUndefined()) {
+    const std::string &cls =
+        priority.IsString()
+            ? static_cast<std::string>(priority.As<Napi::String>())
+            : "";
+    if (cls == "interactive")
+      *ppriority = PRIORITY_INTERACTIVE;
+    else if (cls == "batch")
+      *ppriority = PRIORITY_BATCH;
+    else {
+      errmsg = std::string(pApiName) +
+               " error: priority must be either interactive or batch.";
+      return false;
+    }
+  }
+  const Napi::Value &deadline = options.Get("deadline");
+  if (!deadline.IsUndefined()) {
+    double ms = deadline.IsNumber() ? deadline.As<Napi::Number>().DoubleValue()
+                                    : -1;
+    if (ms < 0 || ms > UINT_MAX || ms != (unsigned)ms) {
+      errmsg = std::string(pApiName) +
+               " error: deadline must be a number of milliseconds.";
+      return false;
+    }
+    *pdeadlineMs = (unsigned)ms;
+  }
+  return true;
+}
+
+bool WrappedVsam::parseExec(const Napi::Array &ops, const char *pApiName,
+                            ExecPipeline *pexec, std::string &errmsg) {
+  static const struct {
+    const char *name;
+    ExecOp::Type type;
+  } types[] = {{"find", ExecOp::FIND},
+               {"write", ExecOp::WRITE},
+               {"update", ExecOp::UPDATE},
+               {"delete", ExecOp::DELETE}};
+  const size_t reclen = pVsamFile_->getRecordLength();
+  for (uint32_t o = 0; o < ops.Length(); o++) {
+    const std::string &prefix = std::string(pApiName) + " error: operation " +
+                                std::to_string(o + 1);
+    const Napi::Value &vop = ops.Get(o);
+    const Napi::Value &name =
+        vop.IsObject() ? vop.ToObject().Get("op") : Napi::Value();
+    const std::string &sname =
+        name.IsString() ? static_cast<std::string>(name.As<Napi::String>())
+                        : "";
+    size_t t = 0;
+    for (; t < sizeof(types) / sizeof(types[0]) && sname != types[t].name; t++)
+      ;
+    if (t == sizeof(types) / sizeof(types[0])) {
+      errmsg = prefix + " must be an object with op one of find, write, "
+                        "update or delete.";
+      return false;
+    }
+    const Napi::Object &op = vop.ToObject();
+    pexec->ops.push_back(ExecOp(types[t].type));
+    ExecOp &execop = pexec->ops.back();
+    std::string opmsg;
+    // e.g. "exec operation 2 error: ..." for an invalid key or field:
+    const std::string &opApiName =
+        std::string(pApiName) + " operation " + std::to_string(o + 1);
+    if (execop.type != ExecOp::WRITE &&
+        !encodeKey(op.Get("key"), opApiName.c_str(), execop.key, opmsg)) {
+      errmsg = opmsg;
+      return false;
+    }
+    if (execop.type == ExecOp::FIND || execop.type == ExecOp::DELETE)
+      continue;
+    const Napi::Value &record = op.Get("record");
+    if (!record.IsObject()) {
+      errmsg = prefix + " must have a record object.";
+      return false;
+    }
+    execop.record.assign(reclen, 0);
+    if (execop.type == ExecOp::WRITE
+            ? !encodeRecord(record.ToObject(), opApiName.c_str(),
+                            &execop.record[0], opmsg)
+            : !encodeFieldsToUpdate(record.ToObject(), opApiName.c_str(),
+                                    &execop.record[0], &execop.fields, opmsg)) {
+      errmsg = opmsg;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool WrappedVsam::parseAggregation(const Napi::Object &options,
+                                   const char *pApiName, Aggregation *paggr,
+                                   std::string &errmsg) {
+  const Napi::Value &groupBy = options.Get("groupBy");
+  if (!groupBy.IsUndefined()) {
+    paggr->groupBy =
+        groupBy.IsString() ? pVsamFile_->getFieldNum(static_cast<std::string>(
+                                 groupBy.As<Napi::String>()))
+                           : -1;
+    if (paggr->groupBy < 0) {
+      errmsg = std::string(pApiName) +
+               " error: groupBy must name a field of the schema.";
+      return false;
+    }
+  }
+  const std::vector<LayoutItem> &layout = pVsamFile_->getLayout();
+  static const char *names[] = {"sum", "min", "max"};
+  std::vector<int> *lists[] = {&paggr->sum, &paggr->min, &paggr->max};
+  for (int n = 0; n < 3; n++) {
+    const Napi::Value &vfields = options.Get(names[n]);
+    if (vfields.IsUndefined())
+      continue;
+    if (!vfields.IsArray()) {
+      errmsg = std::string(pApiName) + " error: " + names[n] +
+               " must be an array of field names.";
+      return false;
+    }
+    const Napi::Array &fields = vfields.As<Napi::Array>();
+    for (uint32_t f = 0; f < fields.Length(); f++) {
+      const Napi::Value &field = fields.Get(f);
+      int i = field.IsString() ? pVsamFile_->getFieldNum(static_cast<std::string>(
+                                     field.As<Napi::String>()))
+                               : -1;
+      if (i < 0) {
+        errmsg = std::string(pApiName) + " error: " + names[n] +
+                 " must be an array of field names of the schema.";
+        return false;
+      }
+      if (!VsamFile::isNumericField(layout[i])) {
+        errmsg = std::string(pApiName) + " error: " + names[n] + " field '" +
+                 layout[i].name +
+                 "' must be of type hexadecimal with maxLength 8 or less.";
+        return false;
+      }
+      lists[n]->push_back(i);
+    }
+  }
+  return true;
+}
+
+int WrappedVsam::Aggregate_(const Napi::CallbackInfo &info,
+                            const char *pApiName, UvWorkData **ppdata) {
+  CbFirstArgType firstArgType =
+      ppdata == nullptr ? ARG0_TYPE_NULL : ARG0_TYPE_NONE;
+  if (errorIfNotOpen(info, 1, firstArgType, pApiName))
+    return -1;
+  Napi::HandleScope scope(info.Env());
+
+  const Napi::Object &options = info[0].ToObject();
+  ScanRange *prange = new ScanRange;
+  Aggregation *paggr = new Aggregation;
+  std::string errmsg;
+  if (!parseScanRange(options, pApiName, prange, errmsg) ||
+      !parseAggregation(options, pApiName, paggr, errmsg)) {
+    delete prange;
+    delete paggr;
+    throwError(info, 1, firstArgType, true, errmsg.c_str());
+    return -1;
+  }
+
+  UvWorkData *pdata;
+  if (ppdata != nullptr) {
+    // called for a sync API
+    Napi::Function dummycb;
+    pdata = *ppdata = new UvWorkData(pVsamFile_, dummycb, info.Env());
+  } else {
+    Napi::Function cb = info[1].As<Napi::Function>();
+    pdata = new UvWorkData(pVsamFile_, cb, info.Env());
+  }
+  pdata->pScanRange_ = prange;
+  pdata->pAggregation_ = paggr;
+  if (ppdata != nullptr)
+    return 0;
+  uv_work_t *request = new uv_work_t;
+  request->data = pdata;
+  queueWork(request, AggregateExecute, AggregateComplete);
+  return 0;
+}
+
+void WrappedVsam::Aggregate(const Napi::CallbackInfo &info) {
+  if (info.Length() == 2 && info[0].IsObject() && info[1].IsFunction())
+    Aggregate_(info, "aggregate");
+  else {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, 1, ARG0_TYPE_NULL, true,
+               "aggregate error: aggregate() expects arguments: "
+               "options, (result, err).");
+  }
+}
+
+Napi::Value WrappedVsam::AggregateSync(const Napi::CallbackInfo &info) {
+  Napi::HandleScope scope(info.Env());
+  UvWorkData *pdata = nullptr;
+
+  if (info.Length() == 1 && info[0].IsObject()) {
+    if (Aggregate_(info, "aggregateSync", &pdata))
+      return info.Env().Null();
+  } else {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "aggregateSync error: aggregateSync() expects arguments: "
+               "options.");
+    return info.Env().Null();
+  }
+  int rc = pVsamFile_->routeToVsamThread(MSG_AGGREGATE,
+                                         &VsamFile::AggregateExecute, pdata);
+  if (rc || pdata->rc_) {
+    throwError(info, -1, ARG0_TYPE_NONE, true, pdata->errmsg_.c_str());
+    delete pdata;
+    return info.Env().Null();
+  }
+  Napi::Value result = createAggregateObject(pdata);
+  delete pdata;
+  return result;
+}
+
+bool WrappedVsam::encodeFieldsToUpdate(const Napi::Object &record,
+                                       const char *pApiName, char *recbuf,
+                                       std::vector<FieldToUpdate> *pupd,
+                                       std::string &errmsg) {
+  // Encodes the fields set in record at their offsets in recbuf, skipping
+  // those not set, and adds each to *pupd.
+  const std::vector<LayoutItem> &layout = pVsamFile_->getLayout();
+  for (auto i = layout.begin(); i != layout.end(); ++i) {
+    const Napi::Value &field = record.Get(i->name);
+    if (field.IsUndefined())
+      continue;
+    const std::string &str =
+        static_cast<std::string>(Napi::String(record.Env(), field.ToString()));
+    if (!encodeField(*i, str, recbuf + i->offset, pApiName, errmsg))
+      return false;
+#ifdef DEBUG
+    pupd->push_back(FieldToUpdate(i->offset, i->maxLength, i->name, i->type));
+#else
+    pupd->push_back(FieldToUpdate(i->offset, i->maxLength));
+#endif
+  }
+  return true;
+}
+
+int WrappedVsam::Range_(const Napi::CallbackInfo &info, const char *pApiName,
+                        const int recArg, const int optArg, const int cbArg,
+                        UvWorkData **ppdata) {
+  // This is used by deleteRange, updateRange and their sync versions;
+  // update is if recArg >= 0, sync is if ppdata != nullptr
+  const int errArg = 1;
+  CbFirstArgType firstArgType =
+      ppdata == nullptr ? ARG0_TYPE_0 : ARG0_TYPE_NONE;
+  // the staged records are sent by Find(), unless one is updated in place
+  if (errorIfNotOpen(info, errArg, firstArgType, pApiName, ppdata != nullptr))
+    return -1;
+  Napi::HandleScope scope(info.Env());
+
+  ScanRange *prange = new ScanRange;
+  char *recbuf = nullptr;
+  std::vector<FieldToUpdate> *pupd = nullptr;
+  std::string errmsg;
+  bool valid =
+      (info[0].IsNull() ||
+       encodeKey(info[0], pApiName, prange->from, errmsg)) &&
+      (info[1].IsNull() || encodeKey(info[1], pApiName, prange->to, errmsg)) &&
+      (optArg < 0 || parseScanRange(info[optArg].ToObject(), pApiName, prange,
+                                    errmsg, false));
+  if (valid && recArg >= 0) {
+    int reclen = pVsamFile_->getRecordLength();
+    recbuf = (char *)malloc(reclen);
+    DCHECK(recbuf != nullptr);
+    memset(recbuf, 0, reclen);
+    pupd = new std::vector<FieldToUpdate>;
+    const Napi::Object &record = info[recArg].ToObject();
+    valid = encodeFieldsToUpdate(record, pApiName, recbuf, pupd, errmsg);
+    if (valid && pupd->empty()) {
+      errmsg = std::string(pApiName) + " error: no field to update is set.";
+      valid = false;
+    } else if (valid) {
+      const LayoutItem &key = pVsamFile_->getLayout()[pVsamFile_->getKeyNum()];
+      if (!record.Get(key.name).IsUndefined()) {
+        errmsg = std::string(pApiName) + " error: key field '" + key.name +
+                 "' cannot be updated.";
+        valid = false;
+      }
+    }
+  }
+  if (!valid) {
+    delete prange;
+    if (recbuf)
+      free(recbuf);
+    if (pupd)
+      delete pupd;
+    throwError(info, errArg, firstArgType, true, errmsg.c_str());
+    return -1;
+  }
+
+  UvWorkData *pdata;
+  if (ppdata != nullptr) {
+    // called for a sync API
+    Napi::Function dummycb;
+    pdata = *ppdata = new UvWorkData(pVsamFile_, dummycb, info.Env(), "",
+                                     recbuf, nullptr, 0, 0, pupd);
+  } else {
+    Napi::Function cb = info[cbArg].As<Napi::Function>();
+    pdata = new UvWorkData(pVsamFile_, cb, info.Env(), "", recbuf, nullptr, 0,
+                           0, pupd);
+  }
+  pdata->pScanRange_ = prange;
+  if (ppdata != nullptr)
+    return 0;
+  uv_work_t *request = new uv_work_t;
+  request->data = pdata;
+  if (recArg >= 0)
+    queueWork(request, UpdateRangeExecute, UpdateRangeComplete);
+  else
+    queueWork(request, DeleteRangeExecute, DeleteRangeComplete);
+  return 0;
+}
+
+static bool isRangeKey(const Napi::Value &value) {
+  return value.IsString() || value.IsBuffer() || value.IsNull();
+}
+
+void WrappedVsam::DeleteRange(const Napi::CallbackInfo &info) {
+  if (info.Length() == 3 && isRangeKey(info[0]) && isRangeKey(info[1]) &&
+      info[2].IsFunction()) {
+    Range_(info, "deleteRange", -1, -1, 2); // options and callback arg #s
+  } else if (info.Length() == 4 && isRangeKey(info[0]) &&
+             isRangeKey(info[1]) && info[2].IsObject() &&
+             info[3].IsFunction()) {
+    Range_(info, "deleteRange", -1, 2, 3);
+  } else {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, 1, ARG0_TYPE_0, true,
+               "deleteRange error: deleteRange() expects arguments: "
+               "from-key, to-key, (count, err), "
+               "or: from-key, to-key, options, (count, err).");
+  }
+}
+
+Napi::Value WrappedVsam::DeleteRangeSync(const Napi::CallbackInfo &info) {
+  Napi::HandleScope scope(info.Env());
+  UvWorkData *pdata = nullptr;
+
+  if ((info.Length() == 2 || (info.Length() == 3 && info[2].IsObject())) &&
+      isRangeKey(info[0]) && isRangeKey(info[1])) {
+    if (Range_(info, "deleteRangeSync", -1, info.Length() == 3 ? 2 : -1, -1,
+               &pdata))
+      return Napi::Number::New(info.Env(), 0);
+  } else {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "deleteRangeSync error: deleteRangeSync() expects arguments: "
+               "from-key, to-key, optional options.");
+    return Napi::Number::New(info.Env(), 0);
+  }
+  pVsamFile_->fencePendingFinds();
+  int rc = pVsamFile_->routeToVsamThread(MSG_DELETE_RANGE,
+                                         &VsamFile::DeleteRangeExecute, pdata);
+  if (rc || pdata->rc_) {
+    throwError(info, -1, ARG0_TYPE_NONE, true, pdata->errmsg_.c_str());
+    delete pdata;
+    return Napi::Number::New(info.Env(), 0);
+  }
+  int count = pdata->count_;
+  delete pdata;
+  return Napi::Number::New(info.Env(), count);
+}
+
+void WrappedVsam::UpdateRange(const Napi::CallbackInfo &info) {
+  if (info.Length() == 4 && isRangeKey(info[0]) && isRangeKey(info[1]) &&
+      info[2].IsObject() && info[3].IsFunction()) {
+    Range_(info, "updateRange", 2, -1, 3); // record, options, callback arg #s
+  } else if (info.Length() == 5 && isRangeKey(info[0]) &&
+             isRangeKey(info[1]) && info[2].IsObject() && info[3].IsObject() &&
+             info[4].IsFunction()) {
+    Range_(info, "updateRange", 2, 3, 4);
+  } else {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, 1, ARG0_TYPE_0, true,
+               "updateRange error: updateRange() expects arguments: "
+               "from-key, to-key, record, (count, err), "
+               "or: from-key, to-key, record, options, (count, err).");
+  }
+}
+
+Napi::Value WrappedVsam::UpdateRangeSync(const Napi::CallbackInfo &info) {
+  Napi::HandleScope scope(info.Env());
+  UvWorkData *pdata = nullptr;
+
+  if ((info.Length() == 3 || (info.Length() == 4 && info[3].IsObject())) &&
+      isRangeKey(info[0]) && isRangeKey(info[1]) && info[2].IsObject()) {
+    if (Range_(info, "updateRangeSync", 2, info.Length() == 4 ? 3 : -1, -1,
+               &pdata))
+      return Napi::Number::New(info.Env(), 0);
+  } else {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "updateRangeSync error: updateRangeSync() expects arguments: "
+               "from-key, to-key, record, optional options.");
+    return Napi::Number::New(info.Env(), 0);
+  }
+  pVsamFile_->fencePendingFinds();
+  int rc = pVsamFile_->routeToVsamThread(MSG_UPDATE_RANGE,
+                                         &VsamFile::UpdateRangeExecute, pdata);
+  if (rc || pdata->rc_) {
+    throwError(info, -1, ARG0_TYPE_NONE, true, pdata->errmsg_.c_str());
+    delete pdata;
+    return Napi::Number::New(info.Env(), 0);
+  }
+  int count = pdata->count_;
+  delete pdata;
+  return Napi::Number::New(info.Env(), count);
+}
+
+static Napi::Value createPromiseError(UvWorkData *pdata) {
+  // The error codes are 0 if the error isn't from a failed I/O
+  Napi::Error error = Napi::Error::New(pdata->env_, pdata->errmsg_);
+  error.Set("errno", Napi::Number::New(pdata->env_, pdata->err_));
+  error.Set("errno2", Napi::Number::New(pdata->env_, pdata->err2_));
+  error.Set("r15", Napi::Number::New(pdata->env_, pdata->r15_));
+  return error.Value();
+}
+
+Napi::Value WrappedVsam::rejectPending(Napi::Env env) {
+  // Turn the exception thrown for invalid arguments into a rejected promise
+  napi_deferred deferred;
+  napi_value promise;
+  Napi::Value error = env.GetAndClearPendingException().Value();
+  if (napi_create_promise(env, &deferred, &promise) != napi_ok ||
+      napi_reject_deferred(env, deferred, error) != napi_ok) {
+    Napi::Error::New(env).ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  return Napi::Value(env, promise);
+}
+
+Napi::Value WrappedVsam::queuePromise(UvWorkData *pdata,
+                                      uv_work_cb pExecuteFunc,
+                                      uv_after_work_cb pCompleteFunc) {
+  // pdata was created as for a sync API, i.e. without a callback
+  Napi::Env env = pdata->env_;
+  napi_value promise;
+  if (napi_create_promise(env, &pdata->deferred_, &promise) != napi_ok) {
+    delete pdata;
+    Napi::Error::New(env).ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+  uv_work_t *request = new uv_work_t;
+  request->data = pdata;
+  queueWork(request, pExecuteFunc, pCompleteFunc);
+  return Napi::Value(env, promise);
+}
+
+// static
+bool WrappedVsam::queueWork(uv_work_t *request, uv_work_cb pExecuteFunc,
+                            uv_after_work_cb pCompleteFunc) {
+  UvWorkData *pdata = (UvWorkData *)(request->data);
+  InFlightLimit &inFlight = pdata->pVsamFile_->getInFlight();
+  pdata->pExecute_ = pExecuteFunc;
+  pdata->pComplete_ = pCompleteFunc;
+  if (isMutating(pExecuteFunc))
+    pdata->pVsamFile_->fencePendingFinds();
+  if (pdata->pVsamFile_->isDirect()) {
+    pdata->errmsg_ = "direct error: the dataset was opened with "
+                     "{direct: true}, so only the sync functions can be used.";
+    pdata->rc_ = 1;
+    completeLater(request, pCompleteFunc);
+    return false;
+  }
+  if (pExecuteFunc == WriteBatchExecute) {
+    // the write-behind batches aren't limited, nor cancelled, and don't take
+    // the options of the call that staged their last record, as their
+    // records were accepted already; a batch is posted to the VSAM thread
+    // now, so that what's issued after it on the handle sees its records
+    pdata->pVsamFile_->workQueued();
+    pdata->pVsamFile_->postToVsamThread(MSG_WRITE_BATCH,
+                                        &VsamFile::WriteBatchExecute, pdata);
+    uv_queue_work(eventLoop(pdata->env_), request, pExecuteFunc,
+                  pCompleteFunc);
+    return true;
+  }
+  std::shared_ptr<CancelState> &issuing =
+      pdata->pVsamFile_->getIssuingCancel();
+  if (pdata->pCancel_ == nullptr && issuing != nullptr) {
+    pdata->pCancel_ = issuing;
+    issuing->requests.push_back(request);
+  }
+  if (pdata->pCursor_ == nullptr)
+    pdata->pCursor_ = pdata->pVsamFile_->getIssuingCursor();
+  if (pdata->priority_ < 0)
+    pdata->priority_ = pdata->pVsamFile_->getIssuingPriority();
+  if (pdata->deadlineMs_ == 0)
+    pdata->deadlineMs_ = pdata->pVsamFile_->getIssuingDeadline();
+  if (inFlight.max > 0 && inFlight.count >= inFlight.max) {
+    if (inFlight.wait) {
+      // started by WorkComplete() once there's room
+      inFlight.waiting.push_back(request);
+      return true;
+    }
+    pdata->errmsg_ = "busy error: " + std::to_string(inFlight.count) +
+                     " requests are in flight on the dataset, the maximum "
+                     "set by setMaxInFlight().";
+    pdata->rc_ = 1;
+    removeCancellable(request);
+    completeLater(request, pCompleteFunc);
+    return false;
+  }
+  inFlight.count++;
+  pdata->pVsamFile_->workQueued();
+  uv_queue_work(eventLoop(pdata->env_), request, pExecuteFunc, WorkComplete);
+  return true;
+}
+
+// static
+void WrappedVsam::WorkComplete(uv_work_t *req, int status) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *pVsamFile = pdata->pVsamFile_;
+  InFlightLimit &inFlight = pVsamFile->getInFlight();
+  uv_after_work_cb pCompleteFunc = pdata->pComplete_;
+  inFlight.count--;
+  if (pVsamFile->isEnvExited()) {
+    removeCancellable(req);
+    dropIfEnvExited(req);
+    return;
+  }
+  // the waiting requests are started first, as the callback may close the
+  // dataset
+  while (!inFlight.waiting.empty() &&
+         (inFlight.max == 0 || inFlight.count < inFlight.max)) {
+    uv_work_t *request = inFlight.waiting.front();
+    inFlight.waiting.pop_front();
+    UvWorkData *pwaiting = (UvWorkData *)(request->data);
+    inFlight.count++;
+    pVsamFile->workQueued();
+    uv_queue_work(eventLoop(pdata->env_), request, pwaiting->pExecute_,
+                  WorkComplete);
+  }
+  removeCancellable(req);
+  // a request cancelled before it was started gets the cancel error
+  if (status == UV_ECANCELED && pVsamFile->isCancelled(pdata))
+    status = 0;
+  pCompleteFunc(req, status);
+  workDone(pVsamFile);
+}
+
+// static
+void WrappedVsam::workDone(VsamFile *pVsamFile) {
+  // the last request to complete on a dataset whose object was deleted, or
+  // whose environment exited, meanwhile closes and deletes it
+  if (!pVsamFile->workComplete())
+    return;
+  if (pVsamFile->isDatasetOpen()) {
+    Napi::Function dummy;
+    UvWorkData uvdata(nullptr, dummy, nullptr);
+    pVsamFile->routeToVsamThread(MSG_CLOSE, &VsamFile::Close, &uvdata);
+  }
+  pVsamFile->exitVsamThread();
+  delete pVsamFile;
+}
+
+// static
+bool WrappedVsam::dropIfEnvExited(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  if (!pdata->pVsamFile_->isEnvExited())
+    return false;
+  dropRequest(req);
+  return true;
+}
+
+// static
+void WrappedVsam::dropRequest(uv_work_t *req) {
+  // the callbacks and promises went with the environment, so the request is
+  // freed without calling into it
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  VsamFile *pVsamFile = pdata->pVsamFile_;
+  pdata->cb_.SuppressDestruct();
+  for (auto i = pdata->followers_.begin(); i != pdata->followers_.end(); ++i)
+    (*i)->SuppressDestruct();
+  delete pdata;
+  delete req;
+  workDone(pVsamFile);
+}
+
+// static
+void WrappedVsam::completeLater(uv_work_t *request,
+                                uv_after_work_cb pCompleteFunc) {
+  // A request that has nothing to run, e.g. it's refused, is completed on the
+  // next turn of the loop, so that its callback is never called, nor its
+  // promise settled, before the function that issued it returns.
+  UvWorkData *pdata = (UvWorkData *)(request->data);
+  AddonData *pAddonData = getAddonData(pdata->env_);
+  pdata->pComplete_ = pCompleteFunc;
+  pdata->pVsamFile_->workQueued();
+  if (pAddonData->later.empty())
+    uv_ref((uv_handle_t *)pAddonData->laterAsync);
+  pAddonData->later.push_back(request);
+  uv_async_send(pAddonData->laterAsync);
+}
+
+// static
+void WrappedVsam::LaterComplete(uv_async_t *handle) {
+  AddonData *pAddonData = static_cast<AddonData *>(handle->data);
+  std::vector<uv_work_t *> requests;
+  requests.swap(pAddonData->later);
+  uv_unref((uv_handle_t *)handle);
+  for (auto i = requests.begin(); i != requests.end(); ++i) {
+    UvWorkData *pdata = (UvWorkData *)((*i)->data);
+    VsamFile *pVsamFile = pdata->pVsamFile_;
+    pdata->pComplete_(*i, 0);
+    workDone(pVsamFile);
+  }
+}
+
+// static
+void WrappedVsam::removeCancellable(uv_work_t *req) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  if (pdata->pCancel_ == nullptr)
+    return;
+  std::vector<uv_work_t *> &requests = pdata->pCancel_->requests;
+  requests.erase(std::remove(requests.begin(), requests.end(), req),
+                 requests.end());
+}
+
+void WrappedVsam::settlePromise(UvWorkData *pdata, Napi::Value result) {
+  // rc_ 8 is for no record found, which isn't an error here
+  if (pdata->rc_ != 0 && pdata->rc_ != 8)
+    napi_reject_deferred(pdata->env_, pdata->deferred_,
+                         createPromiseError(pdata));
+  else
+    napi_resolve_deferred(pdata->env_, pdata->deferred_, result);
+  delete pdata;
+}
+
+void WrappedVsam::RecordPromiseComplete(uv_work_t *req, int status) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  delete req;
+  DCHECK(status != UV_ECANCELED);
+  Napi::HandleScope scope(pdata->env_);
+  DCHECK(pdata->deferred_ != nullptr);
+  // resolve with null if no record was found or read
+  settlePromise(pdata, pdata->rc_ == 0 ? createRecordObject(pdata)
+                                       : pdata->env_.Null());
+}
+
+void WrappedVsam::CountPromiseComplete(uv_work_t *req, int status) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  delete req;
+  DCHECK(status != UV_ECANCELED);
+  Napi::HandleScope scope(pdata->env_);
+  DCHECK(pdata->deferred_ != nullptr);
+  settlePromise(pdata, Napi::Number::New(pdata->env_,
+                                         pdata->rc_ == 0 ? pdata->count_ : 0));
+}
+
+Napi::Value WrappedVsam::ReadAsync(const Napi::CallbackInfo &info) {
+  if (errorIfNotOpen(info, -1, ARG0_TYPE_NONE, "readAsync"))
+    return rejectPending(info.Env());
+  if (info.Length() != 0) {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "readAsync error: readAsync() expects no argument.");
+    return rejectPending(info.Env());
+  }
+  Napi::Function dummycb;
+  UvWorkData *pdata = new UvWorkData(pVsamFile_, dummycb, info.Env());
+  return queuePromise(pdata, ReadExecute, RecordPromiseComplete);
+}
+
+Napi::Value WrappedVsam::FindAsync_(const Napi::CallbackInfo &info,
+                                    int equality, const char *pApiName) {
+  UvWorkData *pdata = nullptr;
+  if (equality == __KEY_FIRST || equality == __KEY_LAST) {
+    if (info.Length() != 0) {
+      throwError(info, -1, ARG0_TYPE_NONE, true,
+                 "%s error: %s() expects no argument.", pApiName, pApiName);
+      return rejectPending(info.Env());
+    }
+  } else if (!(info.Length() == 1 &&
+                (info[0].IsString() || info[0].IsBuffer())) &&
+             !(info.Length() == 2 && info[0].IsObject() &&
+               info[1].IsNumber())) {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "%s error: %s() expects arguments: key-string, "
+               "or key-buffer[, key-buffer-length].",
+               pApiName, pApiName);
+    return rejectPending(info.Env());
+  }
+  if (Find(info, equality, pApiName, -1, &pdata, ARG0_TYPE_NONE))
+    return rejectPending(info.Env());
+  return queuePromise(pdata, FindExecute, RecordPromiseComplete);
+}
+
+Napi::Value WrappedVsam::FindEqAsync(const Napi::CallbackInfo &info) {
+  return FindAsync_(info, __KEY_EQ, "findAsync");
+}
+
+Napi::Value WrappedVsam::FindGeAsync(const Napi::CallbackInfo &info) {
+  return FindAsync_(info, __KEY_GE, "findgeAsync");
+}
+
+Napi::Value WrappedVsam::FindFirstAsync(const Napi::CallbackInfo &info) {
+  return FindAsync_(info, __KEY_FIRST, "findfirstAsync");
+}
+
+Napi::Value WrappedVsam::FindLastAsync(const Napi::CallbackInfo &info) {
+  return FindAsync_(info, __KEY_LAST, "findlastAsync");
+}
+
+Napi::Value WrappedVsam::WriteAsync(const Napi::CallbackInfo &info) {
+  UvWorkData *pdata = nullptr;
+  if (info.Length() != 1 || !info[0].IsObject()) {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "writeAsync error: writeAsync() expects arguments: record.");
+    return rejectPending(info.Env());
+  }
+  if (Write_(info, "writeAsync", &pdata))
+    return rejectPending(info.Env());
+  return queuePromise(pdata, WriteExecute, CountPromiseComplete);
+}
+
+Napi::Value WrappedVsam::UpdateAsync(const Napi::CallbackInfo &info) {
+  UvWorkData *pdata = nullptr;
+  if (info.Length() == 2 && (info[0].IsString() || info[0].IsBuffer()) &&
+      info[1].IsObject()) {
+    if (FindUpdate_(info, "updateAsync", &pdata, 1, -1))
+      return rejectPending(info.Env());
+  } else if (info.Length() == 3 && info[0].IsObject() && info[1].IsNumber() &&
+             info[2].IsObject()) {
+    if (FindUpdate_(info, "updateAsync", &pdata, 2, -1))
+      return rejectPending(info.Env());
+  } else if (info.Length() == 1 && info[0].IsObject()) {
+    if (Update_(info, "updateAsync", &pdata))
+      return rejectPending(info.Env());
+    return queuePromise(pdata, UpdateExecute, CountPromiseComplete);
+  } else {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "updateAsync error: updateAsync() expects arguments: "
+               "record, "
+               "or: key-string, record, "
+               "or: key-buffer[, key-buffer-length], record.");
+    return rejectPending(info.Env());
+  }
+  return queuePromise(pdata, FindUpdateExecute, CountPromiseComplete);
+}
+
+Napi::Value WrappedVsam::DeleteAsync(const Napi::CallbackInfo &info) {
+  UvWorkData *pdata = nullptr;
+  if ((info.Length() == 1 && (info[0].IsString() || info[0].IsBuffer())) ||
+      (info.Length() == 2 && info[0].IsObject() && info[1].IsNumber())) {
+    if (FindDelete_(info, "deleteAsync", &pdata))
+      return rejectPending(info.Env());
+    return queuePromise(pdata, FindDeleteExecute, CountPromiseComplete);
+  }
+  if (info.Length() != 0) {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "deleteAsync error: deleteAsync() expects arguments: "
+               "key-string, "
+               "or: key-buffer[, key-buffer-length], "
+               "or no argument to delete the record last read.");
+    return rejectPending(info.Env());
+  }
+  if (Delete_(info, &pdata))
+    return rejectPending(info.Env());
+  return queuePromise(pdata, DeleteExecute, CountPromiseComplete);
+}
+
+bool WrappedVsam::encodeRecord(const Napi::Object &record,
+                               const char *pApiName, char *recbuf,
+                               std::string &errmsg) {
+  // Encodes all the fields of record into recbuf, those not set as empty
+  const std::vector<LayoutItem> &layout = pVsamFile_->getLayout();
+  memset(recbuf, 0, pVsamFile_->getRecordLength());
+  for (auto i = layout.begin(); i != layout.end(); ++i) {
+    const Napi::Value &field = record.Get(i->name);
+    if (i->type != LayoutItem::STRING && i->type != LayoutItem::HEXADECIMAL) {
+      errmsg = std::string(pApiName) + " error: unexpected JSON data type " +
+               std::to_string(i->type) + " for " + i->name + ".";
+      return false;
+    }
+#ifdef DEBUG
+    if (field.IsUndefined()) {
+      fprintf(stderr,
+              "%s value of %s was not set, will attempt to set it to "
+              "all 0x00\n",
+              pApiName, i->name.c_str());
+    }
+#endif
+    const std::string &str =
+        field.IsUndefined()
+            ? ""
+            : static_cast<std::string>(
+                  Napi::String(record.Env(), field.ToString()));
+    if (!encodeField(*i, str, recbuf + i->offset, pApiName, errmsg))
+      return false;
+  }
+  return true;
+}
+
+Napi::Value WrappedVsam::LoadBegin(const Napi::CallbackInfo &info) {
+  if (errorIfNotOpen(info, -1, ARG0_TYPE_NONE, "bulkLoad"))
+    return info.Env().Undefined();
+  Napi::Function dummycb;
+  UvWorkData *pdata = new UvWorkData(pVsamFile_, dummycb, info.Env());
+  int rc = pVsamFile_->routeToVsamThread(MSG_LOAD_BEGIN,
+                                         &VsamFile::LoadBeginExecute, pdata);
+  if (rc || pdata->rc_)
+    throwError(info, -1, ARG0_TYPE_NONE, false, pdata->errmsg_.c_str());
+  delete pdata;
+  return info.Env().Undefined();
+}
+
+void WrappedVsam::LoadBatch(const Napi::CallbackInfo &info) {
+  // The records are written in one message to the VSAM thread
+  if (info.Length() != 2 || !info[0].IsArray() || !info[1].IsFunction()) {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, 1, ARG0_TYPE_0, true,
+               "bulkLoad error: expects arguments: array of records, "
+               "(count, err).");
+    return;
+  }
+  if (errorIfNotOpen(info, 1, ARG0_TYPE_0, "bulkLoad"))
+    return;
+  Napi::HandleScope scope(info.Env());
+  const Napi::Array &records = info[0].As<Napi::Array>();
+  int reclen = pVsamFile_->getRecordLength();
+  char *recbuf = (char *)malloc(reclen * std::max(records.Length(), 1u));
+  DCHECK(recbuf != nullptr);
+  std::string errmsg;
+  for (uint32_t i = 0; i < records.Length(); i++) {
+    const Napi::Value &record = records.Get(i);
+    if (!record.IsObject()) {
+      errmsg = "bulkLoad error: each record must be an object.";
+    } else if (encodeRecord(record.As<Napi::Object>(), "bulkLoad",
+                            recbuf + i * reclen, errmsg))
+      continue;
+    free(recbuf);
+    throwError(info, 1, ARG0_TYPE_0, true, errmsg.c_str());
+    return;
+  }
+  Napi::Function cb = info[1].As<Napi::Function>();
+  UvWorkData *pdata = new UvWorkData(pVsamFile_, cb, info.Env(), "", recbuf);
+  pdata->count_ = records.Length();
+  uv_work_t *request = new uv_work_t;
+  request->data = pdata;
+  queueWork(request, LoadExecute, LoadComplete);
+}
+
+Napi::Value WrappedVsam::LoadEnd(const Napi::CallbackInfo &info) {
+  if (errorIfNotOpen(info, -1, ARG0_TYPE_NONE, "bulkLoad"))
+    return Napi::Number::New(info.Env(), 0);
+  Napi::Function dummycb;
+  UvWorkData *pdata = new UvWorkData(pVsamFile_, dummycb, info.Env());
+  int rc = pVsamFile_->routeToVsamThread(MSG_LOAD_END,
+                                         &VsamFile::LoadEndExecute, pdata);
+  if (rc || pdata->rc_) {
+    throwError(info, -1, ARG0_TYPE_NONE, false, pdata->errmsg_.c_str());
+    delete pdata;
+    return Napi::Number::New(info.Env(), 0);
+  }
+  size_t count = pdata->count_;
+  delete pdata;
+  return Napi::Number::New(info.Env(), count);
+}
+
+int WrappedVsam::Export_(const Napi::CallbackInfo &info, const int optArg,
+                         const int cbArg) {
+  if (errorIfNotOpen(info, 1, ARG0_TYPE_0, "exportTo"))
+    return -1;
+  Napi::HandleScope scope(info.Env());
+  const Napi::Object &options =
+      optArg >= 0 ? info[optArg].ToObject() : Napi::Object::New(info.Env());
+  RecordExport *pexp = new RecordExport;
+  ScanRange *prange = new ScanRange;
+  std::string errmsg;
+  pexp->path = static_cast<std::string>(info[0].As<Napi::String>());
+
+  const Napi::Value &format = options.Get("format");
+  const std::string &fmt =
+      format.IsUndefined() ? "ndjson"
+                           : static_cast<std::string>(
+                                 Napi::String(info.Env(), format.ToString()));
+  if (fmt == "ndjson")
+    pexp->format = RecordExport::NDJSON;
+  else if (fmt == "raw")
+    pexp->format = RecordExport::RAW;
+  else if (fmt == "csv")
+    pexp->format = RecordExport::CSV;
+  else
+    errmsg = "exportTo error: format must be one of \"ndjson\", \"raw\" or "
+             "\"csv\".";
+
+  if (errmsg.empty())
+    parseFields(options, "exportTo", pexp->fields, errmsg);
+
+  const Napi::Value &range = options.Get("range");
+  if (errmsg.empty() && !range.IsUndefined()) {
+    if (!range.IsObject())
+      errmsg = "exportTo error: range must be an object.";
+    else
+      parseScanRange(range.ToObject(), "exportTo", prange, errmsg);
+  }
+  const Napi::Value &progress = options.Get("progress");
+  if (errmsg.empty() && !progress.IsUndefined() && !progress.IsFunction())
+    errmsg = "exportTo error: progress must be a function.";
+  if (!errmsg.empty()) {
+    delete pexp;
+    delete prange;
+    throwError(info, 1, ARG0_TYPE_0, true, errmsg.c_str());
+    return -1;
+  }
+  if (progress.IsFunction() &&
+      napi_create_threadsafe_function(
+          info.Env(), progress, nullptr,
+          Napi::String::New(info.Env(), "exportTo"), 0, 1, nullptr, nullptr,
+          nullptr, CallExportProgress, &pexp->progress) != napi_ok) {
+    delete pexp;
+    delete prange;
+    throwError(info, 1, ARG0_TYPE_0, false,
+               "exportTo error: failed to create the progress callback.");
+    return -1;
+  }
+
+  Napi::Function cb = info[cbArg].As<Napi::Function>();
+  UvWorkData *pdata = new UvWorkData(pVsamFile_, cb, info.Env());
+  pdata->pScanRange_ = prange;
+  pdata->pExport_ = pexp;
+  uv_work_t *request = new uv_work_t;
+  request->data = pdata;
+  queueWork(request, ExportExecute, ExportComplete);
+  return 0;
+}
+
+void WrappedVsam::ExportTo(const Napi::CallbackInfo &info) {
+  if (info.Length() == 2 && info[0].IsString() && info[1].IsFunction()) {
+    Export_(info, -1, 1); // options and callback arg #s
+  } else if (info.Length() == 3 && info[0].IsString() && info[1].IsObject() &&
+             info[2].IsFunction()) {
+    Export_(info, 1, 2);
+  } else {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, 1, ARG0_TYPE_0, true,
+               "exportTo error: exportTo() expects arguments: "
+               "path, (count, err), or: path, options, (count, err).");
+  }
+}
+
+void WrappedVsam::SnapshotTo(const Napi::CallbackInfo &info) {
+  if (info.Length() != 2 || !info[0].IsString() || !info[1].IsFunction()) {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, 1, ARG0_TYPE_0, true,
+               "snapshotTo error: snapshotTo() expects arguments: "
+               "path, (count, err).");
+    return;
+  }
+  if (errorIfNotOpen(info, 1, ARG0_TYPE_0, "snapshotTo"))
+    return;
+  RecordExport *pexp = new RecordExport;
+  pexp->format = RecordExport::SNAPSHOT;
+  pexp->path = static_cast<std::string>(info[0].As<Napi::String>());
+
+  Napi::Function cb = info[1].As<Napi::Function>();
+  UvWorkData *pdata = new UvWorkData(pVsamFile_, cb, info.Env());
+  pdata->pScanRange_ = new ScanRange;
+  pdata->pExport_ = pexp;
+  uv_work_t *request = new uv_work_t;
+  request->data = pdata;
+  queueWork(request, ExportExecute, ExportComplete);
+}
+
+bool WrappedVsam::parseFields(const Napi::Object &options, const char *pApiName,
+                              std::vector<int> &fieldnums,
+                              std::string &errmsg) {
+  // options.fields, or all the fields if not set
+  const Napi::Value &fields = options.Get("fields");
+  if (fields.IsUndefined()) {
+    for (size_t i = 0; i < pVsamFile_->getLayout().size(); i++)
+      fieldnums.push_back(i);
+    return true;
+  }
+  if (!fields.IsArray() || fields.As<Napi::Array>().Length() == 0) {
+    errmsg = std::string(pApiName) +
+             " error: fields must be a non-empty array of field names.";
+    return false;
+  }
+  const Napi::Array &names = fields.As<Napi::Array>();
+  for (uint32_t f = 0; f < names.Length(); f++) {
+    const Napi::Value &name = names.Get(f);
+    int i = name.IsString() ? pVsamFile_->getFieldNum(static_cast<std::string>(
+                                  name.As<Napi::String>()))
+                            : -1;
+    if (i < 0) {
+      errmsg = std::string(pApiName) +
+               " error: fields must be an array of field names of the schema.";
+      return false;
+    }
+    fieldnums.push_back(i);
+  }
+  return true;
+}
+
+Napi::Value WrappedVsam::createOwnedBuffer(Napi::Env env, std::string *pstr) {
+  // The Buffer takes ownership of *pstr, so its bytes aren't copied
+  return Napi::Buffer<char>::New(
+      env, &(*pstr)[0], pstr->length(),
+      [](Napi::Env, char *, std::string *pstr) { delete pstr; }, pstr);
+}
+
+Napi::Value WrappedVsam::createRecordJson(UvWorkData *pdata) {
+  // formatted by VsamFile::FindJsonExecute() on the VSAM thread
+  if (pdata->recbuf_ == nullptr)
+    return pdata->env_.Null();
+  return createOwnedBuffer(pdata->env_,
+                           new std::string(std::move(pdata->records_)));
+}
+
+void WrappedVsam::FindJsonComplete(uv_work_t *req, int status) {
+  UvWorkData *pdata = (UvWorkData *)(req->data);
+  delete req;
+
+  if (status == UV_ECANCELED) {
+    delete pdata;
+    return;
+  }
+  Napi::HandleScope scope(pdata->env_);
+  DCHECK(pdata->cb_ != nullptr && pdata->env_ != nullptr);
+  if (pdata->rc_ != 0)
+    pdata->cb_.Call(
+        pdata->env_.Global(),
+        {pdata->env_.Null(), Napi::String::New(pdata->env_, pdata->errmsg_)});
+  else
+    pdata->cb_.Call(pdata->env_.Global(),
+                    {createRecordJson(pdata), pdata->env_.Null()});
+  delete pdata;
+}
+
+void WrappedVsam::FindJson(const Napi::CallbackInfo &info) {
+  if (info.Length() == 2 && (info[0].IsString() || info[0].IsBuffer()) &&
+      info[1].IsFunction())
+    Find(info, __KEY_EQ, "findJson", 1, nullptr, ARG0_TYPE_NULL,
+         FindJsonExecute, FindJsonComplete);
+  else if (info.Length() == 3 && info[0].IsObject() && info[1].IsNumber() &&
+           info[2].IsFunction())
+    Find(info, __KEY_EQ, "findJson", 2, nullptr, ARG0_TYPE_NULL,
+         FindJsonExecute, FindJsonComplete);
+  else {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, 1, ARG0_TYPE_NULL, true,
+               "findJson error: findJson() expects arguments: "
+               "key-string, (json, err), "
+               "or: key-buffer[, key-buffer-length], (json, err).");
+  }
+}
+
+Napi::Value WrappedVsam::FindJsonSync(const Napi::CallbackInfo &info) {
+  UvWorkData *pdata = nullptr;
+  if ((info.Length() == 2 && info[0].IsObject() && info[1].IsNumber()) ||
+      (info.Length() == 1 && (info[0].IsString() || info[0].IsBuffer()))) {
+    if (Find(info, __KEY_EQ, "findJsonSync", -1, &pdata, ARG0_TYPE_NONE))
+      return info.Env().Null();
+  } else {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "findJsonSync error: findJsonSync() expects arguments: "
+               "key-string, "
+               "or key-buffer[, key-buffer-length].");
+    return info.Env().Null();
+  }
+  int rc = pVsamFile_->routeToVsamThread(MSG_FIND, &VsamFile::FindJsonExecute,
+                                         pdata);
+  if (rc || pdata->rc_) {
+    if (pdata->rc_ != 8) // else no record found
+      throwError(info, -1, ARG0_TYPE_NONE, true, pdata->errmsg_.c_str());
+    delete pdata;
+    return info.Env().Null();
+  }
+  Napi::Value json = createRecordJson(pdata);
+  delete pdata;
+  return json;
+}
+
+int WrappedVsam::ScanJson_(const Napi::CallbackInfo &info,
+                           const char *pApiName, UvWorkData **ppdata) {
+  CbFirstArgType firstArgType =
+      ppdata == nullptr ? ARG0_TYPE_NULL : ARG0_TYPE_NONE;
+  if (errorIfNotOpen(info, 1, firstArgType, pApiName))
+    return -1;
+  Napi::HandleScope scope(info.Env());
+
+  const Napi::Object &options = info[0].ToObject();
+  ScanRange *prange = new ScanRange;
+  RecordExport *pexp = new RecordExport;
+  std::string errmsg;
+  if (!parseScanRange(options, pApiName, prange, errmsg) ||
+      !parseFields(options, pApiName, pexp->fields, errmsg)) {
+    delete prange;
+    delete pexp;
+    throwError(info, 1, firstArgType, true, errmsg.c_str());
+    return -1;
+  }
+
+  UvWorkData *pdata;
+  if (ppdata != nullptr) {
+    // called for a sync API
+    Napi::Function dummycb;
+    pdata = *ppdata = new UvWorkData(pVsamFile_, dummycb, info.Env());
+  } else {
+    Napi::Function cb = info[1].As<Napi::Function>();
+    pdata = new UvWorkData(pVsamFile_, cb, info.Env());
+  }
+  pdata->pScanRange_ = prange;
+  pdata->pExport_ = pexp;
+  if (ppdata != nullptr)
+    return 0;
+  uv_work_t *request = new uv_work_t;
+  request->data = pdata;
+  queueWork(request, ScanJsonExecute, ScanJsonComplete);
+  return 0;
+}
+
+void WrappedVsam::ScanJson(const Napi::CallbackInfo &info) {
+  if (info.Length() == 2 && info[0].IsObject() && info[1].IsFunction())
+    ScanJson_(info, "scanJson");
+  else {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, 1, ARG0_TYPE_NULL, true,
+               "scanJson error: scanJson() expects arguments: "
+               "options, (json, err).");
+  }
+}
+
+Napi::Value WrappedVsam::ScanJsonSync(const Napi::CallbackInfo &info) {
+  UvWorkData *pdata = nullptr;
+  if (info.Length() == 1 && info[0].IsObject()) {
+    if (ScanJson_(info, "scanJsonSync", &pdata))
+      return info.Env().Null();
+  } else {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "scanJsonSync error: scanJsonSync() expects arguments: "
+               "options.");
+    return info.Env().Null();
+  }
+  int rc = pVsamFile_->routeToVsamThread(MSG_SCAN_JSON,
+                                         &VsamFile::ScanJsonExecute, pdata);
+  if (rc || pdata->rc_) {
+    throwError(info, -1, ARG0_TYPE_NONE, true, pdata->errmsg_.c_str());
+    delete pdata;
+    return info.Env().Null();
+  }
+  Napi::Value json = createOwnedBuffer(
+      info.Env(), new std::string(std::move(pdata->pExport_->output)));
+  delete pdata;
+  return json;
+}
+
+int WrappedVsam::ScanColumns_(const Napi::CallbackInfo &info,
+                              const char *pApiName, UvWorkData **ppdata) {
+  CbFirstArgType firstArgType =
+      ppdata == nullptr ? ARG0_TYPE_NULL : ARG0_TYPE_NONE;
+  if (errorIfNotOpen(info, 1, firstArgType, pApiName))
+    return -1;
+  Napi::HandleScope scope(info.Env());
+
+  const Napi::Object &options = info[0].ToObject();
+  ScanRange *prange = new ScanRange;
+  std::vector<int> fields;
+  std::string errmsg;
+  if (!parseScanRange(options, pApiName, prange, errmsg) ||
+      !parseFields(options, pApiName, fields, errmsg)) {
+    delete prange;
+    throwError(info, 1, firstArgType, true, errmsg.c_str());
+    return -1;
+  }
+  RecordColumns *pcols = new RecordColumns;
+  const std::vector<LayoutItem> &layout = pVsamFile_->getLayout();
+  for (auto f = fields.begin(); f != fields.end(); ++f) {
+    RecordColumns::Column::Type type = RecordColumns::Column::BYTES;
+    if (VsamFile::isNumericField(layout[*f]))
+      type = layout[*f].maxLength <= 4
+                 ? RecordColumns::Column::UINT32
+                 : layout[*f].maxLength <= 6 ? RecordColumns::Column::FLOAT64
+                                             : RecordColumns::Column::BIGUINT64;
+    pcols->columns.push_back(RecordColumns::Column(*f, type));
+    if (type == RecordColumns::Column::BYTES)
+      pcols->columns.back().u32.push_back(0);
+  }
+
+  UvWorkData *pdata;
+  if (ppdata != nullptr) {
+    // called for a sync API
+    Napi::Function dummycb;
+    pdata = *ppdata = new UvWorkData(pVsamFile_, dummycb, info.Env());
+  } else {
+    Napi::Function cb = info[1].As<Napi::Function>();
+    pdata = new UvWorkData(pVsamFile_, cb, info.Env());
+  }
+  pdata->pScanRange_ = prange;
+  pdata->pColumns_ = pcols;
+  if (ppdata != nullptr)
+    return 0;
+  uv_work_t *request = new uv_work_t;
+  request->data = pdata;
+  queueWork(request, ScanColumnsExecute, ScanColumnsComplete);
+  return 0;
+}
+
+void WrappedVsam::ScanColumns(const Napi::CallbackInfo &info) {
+  if (info.Length() == 2 && info[0].IsObject() && info[1].IsFunction())
+    ScanColumns_(info, "scanColumns");
+  else {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, 1, ARG0_TYPE_NULL, true,
+               "scanColumns error: scanColumns() expects arguments: "
+               "options, (batch, err).");
+  }
+}
+
+Napi::Value WrappedVsam::ScanColumnsSync(const Napi::CallbackInfo &info) {
+  UvWorkData *pdata = nullptr;
+  if (info.Length() == 1 && info[0].IsObject()) {
+    if (ScanColumns_(info, "scanColumnsSync", &pdata))
+      return info.Env().Null();
+  } else {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "scanColumnsSync error: scanColumnsSync() expects arguments: "
+               "options.");
+    return info.Env().Null();
+  }
+  int rc = pVsamFile_->routeToVsamThread(
+      MSG_SCAN_COLUMNS, &VsamFile::ScanColumnsExecute, pdata);
+  if (rc || pdata->rc_) {
+    throwError(info, -1, ARG0_TYPE_NONE, true, pdata->errmsg_.c_str());
+    delete pdata;
+    return info.Env().Null();
+  }
+  Napi::Value batch = createColumnsObject(pdata);
+  delete pdata;
+  return batch;
+}
+
+int WrappedVsam::ScanBatch_(const Napi::CallbackInfo &info,
+                            const char *pApiName, UvWorkData **ppdata) {
+  CbFirstArgType firstArgType =
+      ppdata == nullptr ? ARG0_TYPE_NULL : ARG0_TYPE_NONE;
+  if (errorIfNotOpen(info, 1, firstArgType, pApiName))
+    return -1;
+  Napi::HandleScope scope(info.Env());
+
+  ScanRange *prange = new ScanRange;
+  std::string errmsg;
+  if (!parseScanRange(info[0].ToObject(), pApiName, prange, errmsg)) {
+    delete prange;
+    throwError(info, 1, firstArgType, true, errmsg.c_str());
+    return -1;
+  }
+
+  UvWorkData *pdata;
+  if (ppdata != nullptr) {
+    // called for a sync API
+    Napi::Function dummycb;
+    pdata = *ppdata = new UvWorkData(pVsamFile_, dummycb, info.Env());
+  } else {
+    Napi::Function cb = info[1].As<Napi::Function>();
+    pdata = new UvWorkData(pVsamFile_, cb, info.Env());
+  }
+  pdata->pScanRange_ = prange;
+  if (ppdata != nullptr)
+    return 0;
+  uv_work_t *request = new uv_work_t;
+  request->data = pdata;
+  queueWork(request, ScanBatchExecute, ScanBatchComplete);
+  return 0;
+}
+
+void WrappedVsam::ScanBatch(const Napi::CallbackInfo &info) {
+  if (info.Length() == 2 && info[0].IsObject() && info[1].IsFunction())
+    ScanBatch_(info, "scanBatch");
+  else {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, 1, ARG0_TYPE_NULL, true,
+               "scanBatch error: scanBatch() expects arguments: "
+               "options, (batch, err).");
+  }
+}
+
+Napi::Value WrappedVsam::ScanBatchSync(const Napi::CallbackInfo &info) {
+  UvWorkData *pdata = nullptr;
+  if (info.Length() == 1 && info[0].IsObject()) {
+    if (ScanBatch_(info, "scanBatchSync", &pdata))
+      return info.Env().Null();
+  } else {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "scanBatchSync error: scanBatchSync() expects arguments: "
+               "options.");
+    return info.Env().Null();
+  }
+  int rc = pVsamFile_->routeToVsamThread(MSG_SCAN_BATCH,
+                                         &VsamFile::ScanBatchExecute, pdata);
+  if (rc || pdata->rc_) {
+    throwError(info, -1, ARG0_TYPE_NONE, true, pdata->errmsg_.c_str());
+    delete pdata;
+    return info.Env().Null();
+  }
+  Napi::Value batch = createBatchObject(pdata);
+  delete pdata;
+  return batch;
+}
+
+int WrappedVsam::ScanPage_(const Napi::CallbackInfo &info,
+                           const char *pApiName, UvWorkData **ppdata) {
+  CbFirstArgType firstArgType =
+      ppdata == nullptr ? ARG0_TYPE_NULL : ARG0_TYPE_NONE;
+  if (errorIfNotOpen(info, 1, firstArgType, pApiName))
+    return -1;
+  Napi::HandleScope scope(info.Env());
+
+  const Napi::Object &options = info[0].ToObject();
+  ScanRange *prange = new ScanRange;
+  std::string errmsg;
+  if (!parseScanRange(options, pApiName, prange, errmsg)) {
+    delete prange;
+    throwError(info, 1, firstArgType, true, errmsg.c_str());
+    return -1;
+  }
+  if (prange->maxCount == 0) {
+    delete prange;
+    throwError(info, 1, firstArgType, true,
+               "%s error: limit must be a number greater than 0.", pApiName);
+    return -1;
+  }
+  const Napi::Value &after = options.Get("after");
+  if (!after.IsUndefined() && !after.IsNull()) {
+    if (!prange->from.empty()) {
+      delete prange;
+      throwError(info, 1, firstArgType, true,
+                 "%s error: from and after cannot be used together.",
+                 pApiName);
+      return -1;
+    }
+    if (!after.IsString() ||
+        !decodePageToken(after.As<Napi::String>(), pVsamFile_->getKeyLength(),
+                         prange->from, prange->afterCount)) {
+      delete prange;
+      throwError(info, 1, firstArgType, true,
+                 "%s error: after must be the next token of a page returned "
+                 "by scanPage().",
+                 pApiName);
+      return -1;
+    }
+  }
+  prange->maxCount++; // the record after the page tells if there's a next one
+
+  UvWorkData *pdata;
+  if (ppdata != nullptr) {
+    // called for a sync API
+    Napi::Function dummycb;
+    pdata = *ppdata = new UvWorkData(pVsamFile_, dummycb, info.Env());
+  } else {
+    Napi::Function cb = info[1].As<Napi::Function>();
+    pdata = new UvWorkData(pVsamFile_, cb, info.Env());
+  }
+  pdata->pScanRange_ = prange;
+  if (ppdata != nullptr)
+    return 0;
+  uv_work_t *request = new uv_work_t;
+  request->data = pdata;
+  queueWork(request, ScanPageExecute, ScanPageComplete);
+  return 0;
+}
+
+void WrappedVsam::ScanPage(const Napi::CallbackInfo &info) {
+  if (info.Length() == 2 && info[0].IsObject() && info[1].IsFunction())
+    ScanPage_(info, "scanPage");
+  else {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, 1, ARG0_TYPE_NULL, true,
+               "scanPage error: scanPage() expects arguments: "
+               "options, (page, err).");
+  }
+}
+
+Napi::Value WrappedVsam::ScanPageSync(const Napi::CallbackInfo &info) {
+  UvWorkData *pdata = nullptr;
+  if (info.Length() == 1 && info[0].IsObject()) {
+    if (ScanPage_(info, "scanPageSync", &pdata))
+      return info.Env().Null();
+  } else {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "scanPageSync error: scanPageSync() expects arguments: "
+               "options.");
+    return info.Env().Null();
+  }
+  int rc = pVsamFile_->routeToVsamThread(MSG_SCAN_PAGE,
+                                         &VsamFile::ScanPageExecute, pdata);
+  if (rc || pdata->rc_) {
+    throwError(info, -1, ARG0_TYPE_NONE, true, pdata->errmsg_.c_str());
+    delete pdata;
+    return info.Env().Null();
+  }
+  Napi::Value page = createPageObject(pdata);
+  delete pdata;
+  return page;
+}
+
+void WrappedVsam::FindAll(const Napi::CallbackInfo &info) {
+  if (info.Length() == 2 && (info[0].IsString() || info[0].IsBuffer()) &&
+      info[1].IsFunction())
+    Find(info, __KEY_EQ, "findAll", 1, nullptr, ARG0_TYPE_NULL, FindAllExecute,
+         FindAllComplete);
+  else if (info.Length() == 3 && info[0].IsObject() && info[1].IsNumber() &&
+           info[2].IsFunction())
+    Find(info, __KEY_EQ, "findAll", 2, nullptr, ARG0_TYPE_NULL, FindAllExecute,
+         FindAllComplete);
+  else {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, 1, ARG0_TYPE_NULL, true,
+               "findAll error: findAll() expects arguments: "
+               "key-string, (records, err), "
+               "or: key-buffer[, key-buffer-length], (records, err).");
+  }
+}
+
+Napi::Value WrappedVsam::FindAllSync(const Napi::CallbackInfo &info) {
+  UvWorkData *pdata = nullptr;
+  if ((info.Length() == 2 && info[0].IsObject() && info[1].IsNumber()) ||
+      (info.Length() == 1 && (info[0].IsString() || info[0].IsBuffer()))) {
+    if (Find(info, __KEY_EQ, "findAllSync", -1, &pdata, ARG0_TYPE_NONE))
+      return info.Env().Null();
+  } else {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "findAllSync error: findAllSync() expects arguments: "
+               "key-string, "
+               "or key-buffer[, key-buffer-length].");
+    return info.Env().Null();
+  }
+  int rc = pVsamFile_->routeToVsamThread(MSG_FIND_ALL,
+                                         &VsamFile::FindAllExecute, pdata);
+  if (rc || pdata->rc_) {
+    throwError(info, -1, ARG0_TYPE_NONE, true, pdata->errmsg_.c_str());
+    delete pdata;
+    return info.Env().Null();
+  }
+  Napi::Value records = createRecordArray(pdata);
+  delete pdata;
+  return records;
+}
+
+Napi::Value WrappedVsam::createIndexStats(UvWorkData *pdata) {
+  DCHECK(pdata->pIndex_ != nullptr);
+  const IndexRequest &req = *pdata->pIndex_;
+  Napi::Object stats = Napi::Object::New(pdata->env_);
+  stats.Set("count", Napi::Number::New(pdata->env_, req.keys));
+  stats.Set("values", Napi::Number::New(pdata->env_, req.values));
+  stats.Set("memoryUsage", Napi::Number::New(pdata->env_, req.memoryUsage));
+  return stats;
+}
+
+int WrappedVsam::Index_(const Napi::CallbackInfo &info, const char *pApiName,
+                        bool withValue, UvWorkData **ppdata,
+                        uv_work_cb pExecuteFunc,
+                        uv_after_work_cb pCompleteFunc) {
+  CbFirstArgType firstArgType =
+      ppdata == nullptr ? ARG0_TYPE_NULL : ARG0_TYPE_NONE;
+  const int cbArg = withValue ? 2 : 1;
+  if (errorIfNotOpen(info, cbArg, firstArgType, pApiName))
+    return -1;
+  Napi::HandleScope scope(info.Env());
+
+  const std::vector<LayoutItem> &layout = pVsamFile_->getLayout();
+  const std::string &name =
+      static_cast<std::string>(info[0].As<Napi::String>());
+  int i = layout.size() - 1;
+  for (; i >= 0 && layout[i].name != name; i--)
+    ;
+  if (i < 0) {
+    std::string errmsg = std::string(pApiName) + " error: '" + name +
+                         "' is not a field of the schema.";
+    throwError(info, cbArg, firstArgType, true, errmsg.c_str());
+    return -1;
+  }
+  IndexRequest *preq = new IndexRequest;
+  preq->field = i;
+  if (withValue) {
+    // minLength doesn't apply to the value looked up:
+    LayoutItem item(layout[i]);
+    item.minLength = 0;
+    preq->value.assign(item.maxLength, 0);
+    std::string errmsg;
+    if (!encodeField(item, static_cast<std::string>(info[1].ToString()),
+                     &preq->value[0], pApiName, errmsg)) {
+      delete preq;
+      throwError(info, cbArg, firstArgType, true, errmsg.c_str());
+      return -1;
+    }
+  }
+
+  UvWorkData *pdata;
+  if (ppdata != nullptr) {
+    // called for a sync API
+    Napi::Function dummycb;
+    pdata = *ppdata = new UvWorkData(pVsamFile_, dummycb, info.Env());
+  } else {
+    Napi::Function cb = info[cbArg].As<Napi::Function>();
+    pdata = new UvWorkData(pVsamFile_, cb, info.Env());
+  }
+  pdata->pIndex_ = preq;
+  if (ppdata != nullptr)
+    return 0;
+  uv_work_t *request = new uv_work_t;
+  request->data = pdata;
+  queueWork(request, pExecuteFunc, pCompleteFunc);
+  return 0;
+}
+
+void WrappedVsam::BuildIndex(const Napi::CallbackInfo &info) {
+  if (info.Length() == 2 && info[0].IsString() && info[1].IsFunction())
+    Index_(info, "buildIndex", false, nullptr, BuildIndexExecute,
+           BuildIndexComplete);
+  else {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, 1, ARG0_TYPE_NULL, true,
+               "buildIndex error: buildIndex() expects arguments: "
+               "field-name, (stats, err).");
+  }
+}
+
+Napi::Value WrappedVsam::BuildIndexSync(const Napi::CallbackInfo &info) {
+  UvWorkData *pdata = nullptr;
+  if (info.Length() == 1 && info[0].IsString()) {
+    if (Index_(info, "buildIndexSync", false, &pdata))
+      return info.Env().Null();
+  } else {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "buildIndexSync error: buildIndexSync() expects arguments: "
+               "field-name.");
+    return info.Env().Null();
+  }
+  int rc = pVsamFile_->routeToVsamThread(MSG_BUILD_INDEX,
+                                         &VsamFile::BuildIndexExecute, pdata);
+  if (rc || pdata->rc_) {
+    throwError(info, -1, ARG0_TYPE_NONE, true, pdata->errmsg_.c_str());
+    delete pdata;
+    return info.Env().Null();
+  }
+  Napi::Value stats = createIndexStats(pdata);
+  delete pdata;
+  return stats;
+}
+
+void WrappedVsam::FindBy(const Napi::CallbackInfo &info) {
+  if (info.Length() == 3 && info[0].IsString() &&
+      (info[1].IsString() || info[1].IsNumber()) && info[2].IsFunction())
+    Index_(info, "findBy", true, nullptr, FindByExecute, FindByComplete);
+  else {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, 1, ARG0_TYPE_NULL, true,
+               "findBy error: findBy() expects arguments: "
+               "field-name, value, (records, err).");
+  }
+}
+
+Napi::Value WrappedVsam::FindBySync(const Napi::CallbackInfo &info) {
+  UvWorkData *pdata = nullptr;
+  if (info.Length() == 2 && info[0].IsString() &&
+      (info[1].IsString() || info[1].IsNumber())) {
+    if (Index_(info, "findBySync", true, &pdata))
+      return info.Env().Null();
+  } else {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "findBySync error: findBySync() expects arguments: "
+               "field-name, value.");
+    return info.Env().Null();
+  }
+  int rc = pVsamFile_->routeToVsamThread(MSG_FIND_BY, &VsamFile::FindByExecute,
+                                         pdata);
+  if (rc || pdata->rc_) {
+    throwError(info, -1, ARG0_TYPE_NONE, true, pdata->errmsg_.c_str());
+    delete pdata;
+    return info.Env().Null();
+  }
+  Napi::Value records = createRecordArray(pdata);
+  delete pdata;
+  return records;
+}
+
+Napi::Value WrappedVsam::IndexStats(const Napi::CallbackInfo &info) {
+  UvWorkData *pdata = nullptr;
+  if (info.Length() == 1 && info[0].IsString()) {
+    if (Index_(info, "indexStats", false, &pdata))
+      return info.Env().Null();
+  } else {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "indexStats error: indexStats() expects arguments: "
+               "field-name.");
+    return info.Env().Null();
+  }
+  int rc = pVsamFile_->routeToVsamThread(MSG_INDEX_STATS,
+                                         &VsamFile::IndexStatsExecute, pdata);
+  // rc_ is 8 if the field has no index
+  Napi::Value stats =
+      rc || pdata->rc_ ? info.Env().Null() : createIndexStats(pdata);
+  delete pdata;
+  return stats;
+}
+
+Napi::Value WrappedVsam::SetWriteBehind(const Napi::CallbackInfo &info) {
+  Napi::HandleScope scope(info.Env());
+  if (!(info.Length() == 1 && (info[0].IsObject() || info[0].IsBoolean()))) {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "setWriteBehind error: setWriteBehind() expects arguments: "
+               "options, or: false.");
+    return info.Env().Undefined();
+  }
+  if (errorIfNotOpen(info, -1, ARG0_TYPE_NONE, "setWriteBehind", false))
+    return info.Env().Undefined();
+  if (info[0].IsBoolean()) {
+    if (info[0].As<Napi::Boolean>().Value()) {
+      throwError(info, -1, ARG0_TYPE_NONE, true,
+                 "setWriteBehind error: setWriteBehind() expects arguments: "
+                 "options, or: false.");
+      return info.Env().Undefined();
+    }
+    if (batchesWriting_ > 0 || !staged_.empty()) {
+      throwError(info, -1, ARG0_TYPE_NONE, false,
+                 "setWriteBehind error: write-behind records must be flushed "
+                 "first.");
+      return info.Env().Undefined();
+    }
+    writeBehind_ = 0;
+    return info.Env().Undefined();
+  }
+  const Napi::Value &batchSize = info[0].ToObject().Get("batchSize");
+  int64_t n = 256;
+  if (!batchSize.IsUndefined()) {
+    n = batchSize.IsNumber() ? batchSize.As<Napi::Number>().Int64Value() : 0;
+    if (n < 1 || (double)n != batchSize.As<Napi::Number>().DoubleValue()) {
+      throwError(info, -1, ARG0_TYPE_NONE, true,
+                 "setWriteBehind error: batchSize must be a positive "
+                 "integer.");
+      return info.Env().Undefined();
+    }
+  }
+  if (pVsamFile_->isReadOnly()) {
+    throwError(info, -1, ARG0_TYPE_NONE, false,
+               "setWriteBehind error: the dataset is opened read-only.");
+    return info.Env().Undefined();
+  }
+  if (pVsamFile_->isDirect()) {
+    // the batches are written on the thread pool
+    throwError(info, -1, ARG0_TYPE_NONE, false,
+               "setWriteBehind error: the dataset was opened with "
+               "{direct: true}, so only the sync functions can be used.");
+    return info.Env().Undefined();
+  }
+  writeBehind_ = (size_t)n;
+  return info.Env().Undefined();
+}
+
+void WrappedVsam::writeStaged(Napi::Env env) {
+  Napi::Function dummycb;
+  UvWorkData *pdata = new UvWorkData(pVsamFile_, dummycb, env);
+  pdata->pWriteBatch_ = new WriteBatch(this);
+  // in key order, as staged_ is sorted by key:
+  size_t reclen = pVsamFile_->getRecordLength();
+  pdata->records_.reserve(staged_.size() * reclen);
+  for (auto i = staged_.begin(); i != staged_.end(); ++i)
+    pdata->records_.append(i->second);
+  staged_.clear();
+  batchesWriting_++;
+  Ref(); // until WriteBatchComplete(), which may be after the last reference
+  uv_work_t *request = new uv_work_t;
+  request->data = pdata;
+  queueWork(request, WriteBatchExecute, WriteBatchComplete);
+}
+
+void WrappedVsam::completeFlush(Napi::Env env) {
+  std::vector<Napi::FunctionReference *> callbacks;
+  callbacks.swap(flushCallbacks_);
+  if (pVsamFile_ == nullptr) {
+    // the dataset was deallocated while the last batch was written
+    for (auto i = callbacks.begin(); i != callbacks.end(); ++i) {
+      (*i)->Call(env.Global(),
+                 {env.Null(), Napi::String::New(env, "flush error: the dataset "
+                                                     "was closed.")});
+      delete *i;
+    }
+    writeFailures_.clear();
+    return;
+  }
+  const LayoutItem &keyItem = pVsamFile_->getLayout()[pVsamFile_->getKeyNum()];
+  Napi::Array failures = Napi::Array::New(env, writeFailures_.size());
+  for (size_t i = 0; i < writeFailures_.size(); i++) {
+    Napi::Object failure = Napi::Object::New(env);
+    failure.Set("key",
+                createFieldValue(env, keyItem, writeFailures_[i].first.data()));
+    failure.Set("error", Napi::String::New(env, writeFailures_[i].second));
+    failures.Set(i, failure);
+  }
+  writeFailures_.clear();
+  for (auto i = callbacks.begin(); i != callbacks.end(); ++i) {
+    (*i)->Call(env.Global(), {failures, env.Null()});
+    delete *i;
+  }
+}
+
+void WrappedVsam::Flush(const Napi::CallbackInfo &info) {
+  if (!(info.Length() == 1 && info[0].IsFunction())) {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, 1, ARG0_TYPE_NULL, true,
+               "flush error: flush() expects arguments: (failures, err).");
+    return;
+  }
+  if (errorIfNotOpen(info, 1, ARG0_TYPE_NULL, "flush", false))
+    return;
+  if (pVsamFile_->isDirect()) {
+    // as setWriteBehind(), since the batches are written on the thread pool
+    throwError(info, -1, ARG0_TYPE_NONE, false,
+               "flush error: the dataset was opened with {direct: true}, so "
+               "only the sync functions can be used.");
+    return;
+  }
+  if (writeBehind_ == 0) {
+    throwError(info, -1, ARG0_TYPE_NONE, false,
+               "flush error: write-behind isn't on, setWriteBehind() must be "
+               "called first.");
+    return;
+  }
+  Napi::Function cb = info[0].As<Napi::Function>();
+  flushCallbacks_.push_back(new Napi::FunctionReference(Napi::Persistent(cb)));
+  // called by WriteBatchComplete(), after a batch of what's staged, even if
+  // nothing is:
+  writeStaged(info.Env());
+}
+
+Napi::Value WrappedVsam::createExecResults(UvWorkData *pdata,
+                                           const char *pApiName,
+                                           std::string &errmsg) {
+  DCHECK(pdata->pExec_ != nullptr);
+  Napi::Env env = pdata->env_;
+  const std::vector<ExecOp> &ops = pdata->pExec_->ops;
+  const std::vector<LayoutItem> &layout = pdata->pVsamFile_->getLayout();
+  Napi::Array results = Napi::Array::New(env);
+  for (size_t o = 0; o < ops.size() && ops[o].rc != -1; o++) {
+    const ExecOp &op = ops[o];
+    Napi::Value result = env.Null();
+    if (op.rc != 0) {
+      errmsg += (errmsg.empty() ? std::string(pApiName) + " error: operation "
+                                : std::string("; operation ")) +
+                std::to_string(o + 1) + ": " + op.result;
+    } else if (op.type == ExecOp::FIND) {
+      if (!op.result.empty()) {
+        Napi::Object record = Napi::Object::New(env);
+        for (auto i = layout.begin(); i != layout.end(); ++i)
+          record.Set(i->name,
+                     createFieldValue(env, *i, op.result.data() + i->offset));
+        result = record;
+      }
+    } else
+      result = Napi::Number::New(env, op.type == ExecOp::WRITE ? 1 : op.count);
+    results.Set(o, result);
+  }
+  return results;
+}
+
+int WrappedVsam::Exec_(const Napi::CallbackInfo &info, const char *pApiName,
+                       UvWorkData **ppdata) {
+  CbFirstArgType firstArgType =
+      ppdata == nullptr ? ARG0_TYPE_NULL : ARG0_TYPE_NONE;
+  if (errorIfNotOpen(info, 1, firstArgType, pApiName))
+    return -1;
+  Napi::HandleScope scope(info.Env());
+
+  ExecPipeline *pexec = new ExecPipeline;
+  std::string errmsg;
+  if (!parseExec(info[0].As<Napi::Array>(), pApiName, pexec, errmsg)) {
+    delete pexec;
+    throwError(info, 1, firstArgType, true, errmsg.c_str());
+    return -1;
+  }
+  int priority = -1;
+  unsigned deadlineMs = 0;
+  if (info.Length() > 1 && info[1].IsObject() && !info[1].IsFunction()) {
+    const Napi::Object &options = info[1].ToObject();
+    const Napi::Value &stop = options.Get("stopOnError");
+    if (!stop.IsUndefined())
+      pexec->stopOnError = stop.ToBoolean();
+    if (!parseQueueOptions(options, pApiName, &priority, &deadlineMs,
+                           errmsg)) {
+      delete pexec;
+      throwError(info, 1, firstArgType, true, errmsg.c_str());
+      return -1;
+    }
+  }
+
+  UvWorkData *pdata;
+  if (ppdata != nullptr) {
+    // called for a sync API
+    Napi::Function dummycb;
+    pdata = *ppdata = new UvWorkData(pVsamFile_, dummycb, info.Env());
+  } else {
+    Napi::Function cb = info[info.Length() - 1].As<Napi::Function>();
+    pdata = new UvWorkData(pVsamFile_, cb, info.Env());
+  }
+  pdata->pExec_ = pexec;
+  pdata->priority_ = priority;
+  pdata->deadlineMs_ = deadlineMs;
+  if (ppdata != nullptr)
+    return 0;
+  uv_work_t *request = new uv_work_t;
+  request->data = pdata;
+  queueWork(request, ExecExecute, ExecComplete);
+  return 0;
+}
+
+void WrappedVsam::Exec(const Napi::CallbackInfo &info) {
+  if ((info.Length() == 2 && info[0].IsArray() && info[1].IsFunction()) ||
+      (info.Length() == 3 && info[0].IsArray() && info[1].IsObject() &&
+       info[2].IsFunction()))
+    Exec_(info, "exec");
+  else {
+    Napi::HandleScope scope(info.Env());
+    throwError(info, 1, ARG0_TYPE_NULL, true,
+               "exec error: exec() expects arguments: "
+               "operations, (results, err), "
+               "or: operations, options, (results, err).");
+  }
+}
+
+Napi::Value WrappedVsam::ExecSync(const Napi::CallbackInfo &info) {
+  UvWorkData *pdata = nullptr;
+  if ((info.Length() == 1 && info[0].IsArray()) ||
+      (info.Length() == 2 && info[0].IsArray() && info[1].IsObject())) {
+    if (Exec_(info, "execSync", &pdata))
+      return info.Env().Null();
+  } else {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "execSync error: execSync() expects arguments: "
+               "operations, or: operations, options.");
+    return info.Env().Null();
+  }
+  pVsamFile_->fencePendingFinds();
+  int rc =
+      pVsamFile_->routeToVsamThread(MSG_EXEC, &VsamFile::ExecExecute, pdata);
+  if (rc || pdata->rc_) {
+    throwError(info, -1, ARG0_TYPE_NONE, true, pdata->errmsg_.c_str());
+    delete pdata;
+    return info.Env().Null();
+  }
+  std::string errmsg;
+  Napi::Value results = createExecResults(pdata, "execSync", errmsg);
+  delete pdata;
+  if (!errmsg.empty()) {
+    // as throwError(), with the results of the operations that were run,
+    // those past the error too unless stopOnError is set
+    Napi::Error error = Napi::Error::New(info.Env(), errmsg);
+    error.Set("results", results);
+    error.ThrowAsJavaScriptException();
+    return info.Env().Null();
+  }
+  return results;
+}
+
+Napi::Value WrappedVsam::SetDeadline(const Napi::CallbackInfo &info) {
+  Napi::HandleScope scope(info.Env());
+  if (errorIfNotOpen(info, -1, ARG0_TYPE_NONE, "setDeadline", false))
+    return info.Env().Undefined();
+  int priority = -1;
+  unsigned deadlineMs = 0;
+  std::string errmsg;
+  if (info.Length() != 1 || !info[0].IsNumber()) {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "setDeadline error: setDeadline() expects arguments: "
+               "milliseconds.");
+    return info.Env().Undefined();
+  }
+  Napi::Object options = Napi::Object::New(info.Env());
+  options.Set("deadline", info[0]);
+  if (!parseQueueOptions(options, "setDeadline", &priority, &deadlineMs,
+                         errmsg)) {
+    throwError(info, -1, ARG0_TYPE_NONE, true, errmsg.c_str());
+    return info.Env().Undefined();
+  }
+  pVsamFile_->setDefaultDeadline(deadlineMs);
+  return info.Env().Undefined();
+}
+
+Napi::Value WrappedVsam::QueueStats_(const Napi::CallbackInfo &info) {
+  Napi::HandleScope scope(info.Env());
+  if (errorIfNotOpen(info, -1, ARG0_TYPE_NONE, "queueStats", false))
+    return info.Env().Null();
+  static const char *names[PRIORITY_CLASSES] = {"interactive", "batch"};
+  QueueStats stats[PRIORITY_CLASSES];
+  size_t depth;
+  pVsamFile_->getQueueStats(stats, &depth);
+  const InFlightLimit &inFlight = pVsamFile_->getInFlight();
+  Napi::Env env = info.Env();
+  Napi::Object result = Napi::Object::New(env);
+  result.Set("inFlight", Napi::Number::New(env, inFlight.count));
+  result.Set("waiting", Napi::Number::New(env, inFlight.waiting.size()));
+  result.Set("queued", Napi::Number::New(env, depth));
+  for (int c = 0; c < PRIORITY_CLASSES; c++) {
+    Napi::Object cls = Napi::Object::New(env);
+    cls.Set("count", Napi::Number::New(env, stats[c].count));
+    cls.Set("expired", Napi::Number::New(env, stats[c].expired));
+    cls.Set("meanWait",
+            Napi::Number::New(env, stats[c].count > 0
+                                       ? stats[c].totalWaitMs / stats[c].count
+                                       : 0));
+    cls.Set("maxWait", Napi::Number::New(env, stats[c].maxWaitMs));
+    result.Set(names[c], cls);
+  }
+  return result;
+}
+
+Napi::Value WrappedVsam::SetMaxInFlight(const Napi::CallbackInfo &info) {
+  Napi::HandleScope scope(info.Env());
+  if (errorIfNotOpen(info, -1, ARG0_TYPE_NONE, "setMaxInFlight", false))
+    return info.Env().Undefined();
+  double max = info.Length() >= 1 && info[0].IsNumber()
+                   ? info[0].As<Napi::Number>().DoubleValue()
+                   : -1;
+  if ((info.Length() != 1 && (info.Length() != 2 || !info[1].IsObject())) ||
+      max < 0 || max != (size_t)max) {
+    throwError(info, -1, ARG0_TYPE_NONE, true,
+               "setMaxInFlight error: setMaxInFlight() expects arguments: "
+               "maximum, or: maximum, options.");
+    return info.Env().Undefined();
+  }
+  bool wait = false;
+  if (info.Length() == 2) {
+    const Napi::Value &onFull = info[1].ToObject().Get("onFull");
+    const std::string &action =
+        onFull.IsString() ? static_cast<std::string>(onFull.As<Napi::String>())
+                          : "busy";
+    if (action != "busy" && action != "wait") {
+      throwError(info, -1, ARG0_TYPE_NONE, true,
+                 "setMaxInFlight error: onFull must be either busy or wait.");
+      return info.Env().Undefined();
+    }
+    wait = action == "wait";
+  }
+  InFlightLimit &inFlight = pVsamFile_->getInFlight();
+  inFlight.max = (size_t)max;
+  inFlight.wait = wait;
+  // start those waiting if the limit is raised, or fail them if it's now busy
+  while (!inFlight.waiting.empty() &&
+         (inFlight.max == 0 || inFlight.count < inFlight.max || !wait)) {
+    uv_work_t *request = inFlight.waiting.front();
+    inFlight.waiting.pop_front();
+    UvWorkData *pdata = (UvWorkData *)(request->data);
+    queueWork(request, pdata->pExecute_, pdata->pComplete_);
+  }
+  return info.Env().Undefined();
+}
+
+// Called by index.js around the call of a function with the signal or
+// timeout option, so that the requests it queues can be cancelled by id.
+Napi::Value WrappedVsam::BeginCancellable(const Napi::CallbackInfo &info) {
+  if (pVsamFile_ == nullptr) // the call that follows reports it's closed
+    return Napi::Number::New(info.Env(), 0);
+  std::shared_ptr<CancelState> state = std::make_shared<CancelState>();
+  uint32_t id = ++lastCancelId_;
+  cancels_[id] = state;
+  pVsamFile_->getIssuingCancel() = state;
+  return Napi::Number::New(info.Env(), id);
+}
+
+Napi::Value WrappedVsam::EndCancellable(const Napi::CallbackInfo &info) {
+  if (pVsamFile_ != nullptr)
+    pVsamFile_->getIssuingCancel().reset();
+  return info.Env().Undefined();
+}
+
+// Called by index.js around an async function given { priority, deadline }
+// in its last argument, which the requests it queues get.
+Napi::Value WrappedVsam::BeginQueueOptions(const Napi::CallbackInfo &info) {
+  Napi::HandleScope scope(info.Env());
+  if (pVsamFile_ == nullptr) // the call that follows reports it's closed
+    return info.Env().Undefined();
+  if (info.Length() != 2 || !info[0].IsString() || !info[1].IsObject())
+    return info.Env().Undefined();
+  const std::string &apiName = info[0].As<Napi::String>();
+  int priority = -1;
+  unsigned deadlineMs = 0;
+  std::string errmsg;
+  if (!parseQueueOptions(info[1].ToObject(), apiName.c_str(), &priority,
+                         &deadlineMs, errmsg)) {
+    throwError(info, -1, ARG0_TYPE_NONE, true, errmsg.c_str());
+    return info.Env().Undefined();
+  }
+  pVsamFile_->setIssuingQueue(priority, deadlineMs);
+  return info.Env().Undefined();
+}
+
+Napi::Value WrappedVsam::EndQueueOptions(const Napi::CallbackInfo &info) {
+  if (pVsamFile_ != nullptr)
+    pVsamFile_->setIssuingQueue(-1, 0);
+  return info.Env().Undefined();
+}
+
+Napi::Value WrappedVsam::Cancel(const Napi::CallbackInfo &info) {
+  Napi::HandleScope scope(info.Env());
+  if (info.Length() != 2 || !info[0].IsNumber() || !info[1].IsString())
+    return info.Env().Undefined();
+  auto i = cancels_.find(info[0].As<Napi::Number>().Uint32Value());
+  if (i == cancels_.end() || i->second->cancelled || pVsamFile_ == nullptr)
+    return info.Env().Undefined();
+  std::shared_ptr<CancelState> state = i->second;
+  state->reason = info[1].As<Napi::String>();
+  state->cancelled = true;
+  // those waiting for setMaxInFlight() are completed here, those queued to
+  // the thread pool are cancelled with the error set by WorkComplete(), and
+  // those already routed to the VSAM thread are skipped by it, or stop at
+  // the next record
+  InFlightLimit &inFlight = pVsamFile_->getInFlight();
+  std::vector<uv_work_t *> requests(state->requests);
+  for (auto r = requests.begin(); r != requests.end(); ++r) {
+    auto w = std::find(inFlight.waiting.begin(), inFlight.waiting.end(), *r);
+    if (w == inFlight.waiting.end()) {
+      uv_cancel((uv_req_t *)*r); // UV_EBUSY if it's started
+      continue;
+    }
+    inFlight.waiting.erase(w);
+    UvWorkData *pdata = (UvWorkData *)((*r)->data);
+    removeCancellable(*r);
+    pVsamFile_->isCancelled(pdata);
+    pdata->pComplete_(*r, 0);
+  }
+  return info.Env().Undefined();
+}
+
+Napi::Value WrappedVsam::CancelDone(const Napi::CallbackInfo &info) {
+  if (info.Length() == 1 && info[0].IsNumber())
+    cancels_.erase(info[0].As<Napi::Number>().Uint32Value());
+  return info.Env().Undefined();
+}
+
+// Called by the Cursor class of index.js: a cursor is created by id, and is
+// set around the call of a read or find function on it, whose request then
+// uses the cursor's position in the dataset.
+Napi::Value WrappedVsam::OpenCursor(const Napi::CallbackInfo &info) {
+  if (errorIfNotOpen(info, -1, ARG0_TYPE_NONE, "openCursor", false))
+    return info.Env().Undefined();
+  uint32_t id = ++lastCursorId_;
+  cursors_[id] = std::make_shared<CursorState>(id);
+  return Napi::Number::New(info.Env(), id);
+}
+
+Napi::Value WrappedVsam::UseCursor(const Napi::CallbackInfo &info) {
+  if (pVsamFile_ == nullptr || info.Length() != 1 || !info[0].IsNumber())
+    return info.Env().Undefined();
+  auto i = cursors_.find(info[0].As<Napi::Number>().Uint32Value());
+  if (i == cursors_.end())
+    pVsamFile_->getIssuingCursor().reset();
+  else
+    pVsamFile_->getIssuingCursor() = i->second;
+  return info.Env().Undefined();
+}
+
+Napi::Value WrappedVsam::CloseCursor(const Napi::CallbackInfo &info) {
+  // the requests in flight on the cursor keep its state until complete
+  if (info.Length() == 1 && info[0].IsNumber())
+    cursors_.erase(info[0].As<Napi::Number>().Uint32Value());
+  return info.Env().Undefined();
+}
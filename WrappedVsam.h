@@ -8,7 +8,9 @@
 #pragma once
 #include "VsamFile.h"
 #include "VsamThread.h"
+#include <map>
 #include <napi.h>
+#include <set>
 #include <uv.h>
 
 // TODO(gabylb): this and throwError() should probably be refactored
@@ -20,27 +22,104 @@ enum CbFirstArgType {
   ARG0_TYPE_ERR
 };
 
+class WrappedVsam;
+
+// Per-environment data, so that the addon can be loaded by the main thread
+// and by any number of worker threads, each with its own datasets:
+struct AddonData {
+  Napi::FunctionReference constructor;
+  Napi::FunctionReference recordBatchConstructor;
+  Napi::FunctionReference snapshotConstructor;
+  Napi::FunctionReference compiledSchemaConstructor;
+  uv_loop_t *loop;
+  std::set<WrappedVsam *> objects; // to close on exit of the environment
+  // the requests completed on the next turn of the loop, see completeLater()
+  uv_async_t *laterAsync;
+  std::vector<uv_work_t *> later;
+};
+
 class WrappedVsam : public Napi::ObjectWrap<WrappedVsam> {
 public:
   static Napi::Object Init(Napi::Env env, Napi::Object exports);
   static Napi::Object OpenSync(const Napi::CallbackInfo &info);
   static Napi::Object AllocSync(const Napi::CallbackInfo &info);
+  static Napi::Value OpenAsync(const Napi::CallbackInfo &info);
+  static Napi::Value AllocAsync(const Napi::CallbackInfo &info);
   static Napi::Boolean Exist(const Napi::CallbackInfo &info);
 
   WrappedVsam(const Napi::CallbackInfo &info);
   ~WrappedVsam();
 
+  static AddonData *getAddonData(Napi::Env env);
+  static Napi::Value createFieldValue(Napi::Env env, const LayoutItem &item,
+                                      const char *fldbuf);
+  static bool parseSchema(const Napi::CallbackInfo &info,
+                          const Napi::Object &schema, const char *pApiName,
+                          std::vector<LayoutItem> &layout, int &key_i,
+                          int &keypos, bool *paltKey = nullptr);
+  static bool encodeKey(const LayoutItem &item, const Napi::Value &value,
+                        const char *pApiName, std::string &key,
+                        std::string &errmsg);
+  static bool parseScanRange(const std::vector<LayoutItem> &layout, int key_i,
+                             const Napi::Object &options, const char *pApiName,
+                             ScanRange *prange, std::string &errmsg,
+                             bool withKeys = true);
+
 private:
-  static Napi::Object Construct(const Napi::CallbackInfo &info, bool alloc);
+  static Napi::Object Construct(const Napi::CallbackInfo &info, bool alloc,
+                                const char *pApiName, bool async = false);
+  static Napi::Value ConstructAsync(const Napi::CallbackInfo &info,
+                                    bool alloc, const char *pApiName);
+  static uv_loop_t *eventLoop(Napi::Env env);
+  static void DeleteAddonData(napi_env env, void *data, void *hint);
+  static void Cleanup(void *arg);
   static Napi::Value createRecordObject(UvWorkData *pdata);
+  static Napi::Value createAggregateObject(UvWorkData *pdata);
+  static Napi::Value createOwnedBuffer(Napi::Env env, std::string *pstr);
+  static Napi::Value createRecordJson(UvWorkData *pdata);
+  static Napi::Value createColumnsObject(UvWorkData *pdata);
+  static Napi::Value createBatchObject(UvWorkData *pdata);
+  static Napi::Value createRecordArray(UvWorkData *pdata);
+  static Napi::Value createPageObject(UvWorkData *pdata);
+  static Napi::Value createIndexStats(UvWorkData *pdata);
+  // if a request can change records, so a find issued after it can't share
+  // the result of one issued before it
+  static bool isMutating(uv_work_cb pExecuteFunc);
+  static std::string pendingFindKey(int equality, const char *keybuf,
+                                    size_t keybuf_len);
+  static Napi::Value createExecResults(UvWorkData *pdata, const char *pApiName,
+                                       std::string &errmsg);
 
-  void deleteVsamFileObj();
+  void deleteVsamFileObj(bool envExited = false);
   bool validateStr(const LayoutItem &item, const std::string &str);
   bool validateHexBuf(const LayoutItem &item, const char *buf, int len);
   bool validateHexStr(const LayoutItem &item, const std::string &hexstr);
+  static bool encodeField(const LayoutItem &item, const std::string &str,
+                          char *fldbuf, const char *pApiName,
+                          std::string &errmsg);
+  bool encodeKey(const Napi::Value &value, const char *pApiName,
+                 std::string &key, std::string &errmsg);
+  bool encodeRecord(const Napi::Object &record, const char *pApiName,
+                    char *recbuf, std::string &errmsg);
+  bool encodeFieldsToUpdate(const Napi::Object &record, const char *pApiName,
+                            char *recbuf, std::vector<FieldToUpdate> *pupd,
+                            std::string &errmsg);
+  bool parseScanRange(const Napi::Object &options, const char *pApiName,
+                      ScanRange *prange, std::string &errmsg,
+                      bool withKeys = true);
+  bool parseFields(const Napi::Object &options, const char *pApiName,
+                   std::vector<int> &fieldnums, std::string &errmsg);
+  static bool parseQueueOptions(const Napi::Object &options,
+                                const char *pApiName, int *ppriority,
+                                unsigned *pdeadlineMs, std::string &errmsg);
+  bool parseExec(const Napi::Array &ops, const char *pApiName,
+                 ExecPipeline *pexec, std::string &errmsg);
+  bool parseAggregation(const Napi::Object &options, const char *pApiName,
+                        Aggregation *paggr, std::string &errmsg);
 
   /* Entry point from Javascript */
   void Close(const Napi::CallbackInfo &info);
+  Napi::Value CloseAsync(const Napi::CallbackInfo &info);
   void Read(const Napi::CallbackInfo &info);
   void FindEq(const Napi::CallbackInfo &info);
   void FindGe(const Napi::CallbackInfo &info);
@@ -50,6 +129,22 @@ private:
   void Write(const Napi::CallbackInfo &info);
   void Delete(const Napi::CallbackInfo &info);
   void Dealloc(const Napi::CallbackInfo &info);
+  void LoadBatch(const Napi::CallbackInfo &info);
+  void DeleteRange(const Napi::CallbackInfo &info);
+  void UpdateRange(const Napi::CallbackInfo &info);
+  void Aggregate(const Napi::CallbackInfo &info);
+  void ExportTo(const Napi::CallbackInfo &info);
+  void FindJson(const Napi::CallbackInfo &info);
+  void ScanJson(const Napi::CallbackInfo &info);
+  void ScanColumns(const Napi::CallbackInfo &info);
+  void ScanBatch(const Napi::CallbackInfo &info);
+  void ScanPage(const Napi::CallbackInfo &info);
+  void SnapshotTo(const Napi::CallbackInfo &info);
+  void FindAll(const Napi::CallbackInfo &info);
+  void BuildIndex(const Napi::CallbackInfo &info);
+  void FindBy(const Napi::CallbackInfo &info);
+  void Flush(const Napi::CallbackInfo &info);
+  void Exec(const Napi::CallbackInfo &info);
 
   /* Helpers for Entry point from Javascript */
   int Write_(const Napi::CallbackInfo &info, const char *pApiName,
@@ -62,6 +157,27 @@ private:
                   const int cbArg = -1);
   int FindDelete_(const Napi::CallbackInfo &info, const char *pApiName,
                   UvWorkData **ppdata = nullptr, const int cbArg = -1);
+  int Range_(const Napi::CallbackInfo &info, const char *pApiName,
+             const int recArg, const int optArg, const int cbArg,
+             UvWorkData **ppdata = nullptr);
+  int Aggregate_(const Napi::CallbackInfo &info, const char *pApiName,
+                 UvWorkData **ppdata = nullptr);
+  int Export_(const Napi::CallbackInfo &info, const int optArg,
+              const int cbArg);
+  int ScanJson_(const Napi::CallbackInfo &info, const char *pApiName,
+                UvWorkData **ppdata = nullptr);
+  int ScanColumns_(const Napi::CallbackInfo &info, const char *pApiName,
+                   UvWorkData **ppdata = nullptr);
+  int ScanBatch_(const Napi::CallbackInfo &info, const char *pApiName,
+                 UvWorkData **ppdata = nullptr);
+  int ScanPage_(const Napi::CallbackInfo &info, const char *pApiName,
+                UvWorkData **ppdata = nullptr);
+  int Index_(const Napi::CallbackInfo &info, const char *pApiName,
+             bool withValue, UvWorkData **ppdata = nullptr,
+             uv_work_cb pExecuteFunc = nullptr,
+             uv_after_work_cb pCompleteFunc = nullptr);
+  int Exec_(const Napi::CallbackInfo &info, const char *pApiName,
+            UvWorkData **ppdata = nullptr);
   Napi::Value FindSync_(const Napi::CallbackInfo &info, UvWorkData *pdata);
 
   Napi::Value ReadSync(const Napi::CallbackInfo &info);
@@ -72,9 +188,67 @@ private:
   Napi::Value UpdateSync(const Napi::CallbackInfo &info);
   Napi::Value WriteSync(const Napi::CallbackInfo &info);
   Napi::Value DeleteSync(const Napi::CallbackInfo &info);
+  Napi::Value LoadBegin(const Napi::CallbackInfo &info);
+  Napi::Value LoadEnd(const Napi::CallbackInfo &info);
+  Napi::Value DeleteRangeSync(const Napi::CallbackInfo &info);
+  Napi::Value UpdateRangeSync(const Napi::CallbackInfo &info);
+  Napi::Value AggregateSync(const Napi::CallbackInfo &info);
+  Napi::Value FindJsonSync(const Napi::CallbackInfo &info);
+  Napi::Value ScanJsonSync(const Napi::CallbackInfo &info);
+  Napi::Value ScanColumnsSync(const Napi::CallbackInfo &info);
+  Napi::Value ScanBatchSync(const Napi::CallbackInfo &info);
+  Napi::Value ScanPageSync(const Napi::CallbackInfo &info);
+  Napi::Value FindAllSync(const Napi::CallbackInfo &info);
+  Napi::Value BuildIndexSync(const Napi::CallbackInfo &info);
+  Napi::Value FindBySync(const Napi::CallbackInfo &info);
+  Napi::Value IndexStats(const Napi::CallbackInfo &info);
+  Napi::Value SetWriteBehind(const Napi::CallbackInfo &info);
+  Napi::Value ExecSync(const Napi::CallbackInfo &info);
+  Napi::Value SetDeadline(const Napi::CallbackInfo &info);
+  Napi::Value QueueStats_(const Napi::CallbackInfo &info);
+  Napi::Value SetMaxInFlight(const Napi::CallbackInfo &info);
+  Napi::Value BeginCancellable(const Napi::CallbackInfo &info);
+  Napi::Value EndCancellable(const Napi::CallbackInfo &info);
+  Napi::Value BeginQueueOptions(const Napi::CallbackInfo &info);
+  Napi::Value EndQueueOptions(const Napi::CallbackInfo &info);
+  Napi::Value Cancel(const Napi::CallbackInfo &info);
+  Napi::Value CancelDone(const Napi::CallbackInfo &info);
+  Napi::Value OpenCursor(const Napi::CallbackInfo &info);
+  Napi::Value UseCursor(const Napi::CallbackInfo &info);
+  Napi::Value CloseCursor(const Napi::CallbackInfo &info);
+
+  /* Promise versions, resolved or rejected from their work callback */
+  Napi::Value ReadAsync(const Napi::CallbackInfo &info);
+  Napi::Value FindEqAsync(const Napi::CallbackInfo &info);
+  Napi::Value FindGeAsync(const Napi::CallbackInfo &info);
+  Napi::Value FindFirstAsync(const Napi::CallbackInfo &info);
+  Napi::Value FindLastAsync(const Napi::CallbackInfo &info);
+  Napi::Value WriteAsync(const Napi::CallbackInfo &info);
+  Napi::Value UpdateAsync(const Napi::CallbackInfo &info);
+  Napi::Value DeleteAsync(const Napi::CallbackInfo &info);
+  Napi::Value FindAsync_(const Napi::CallbackInfo &info, int equality,
+                         const char *pApiName);
+  // Returns false if the request is refused, in which case it's completed
+  // with the error on the next turn of the event loop:
+  static bool queueWork(uv_work_t *request, uv_work_cb pExecuteFunc,
+                        uv_after_work_cb pCompleteFunc);
+  static void WorkComplete(uv_work_t *req, int status);
+  static void removeCancellable(uv_work_t *req);
+  static void workDone(VsamFile *pVsamFile);
+  static bool dropIfEnvExited(uv_work_t *req);
+  static void dropRequest(uv_work_t *req);
+  static void completeLater(uv_work_t *request, uv_after_work_cb pCompleteFunc);
+  static void LaterComplete(uv_async_t *handle);
+  static Napi::Value rejectPending(Napi::Env env);
+  static Napi::Value queuePromise(UvWorkData *pdata, uv_work_cb pExecuteFunc,
+                                  uv_after_work_cb pCompleteFunc);
+  static void settlePromise(UvWorkData *pdata, Napi::Value result);
 
   /* Work functions */
   static void DeallocExecute(uv_work_t *req);
+  static void OpenExecute(uv_work_t *req);
+  static void AllocExecute(uv_work_t *req);
+  static void CloseExecute(uv_work_t *req);
   static void ReadExecute(uv_work_t *req);
   static void FindExecute(uv_work_t *req);
   static void UpdateExecute(uv_work_t *req);
@@ -82,16 +256,52 @@ private:
   static void FindDeleteExecute(uv_work_t *req);
   static void WriteExecute(uv_work_t *req);
   static void DeleteExecute(uv_work_t *req);
+  static void LoadExecute(uv_work_t *req);
+  static void DeleteRangeExecute(uv_work_t *req);
+  static void UpdateRangeExecute(uv_work_t *req);
+  static void AggregateExecute(uv_work_t *req);
+  static void ExportExecute(uv_work_t *req);
+  static void ScanJsonExecute(uv_work_t *req);
+  static void FindJsonExecute(uv_work_t *req);
+  static void ScanColumnsExecute(uv_work_t *req);
+  static void ScanBatchExecute(uv_work_t *req);
+  static void ScanPageExecute(uv_work_t *req);
+  static void FindAllExecute(uv_work_t *req);
+  static void BuildIndexExecute(uv_work_t *req);
+  static void FindByExecute(uv_work_t *req);
+  static void WriteBatchExecute(uv_work_t *req);
+  static void ExecExecute(uv_work_t *req);
 
   /* Work callback functions */
   static void DefaultComplete(uv_work_t *req, int status);
   static void DeallocComplete(uv_work_t *req, int status);
+  static void OpenComplete(uv_work_t *req, int status);
+  static void CloseComplete(uv_work_t *req, int status);
   static void ReadComplete(uv_work_t *req, int status);
   static void UpdateComplete(uv_work_t *req, int status);
   static void FindUpdateComplete(uv_work_t *req, int status);
   static void FindDeleteComplete(uv_work_t *req, int status);
   static void WriteComplete(uv_work_t *req, int status);
   static void DeleteComplete(uv_work_t *req, int status);
+  static void LoadComplete(uv_work_t *req, int status);
+  static void DeleteRangeComplete(uv_work_t *req, int status);
+  static void UpdateRangeComplete(uv_work_t *req, int status);
+  static void AggregateComplete(uv_work_t *req, int status);
+  static void ExportComplete(uv_work_t *req, int status);
+  static void FindJsonComplete(uv_work_t *req, int status);
+  static void ScanJsonComplete(uv_work_t *req, int status);
+  static void ScanColumnsComplete(uv_work_t *req, int status);
+  static void ScanBatchComplete(uv_work_t *req, int status);
+  static void ScanPageComplete(uv_work_t *req, int status);
+  static void FindAllComplete(uv_work_t *req, int status);
+  static void BuildIndexComplete(uv_work_t *req, int status);
+  static void FindByComplete(uv_work_t *req, int status);
+  static void WriteBatchComplete(uv_work_t *req, int status);
+  static void ExecComplete(uv_work_t *req, int status);
+  static void CallExportProgress(napi_env env, napi_value jsProgress,
+                                 void *context, void *data);
+  static void RecordPromiseComplete(uv_work_t *req, int status);
+  static void CountPromiseComplete(uv_work_t *req, int status);
 
   int Find(const Napi::CallbackInfo &info, int equality, const char *pApiName,
            int callbackArg, UvWorkData **ppdata = nullptr,
@@ -100,11 +310,35 @@ private:
            uv_after_work_cb pCompleteFunc = ReadComplete,
            char *pUpdateRecBuf = nullptr,
            std::vector<FieldToUpdate> *pFieldsToUpdate = nullptr);
+  // Unless fence is false, the write-behind records staged are sent to the
+  // VSAM thread, so that the call sees them:
   bool errorIfNotOpen(const Napi::CallbackInfo &info, int errArgNum,
-                      CbFirstArgType firstArgType, const char *pApiName);
+                      CbFirstArgType firstArgType, const char *pApiName,
+                      bool fence = true);
+  void writeStaged(Napi::Env env);
+  bool updateStaged(const Napi::CallbackInfo &info, int recArg,
+                    const char *pUpdateRecBuf,
+                    const std::vector<FieldToUpdate> &fields);
+  void completeFlush(Napi::Env env);
 
 private:
-  static Napi::FunctionReference constructor_;
+  AddonData *pAddonData_; // null after the environment's cleanup
   VsamFile *pVsamFile_;
   std::string path_; // for Dealloc(), pVsamFile_ is deleted in Close()
+  bool closing_;     // by closeAsync()
+  // write-behind: the number of records staged that starts a batch (0 if
+  // off), the records staged by key, whether a batch is being written, and
+  // the failures and flush() callbacks not yet reported:
+  size_t writeBehind_;
+  std::map<std::string, std::string> staged_;
+  size_t batchesWriting_;
+  std::vector<std::pair<std::string, std::string>> writeFailures_;
+  std::vector<Napi::FunctionReference *> flushCallbacks_;
+  // the cancellations of the requests issued with a signal or a timeout, by
+  // the id returned to index.js:
+  std::map<uint32_t, std::shared_ptr<CancelState>> cancels_;
+  uint32_t lastCancelId_;
+  // the cursors of openCursor() by id, from 1
+  std::map<uint32_t, std::shared_ptr<CursorState>> cursors_;
+  uint32_t lastCursorId_;
 };
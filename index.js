@@ -1,3 +1,245 @@
 var binding = require('bindings')('vsam.js.node')
 
+async function bulkLoad(file, source, options, result) {
+  const batchSize = options.batchSize || 1000;
+  const start = Date.now();
+  const report = () => {
+    result.elapsed = Date.now() - start;
+    result.recordsPerSecond = result.elapsed > 0 ?
+        Math.round(result.count * 1000 / result.elapsed) : result.count;
+  };
+  const write = (batch) => new Promise((resolve, reject) => {
+    file._loadBatch(batch, (count, err) => {
+      result.count += count;
+      if (err)
+        reject(new Error(err));
+      else
+        resolve();
+    });
+  });
+
+  file._loadBegin();
+  try {
+    let batch = [];
+    for await (const record of source) {
+      batch.push(record);
+      if (batch.length < batchSize)
+        continue;
+      await write(batch);
+      batch = [];
+      report();
+      if (options.progress)
+        options.progress(result);
+    }
+    if (batch.length > 0)
+      await write(batch);
+  } catch (err) {
+    try {
+      file._loadEnd();
+    } catch (e) {
+      // reported after the error that stopped the load, which comes first
+      err.loadEndError = e;
+      err.message += "; " + e.message;
+    }
+    throw err;
+  }
+  file._loadEnd();
+  report();
+}
+
+// Loads the records from source, an iterable or async iterable (e.g. a
+// Readable in object mode) in ascending key order, into an empty dataset.
+binding.WrappedVsam.prototype.bulkLoad = function(source, options, callback) {
+  if (typeof options === 'function') {
+    callback = options;
+    options = {};
+  }
+  if (typeof callback !== 'function')
+    throw new TypeError("bulkLoad error: bulkLoad() expects arguments: " +
+                        "source, optional options, (result, err).");
+  if (source == null || (typeof source[Symbol.iterator] !== 'function' &&
+                         typeof source[Symbol.asyncIterator] !== 'function')) {
+    callback(null, "bulkLoad error: source must be an iterable or a Readable.");
+    return;
+  }
+  const result = { count: 0, elapsed: 0, recordsPerSecond: 0 };
+  bulkLoad(this, source, options || {}, result).then(
+    () => callback(result, null),
+    (err) => callback(result, err.message));
+}
+
+// Opens the datasets described by { path, schema, mode } concurrently, each
+// one by its own thread; if any fails, those opened are closed.
+binding.openMany = async function(datasets) {
+  if (!Array.isArray(datasets))
+    throw new TypeError("openMany error: openMany() expects argument: " +
+                        "array of { path, schema, optional mode }.");
+  const results = await Promise.allSettled(datasets.map((d) => {
+    if (d === null || typeof d !== 'object')
+      return Promise.reject(new TypeError(
+          "openMany error: each dataset must be { path, schema, optional " +
+          "mode }."));
+    return d.mode === undefined ? binding.openAsync(d.path, d.schema)
+                                : binding.openAsync(d.path, d.schema, d.mode);
+  }));
+  const failed = results.find((r) => r.status === 'rejected');
+  if (failed === undefined)
+    return results.map((r) => r.value);
+  await Promise.allSettled(results.filter((r) => r.status === 'fulfilled')
+                                  .map((r) => r.value.closeAsync()));
+  throw failed.reason;
+}
+
+// The trailing { signal, timeout, priority, deadline } argument of an async
+// function, which isn't a record or the options of the function itself: it
+// follows the callback, or for a promise-returning function, it only has
+// these properties, each of its type, which a record's fields aren't.
+function isRequestOptions(name, args) {
+  const arg = args[args.length - 1];
+  if (arg === null || typeof arg !== 'object' || Array.isArray(arg) ||
+      Buffer.isBuffer(arg))
+    return false;
+  if (!name.endsWith('Async') &&
+      (args.length < 2 || typeof args[args.length - 2] !== 'function'))
+    return false;
+  const valid = {
+    signal: (v) => typeof AbortSignal === 'function' && v instanceof AbortSignal,
+    timeout: (v) => typeof v === 'number',
+    priority: (v) => v === 'interactive' || v === 'batch',
+    deadline: (v) => typeof v === 'number',
+  };
+  const keys = Object.keys(arg);
+  return keys.length > 0 &&
+         keys.every((key) => valid.hasOwnProperty(key) &&
+                             (!name.endsWith('Async') || valid[key](arg[key])));
+}
+
+// Wraps an async function so that it can be given a last argument
+// { signal, timeout, priority, deadline }: when the AbortSignal is aborted or
+// the timeout (in ms) expires, the requests it queued that haven't started
+// are removed, and those running stop at the next record, with a "cancel
+// error:" message; priority and deadline are set on the requests it queues,
+// as by the options of exec().
+function cancellable(name, method) {
+  return function(...args) {
+    if (args.length === 0 || !isRequestOptions(name, args))
+      return method.apply(this, args);
+    const { signal, timeout, priority, deadline } = args.pop();
+    if (priority === undefined && deadline === undefined)
+      return issue.call(this, method, args, signal, timeout);
+    this._beginQueueOptions(name, { priority, deadline });
+    try {
+      return issue.call(this, method, args, signal, timeout);
+    } finally {
+      this._endQueueOptions();
+    }
+  };
+}
+
+// Calls the wrapped method, cancellable by signal or timeout if either is set.
+function issue(method, args, signal, timeout) {
+  if (signal === undefined && timeout === undefined)
+    return method.apply(this, args);
+  const id = this._beginCancellable();
+  let timer = null, finished = false;
+  const onAbort = () => this._cancel(id, 'was aborted');
+  const done = () => {
+    if (finished)
+      return;
+    finished = true;
+    if (timer !== null)
+      clearTimeout(timer);
+    if (signal)
+      signal.removeEventListener('abort', onAbort);
+    this._cancelDone(id);
+  };
+  const last = args.length - 1;
+  const hasCallback = last >= 0 && typeof args[last] === 'function';
+  if (hasCallback) {
+    const callback = args[last];
+    args[last] = function(...results) {
+      done();
+      return callback.apply(this, results);
+    };
+  }
+  let result;
+  try {
+    result = method.apply(this, args);
+  } catch (err) {
+    done();
+    throw err;
+  } finally {
+    this._endCancellable();
+  }
+  if (result instanceof Promise)
+    result = result.finally(done);
+  else if (!hasCallback)
+    done(); // nothing was queued, e.g. a write staged for write-behind
+  if (!finished) {
+    if (timeout > 0)
+      timer = setTimeout(
+          () => this._cancel(id, `timed out after ${timeout} ms`), timeout);
+    if (signal) {
+      if (signal.aborted)
+        onAbort();
+      else
+        signal.addEventListener('abort', onAbort);
+    }
+  }
+  return result;
+}
+
+for (const name of ['read', 'find', 'findeq', 'findge', 'findfirst',
+                    'findlast', 'update', 'write', 'delete', 'deleteRange',
+                    'updateRange', 'aggregate',
+                    'exportTo', 'snapshotTo', 'findJson', 'scanJson',
+                    'scanColumns', 'scanBatch', 'scanPage', 'findAll',
+                    'buildIndex', 'findBy', 'exec', 'readAsync', 'findAsync',
+                    'findeqAsync', 'findgeAsync', 'findfirstAsync',
+                    'findlastAsync', 'writeAsync', 'updateAsync',
+                    'deleteAsync'])
+  binding.WrappedVsam.prototype[name] =
+      cancellable(name, binding.WrappedVsam.prototype[name]);
+
+// A cursor of openCursor(): its reads and finds use its own position in the
+// dataset, which is only restored when another cursor, or the dataset object
+// itself, used the dataset last.
+class Cursor {
+  constructor(file) {
+    this._file = file;
+    this._id = file._openCursor();
+  }
+
+  close() {
+    this._file._closeCursor(this._id);
+    this._id = 0;
+  }
+}
+
+for (const name of ['read', 'find', 'findeq', 'findge', 'findfirst',
+                    'findlast']) {
+  for (const fn of [name, name + 'Sync', name + 'Async']) {
+    Cursor.prototype[fn] = function(...args) {
+      if (this._id === 0)
+        throw new Error(`${fn} error: the cursor is closed.`);
+      this._file._useCursor(this._id);
+      try {
+        return this._file[fn](...args);
+      } finally {
+        this._file._useCursor(0);
+      }
+    };
+  }
+}
+
+binding.WrappedVsam.prototype.openCursor = function() {
+  return new Cursor(this);
+}
+
+// Iterates over the keys of a RecordBatch, decoding each one as it's reached.
+binding.RecordBatch.prototype.keys = function* () {
+  for (let i = 0; i < this.length; i++)
+    yield this.getKey(i);
+}
+
 module.exports = binding
@@ -5,6 +5,7 @@
 */
 
 const vsam = require("../build/Release/vsam.js.node");
+require("../index.js"); // adds the functions implemented in JavaScript
 const async = require('async');
 const fs = require('fs');
 const expect = require('chai').expect;
@@ -616,10 +617,10 @@ describe(title, function() {
         record3 = {
           key: "F1F2F3F4",
           name: "TEST"
-          // leave amount undefined, update should fail
+          // leave amount undefined, update should keep its value in the record found
         };
         file.update(record3, (err) => {
-          assert.equal(err, "update error: update value for amount has not been set.");
+          assert.ifError(err);
 
           record4 = {
             key: "F1F2F3F4",
@@ -628,8 +629,39 @@ describe(title, function() {
           };
           file.write(record4, (err) => {
             assert.equal(err, "write error: length of 'name' must be 1 or more.");
-            expect(file.close()).to.not.throw;
-            done();
+
+            file.find(record.key, (record2, err) => {
+              assert.ifError(err);
+              assert.equal(record2.name, "TEST", "correct name in record");
+              assert.equal(record2.amount, "00", "amount not updated as expected");
+              expect(file.close()).to.not.throw;
+              done();
+            });
+          });
+        });
+      });
+    });
+  });
+
+  it("update only the fields set in the record last read", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.update({ name: "NO READ" }, (err) => {
+      assert.equal(err, "update error: no record has been read or found to update.");
+
+      file.find("F1F2F3F4", (record, err) => {
+        assert.ifError(err);
+        file.update({ amount: "a1b2" }, (err) => {
+          assert.ifError(err);
+          file.find("F1F2F3F4", (record, err) => {
+            assert.ifError(err);
+            assert.equal(record.name, "TEST", "name not updated as expected");
+            assert.equal(record.amount, "a1b2", "amount updated as expected");
+            file.update({ amount: "" }, (err) => {
+              assert.ifError(err);
+              expect(file.close()).to.not.throw;
+              done();
+            });
           });
         });
       });
@@ -987,6 +1019,731 @@ describe(title, function() {
     readUntilEnd(file, done);
   });
 
+  it("aggregate count, sum, min and max over a key range, filtered and grouped", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    record = { key: "d1d2d3d4d5d6d7d1", name: "AGGR A", amount: "0000000000000010" };
+    file.write(record, (err) => {
+      assert.ifError(err);
+      record = { key: "d1d2d3d4d5d6d7d2", name: "AGGR B", amount: "0000000000000020" };
+      file.write(record, (err) => {
+        assert.ifError(err);
+        record = { key: "d1d2d3d4d5d6d7d3", name: "AGGR A", amount: "0000000000000030" };
+        file.write(record, (err) => {
+          assert.ifError(err);
+          const options = { from: "d1", to: "d1", sum: ["amount"], min: ["amount"], max: ["amount"] };
+          file.aggregate(options, (result, err) => {
+            assert.ifError(err);
+            assert.equal(result.count, 3);
+            assert.equal(result.sum.amount, 96);
+            assert.equal(result.min.amount, 16);
+            assert.equal(result.max.amount, 48);
+
+            options.groupBy = "name";
+            file.aggregate(options, (result, err) => {
+              assert.ifError(err);
+              assert.equal(result.count, 3);
+              assert.equal(result.groups["AGGR A"].count, 2);
+              assert.equal(result.groups["AGGR A"].sum.amount, 64);
+              assert.equal(result.groups["AGGR B"].count, 1);
+              assert.equal(result.groups["AGGR B"].max.amount, 32);
+
+              file.aggregate({ filter: [{ field: "name", op: "!=", value: "AGGR A" }], to: "d1", from: "d1",
+                               sum: ["amount"] }, (result, err) => {
+                assert.ifError(err);
+                assert.equal(result.count, 1);
+                assert.equal(result.sum.amount, 32);
+
+                file.aggregate({ sum: ["name"] }, (result, err) => {
+                  assert.equal(err, "aggregate error: sum field 'name' must be of type hexadecimal with maxLength 8 or less.");
+                  assert.equal(result, null);
+
+                  file.delete("d1d2d3d4d5d6d7", (count, err) => {
+                    assert.ifError(err);
+                    assert.equal(count, 3);
+                    expect(file.close()).to.not.throw;
+                    done();
+                  });
+                });
+              });
+            });
+          });
+        });
+      });
+    });
+  });
+
+  it("delete and update the records in a key range", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.write({ key: "d2d2d3d4d5d6d7d1", name: "RANGE A", amount: "0000000000000010" }, (err) => {
+      assert.ifError(err);
+      file.write({ key: "d2d2d3d4d5d6d7d2", name: "RANGE B", amount: "0000000000000020" }, (err) => {
+        assert.ifError(err);
+        file.write({ key: "d2d2d3d4d5d6d7d3", name: "RANGE A", amount: "0000000000000030" }, (err) => {
+          assert.ifError(err);
+          file.updateRange("d2", "d2", { amount: "0000000000000040" },
+                           { filter: [{ field: "name", value: "RANGE A" }] }, (count, err) => {
+            assert.ifError(err);
+            assert.equal(count, 2);
+            file.aggregate({ from: "d2", to: "d2", sum: ["amount"] }, (result, err) => {
+              assert.ifError(err);
+              assert.equal(result.sum.amount, 160);
+
+              file.updateRange("d2", "d2", { key: "d2d2d3d4d5d6d7d9" }, (count, err) => {
+                assert.equal(err, "updateRange error: key field 'key' cannot be updated.");
+                assert.equal(count, 0);
+
+                file.deleteRange("d2d2d3d4d5d6d7d2", null, { limit: 1 }, (count, err) => {
+                  assert.ifError(err);
+                  assert.equal(count, 1);
+                  file.deleteRange("d2", "d2", (count, err) => {
+                    assert.ifError(err);
+                    assert.equal(count, 2);
+                    file.deleteRange("d2", "d2", (count, err) => {
+                      assert.ifError(err);
+                      assert.equal(count, 0);
+                      expect(file.close()).to.not.throw;
+                      done();
+                    });
+                  });
+                });
+              });
+            });
+          });
+        });
+      });
+    });
+  });
+
+  it("write, find, update and delete records with the promise APIs", async function() {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    assert.equal(await file.writeAsync({ key: "d3d2d3d4d5d6d7d1", name: "PROMISE", amount: "0000000000000010" }), 1);
+    var record = await file.findAsync("d3d2d3d4d5d6d7d1");
+    assert.equal(record.name, "PROMISE");
+    assert.equal(await file.updateAsync({ amount: "0000000000000020" }), 1);
+    record = await file.findAsync(Buffer.from([0xd3, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd1]), 8);
+    assert.equal(record.amount, "0000000000000020");
+    assert.equal(await file.findAsync("d3d2d3d4d5d6d7d9"), null);
+
+    try {
+      await file.writeAsync({ key: "d3d2d3d4d5d6d7d1", name: "PROMISE" });
+      assert.fail("writeAsync of a duplicate key should be rejected");
+    } catch (err) {
+      assert.match(err.message, /^write error: an attempt was made to store a record with a duplicate key/);
+      assert.equal(err.r15, 8);
+      assert.equal(err.errno2, 0xc0500091);
+    }
+    try {
+      await file.findAsync(1);
+      assert.fail("findAsync of a number should be rejected");
+    } catch (err) {
+      assert.instanceOf(err, TypeError);
+    }
+
+    assert.equal(await file.deleteAsync("d3d2d3d4d5d6d7d1"), 1);
+    assert.equal(await file.deleteAsync("d3d2d3d4d5d6d7d1"), 0);
+    expect(file.close()).to.not.throw;
+  });
+
+  it("bulk load sorted records into an empty dataset", function(done) {
+    const loadSet = `${uid}.TEST2.VSAM.KSDS3`;
+    var file = vsam.allocSync(loadSet,
+                              JSON.parse(fs.readFileSync('test/schema.json')));
+    function* records(n, from) {
+      for (let i = 0; i < n; i++)
+        yield { key: (from + i).toString(16), name: "LOADED", amount: i.toString(16).padStart(4, "0") };
+    }
+    var nprogress = 0;
+    file.bulkLoad(records(100, 0x1000), { batchSize: 32, progress: (result) => {
+      nprogress++;
+      assert.equal(result.count, nprogress * 32);
+    }}, (result, err) => {
+      assert.ifError(err);
+      assert.equal(result.count, 100);
+      assert.equal(nprogress, 3);
+      assert.isNumber(result.recordsPerSecond);
+      assert.equal(file.findfirstSync().key, "1000");
+      assert.equal(file.findlastSync().amount, "0063");
+
+      file.bulkLoad(records(1, 0x2000), (result, err) => {
+        assert.equal(err, "bulkLoad error: VSAM dataset must be empty.");
+        assert.equal(result.count, 0);
+        assert.equal(file.deleteRangeSync(null, null), 100);
+
+        file.bulkLoad([...records(2, 0x3000), ...records(2, 0x3000)], (result, err) => {
+          assert.equal(err, "bulkLoad error: the key of record 3 is not greater than the key of the previous record.");
+          assert.equal(result.count, 2);
+          expect(file.close()).to.not.throw;
+          file.dealloc((err) => {
+            assert.ifError(err);
+            done();
+          });
+        });
+      });
+    });
+  });
+
+  it("export a key range to NDJSON, CSV and raw files", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "d4d2d3d4d5d6d7d1", name: "EXPORT \"A\"", amount: "0000000000000010" });
+    file.writeSync({ key: "d4d2d3d4d5d6d7d2", name: "EXPORT,B", amount: "0000000000000020" });
+    const path = `/tmp/vsamjs-export-${process.pid}`;
+    var progress = [];
+    file.exportTo(path, { range: { from: "d4", to: "d4" }, progress: (count) => { progress.push(count); } },
+                  (count, err) => {
+      assert.ifError(err);
+      assert.equal(count, 2);
+      assert.equal(progress[progress.length - 1], 2);
+      var lines = fs.readFileSync(path, 'utf8').split("\n");
+      assert.equal(lines.length, 3);
+      assert.deepEqual(JSON.parse(lines[0]),
+                       { key: "d4d2d3d4d5d6d7d1", name: "EXPORT \"A\"", amount: "0000000000000010" });
+      assert.equal(lines[2], "");
+
+      file.exportTo(path, { format: "csv", fields: ["name", "key"], range: { from: "d4", to: "d4" } }, (count, err) => {
+        assert.ifError(err);
+        assert.equal(count, 2);
+        assert.equal(fs.readFileSync(path, 'utf8'),
+                     'name,key\n"EXPORT ""A""",d4d2d3d4d5d6d7d1\n"EXPORT,B",d4d2d3d4d5d6d7d2\n');
+
+        file.exportTo(path, { format: "raw", range: { from: "d4d2d3d4d5d6d7d2", to: "d4" } }, (count, err) => {
+          assert.ifError(err);
+          assert.equal(count, 1);
+          const raw = fs.readFileSync(path);
+          assert.equal(raw.length, 26);
+          assert.equal(raw.slice(0, 8).toString('hex'), "d4d2d3d4d5d6d7d2");
+
+          file.exportTo(path, { format: "xml" }, (count, err) => {
+            assert.equal(err, 'exportTo error: format must be one of "ndjson", "raw" or "csv".');
+            assert.equal(count, 0);
+            fs.unlinkSync(path);
+            assert.equal(file.deleteRangeSync("d4", "d4"), 2);
+            expect(file.close()).to.not.throw;
+            done();
+          });
+        });
+      });
+    });
+  });
+
+  it("find and scan records as JSON Buffers", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "d5d2d3d4d5d6d7d1", name: "JSON \"A\"", amount: "0000000000000010" });
+    file.writeSync({ key: "d5d2d3d4d5d6d7d2", name: "JSON B", amount: "0000000000000020" });
+
+    file.findJson("d5d2d3d4d5d6d7d1", (json, err) => {
+      assert.ifError(err);
+      assert.isTrue(Buffer.isBuffer(json));
+      assert.deepEqual(JSON.parse(json.toString()),
+                       { key: "d5d2d3d4d5d6d7d1", name: "JSON \"A\"", amount: "0000000000000010" });
+
+      file.scanJson({ from: "d5", to: "d5", fields: ["name", "amount"] }, (json, err) => {
+        assert.ifError(err);
+        assert.deepEqual(JSON.parse(json.toString()),
+                         [{ name: "JSON \"A\"", amount: "0000000000000010" },
+                          { name: "JSON B", amount: "0000000000000020" }]);
+
+        file.scanJson({ from: "d5d2d3d4d5d6d7d9", to: "d5" }, (json, err) => {
+          assert.ifError(err);
+          assert.equal(json.toString(), "[]");
+
+          file.scanJson({ fields: ["gender"] }, (json, err) => {
+            assert.equal(err, "scanJson error: fields must be an array of field names of the schema.");
+            assert.isNull(json);
+            assert.equal(file.deleteRangeSync("d5", "d5"), 2);
+            expect(file.close()).to.not.throw;
+            done();
+          });
+        });
+      });
+    });
+  });
+
+  it("scan records into typed array columns", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "d6d2d3d4d5d6d7d1", name: "COLUMN A", amount: "0000000000000010" });
+    file.writeSync({ key: "d6d2d3d4d5d6d7d2", name: "COL B", amount: "0000000000000020" });
+
+    file.scanColumns({ from: "d6", to: "d6", fields: ["name", "amount"] }, (batch, err) => {
+      assert.ifError(err);
+      assert.equal(batch.length, 2);
+      assert.instanceOf(batch.columns.amount, BigUint64Array);
+      assert.deepEqual(Array.from(batch.columns.amount), [16n, 32n]);
+      const name = batch.columns.name;
+      assert.deepEqual(Array.from(name.offsets), [0, 8, 13]);
+      assert.equal(name.data.toString(), "COLUMN ACOL B");
+      assert.isUndefined(batch.columns.key);
+
+      file.scanColumns({ from: "d6d2d3d4d5d6d7d9", to: "d6" }, (batch, err) => {
+        assert.ifError(err);
+        assert.equal(batch.length, 0);
+        assert.equal(batch.columns.key.length, 0);
+        assert.deepEqual(Array.from(batch.columns.name.offsets), [0]);
+        assert.equal(file.deleteRangeSync("d6", "d6"), 2);
+        expect(file.close()).to.not.throw;
+        done();
+      });
+    });
+  });
+
+  it("scan records into a RecordBatch", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "d7d2d3d4d5d6d7d1", name: "BATCH A", amount: "0000000000000010" });
+    file.writeSync({ key: "d7d2d3d4d5d6d7d2", name: "BATCH B", amount: "0000000000000020" });
+    file.writeSync({ key: "d7d2d3d4d5d6d7d3", name: "BATCH C", amount: "0000000000000030" });
+
+    file.scanBatch({ from: "d7", to: "d7" }, (batch, err) => {
+      assert.ifError(err);
+      assert.instanceOf(batch, vsam.RecordBatch);
+      assert.equal(batch.length, 3);
+      assert.deepEqual(batch.getRow(1),
+                       { key: "d7d2d3d4d5d6d7d2", name: "BATCH B", amount: "0000000000000020" });
+      assert.equal(batch.getField(2, "name"), "BATCH C");
+      assert.deepEqual([...batch.keys()],
+                       ["d7d2d3d4d5d6d7d1", "d7d2d3d4d5d6d7d2", "d7d2d3d4d5d6d7d3"]);
+      expect(() => {
+        batch.getRow(3);
+      }).to.throw(/getRow error: index must be an integer from 0 to length - 1./);
+      expect(() => {
+        batch.getField(0, "gender");
+      }).to.throw(/getField error: 'gender' is not a field of the schema./);
+
+      assert.equal(file.deleteRangeSync("d7", "d7"), 3);
+      expect(file.close()).to.not.throw;
+      assert.equal(batch.getKey(0), "d7d2d3d4d5d6d7d1");
+      done();
+    });
+  });
+
+  it("snapshot a dataset to a file and search it with openSnapshot()", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "d8d2d3d4d5d6d7d1", name: "SNAP A", amount: "0000000000000010" });
+    file.writeSync({ key: "d8d2d3d4d5d6d7d3", name: "SNAP C", amount: "0000000000000030" });
+    const path = `/tmp/vsam.js.${process.pid}.snapshot`;
+
+    file.snapshotTo(path, (count, err) => {
+      assert.ifError(err);
+      assert.isAtLeast(count, 2);
+      assert.equal(file.deleteRangeSync("d8", "d8"), 2);
+      expect(file.close()).to.not.throw;
+
+      var snapshot = vsam.openSnapshot(path, JSON.parse(fs.readFileSync('test/schema.json')));
+      assert.equal(snapshot.length, count);
+      assert.deepEqual(snapshot.find("d8d2d3d4d5d6d7d1"),
+                       { key: "d8d2d3d4d5d6d7d1", name: "SNAP A", amount: "0000000000000010" });
+      assert.isNull(snapshot.find("d8d2d3d4d5d6d7d2"));
+      assert.equal(snapshot.findge("d8d2d3d4d5d6d7d2").name, "SNAP C");
+      assert.equal(snapshot.find(Buffer.from([0xd8, 0xd2])).name, "SNAP A");
+      var batch = snapshot.scan({ from: "d8", to: "d8", filter: [{ field: "name", value: "SNAP C" }] });
+      assert.equal(batch.length, 1);
+      assert.equal(batch.getKey(0), "d8d2d3d4d5d6d7d3");
+      snapshot.close();
+      expect(() => {
+        snapshot.find("d8");
+      }).to.throw(/find error: snapshot is not open./);
+
+      const schema = JSON.parse(fs.readFileSync('test/schema.json'));
+      schema.name.maxLength = 11;
+      expect(() => {
+        vsam.openSnapshot(path, schema);
+      }).to.throw(`openSnapshot error: ${path} is not a snapshot with the layout of the schema.`);
+      fs.unlinkSync(path);
+      done();
+    });
+  });
+
+  it("find all the records matching a key in one call", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "d9d2d3d4d5d6d7d1", name: "ALL A", amount: "0000000000000010" });
+    file.writeSync({ key: "d9d2d3d4d5d6d7d2", name: "ALL B", amount: "0000000000000020" });
+
+    file.findAll("d9d2", (records, err) => {
+      assert.ifError(err);
+      assert.equal(records.length, 2);
+      assert.deepEqual(records[1],
+                       { key: "d9d2d3d4d5d6d7d2", name: "ALL B", amount: "0000000000000020" });
+      file.findAll("d9d3", (records, err) => {
+        assert.ifError(err);
+        assert.deepEqual(records, []);
+        assert.equal(file.deleteRangeSync("d9", "d9"), 2);
+        expect(file.close()).to.not.throw;
+        done();
+      });
+    });
+  });
+
+  it("find records by an indexed field", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "dad2d3d4d5d6d7d1", name: "IDX A", amount: "0000000000000010" });
+    file.writeSync({ key: "dad2d3d4d5d6d7d2", name: "IDX B", amount: "0000000000000020" });
+
+    file.buildIndex("name", (stats, err) => {
+      assert.ifError(err);
+      assert.isAbove(stats.count, 1);
+      assert.isAbove(stats.values, 1);
+      file.findBy("name", "IDX B", (records, err) => {
+        assert.ifError(err);
+        assert.deepEqual(records,
+                         [{ key: "dad2d3d4d5d6d7d2", name: "IDX B", amount: "0000000000000020" }]);
+        file.findBy("amount", "20", (records, err) => {
+          assert.isNull(records);
+          assert.equal(err, "findBy error: no index on field 'amount', buildIndex() must be called first.");
+          assert.equal(file.deleteRangeSync("da", "da"), 2);
+          expect(file.close()).to.not.throw;
+          done();
+        });
+      });
+    });
+  });
+
+  it("write records behind and report the failures by key on flush", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "dbd2d3d4d5d6d7d3", name: "DUP", amount: "0000000000000030" });
+    file.setWriteBehind({ batchSize: 2 });
+    file.write({ key: "dbd2d3d4d5d6d7d1", name: "WB A", amount: "0000000000000010" });
+    file.write({ key: "dbd2d3d4d5d6d7d1", name: "WB A2", amount: "0000000000000011" }, (err) => {
+      assert.ifError(err);
+    });
+    file.write({ key: "dbd2d3d4d5d6d7d2", name: "WB B", amount: "0000000000000020" });
+    file.write({ key: "dbd2d3d4d5d6d7d3", name: "WB C", amount: "0000000000000030" });
+    expect(() => {
+      file.close();
+    }).to.throw(/close error: write-behind records must be flushed first./);
+
+    file.flush((failures, err) => {
+      assert.ifError(err);
+      assert.equal(failures.length, 1);
+      assert.equal(failures[0].key, "dbd2d3d4d5d6d7d3");
+      assert.match(failures[0].error, /write error/);
+      assert.equal(file.findSync("dbd2d3d4d5d6d7d1").name, "WB A2");
+      assert.equal(file.findSync("dbd2d3d4d5d6d7d2").name, "WB B");
+      assert.equal(file.findSync("dbd2d3d4d5d6d7d3").name, "DUP");
+      file.flush((failures, err) => {
+        assert.ifError(err);
+        assert.deepEqual(failures, []);
+        file.setWriteBehind(false);
+        assert.equal(file.deleteRangeSync("db", "db"), 3);
+        expect(file.close()).to.not.throw;
+        done();
+      });
+    });
+  });
+
+  it("update staged records in place, and call back after write() returns", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.setWriteBehind({ batchSize: 8 });
+    var written = false;
+    file.write({ key: "e7d2d3d4d5d6d7d1", name: "WB A", amount: "0000000000000010" }, (err) => {
+      assert.ifError(err);
+      assert.isTrue(written);
+    });
+    written = true;
+    file.update("e7d2d3d4d5d6d7d1", { amount: "0000000000000011" }, (count, err) => {
+      assert.ifError(err);
+      assert.equal(count, 1);
+      file.flush((failures, err) => {
+        assert.ifError(err);
+        assert.deepEqual(failures, []);
+        var record = file.findSync("e7d2d3d4d5d6d7d1");
+        assert.equal(record.name, "WB A");
+        assert.equal(record.amount, "0000000000000011");
+        file.setWriteBehind(false);
+        assert.equal(file.deleteRangeSync("e7", "e7"), 1);
+        expect(file.close()).to.not.throw;
+        done();
+      });
+    });
+  });
+
+  it("see the staged records in the calls made after write()", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.setWriteBehind({ batchSize: 8 });
+    file.write({ key: "ecd2d3d4d5d6d7d1", name: "WB A", amount: "0000000000000010" });
+    file.delete("ecd2d3d4d5d6d7d1", (count, err) => {
+      assert.ifError(err);
+      assert.equal(count, 1);
+    });
+    file.write({ key: "ecd2d3d4d5d6d7d2", name: "WB B", amount: "0000000000000020" });
+    file.find("ecd2d3d4d5d6d7d2", (record, err) => {
+      assert.ifError(err);
+      assert.equal(record.name, "WB B");
+      file.flush((failures, err) => {
+        assert.ifError(err);
+        assert.deepEqual(failures, []);
+        assert.isNull(file.findSync("ecd2d3d4d5d6d7d1"));
+        assert.equal(file.findSync("ecd2d3d4d5d6d7d2").name, "WB B");
+        file.setWriteBehind(false);
+        assert.equal(file.deleteRangeSync("ec", "ec"), 1);
+        expect(file.close()).to.not.throw;
+        done();
+      });
+    });
+  });
+
+  it("run several operations in one call, past an error", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.exec([
+      { op: "write", record: { key: "dcd2d3d4d5d6d7d1", name: "EXEC A", amount: "0000000000000010" } },
+      { op: "update", key: "dcd2d3d4d5d6d7d9", record: { name: "NONE" } },
+      { op: "find", key: "dcd2d3d4d5d6d7d1" },
+    ], { stopOnError: false }, (results, err) => {
+      assert.equal(err, "exec error: operation 2: no record found with the key for update");
+      assert.equal(results.length, 3);
+      assert.equal(results[0], 1);
+      assert.isNull(results[1]);
+      assert.equal(results[2].name, "EXEC A");
+      assert.equal(file.deleteRangeSync("dc", "dc"), 1);
+      expect(file.close()).to.not.throw;
+      done();
+    });
+  });
+
+  it("share the result of identical finds in flight", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "ddd2d3d4d5d6d7d1", name: "HOT KEY", amount: "0000000000000010" });
+    var records = [];
+    const onRecord = (record, err) => {
+      assert.ifError(err);
+      records.push(record);
+      if (records.length < 3)
+        return;
+      assert.deepEqual(records[1], records[0]);
+      assert.deepEqual(records[2], records[0]);
+      assert.notStrictEqual(records[1], records[0]);
+      assert.equal(records[0].name, "HOT KEY");
+      file.findeq("ddd2d3d4d5d6d7d2", (record, err) => {
+        assert.isNull(record);
+        assert.equal(file.deleteRangeSync("dd", "dd"), 1);
+        expect(file.close()).to.not.throw;
+        done();
+      });
+    };
+    file.find("ddd2d3d4d5d6d7d1", onRecord);
+    file.findeq("ddd2d3d4d5d6d7d1", onRecord);
+    file.find(Buffer.from([0xdd, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd1]), 8, onRecord);
+  });
+
+  it("not share a find in flight with a find issued after a write", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.find("e8d2d3d4d5d6d7d1", (record, err) => {
+      assert.ifError(err);
+    });
+    file.writeSync({ key: "e8d2d3d4d5d6d7d1", name: "AFTER FIND", amount: "0000000000000010" });
+    file.find("e8d2d3d4d5d6d7d1", (record, err) => {
+      assert.ifError(err);
+      assert.equal(record.name, "AFTER FIND");
+      assert.equal(file.deleteRangeSync("e8", "e8"), 1);
+      expect(file.close()).to.not.throw;
+      done();
+    });
+  });
+
+  it("drop a request past its deadline, and serve a higher class first", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    const key = (i) => "e9d2d3d4d5d6" + ("0" + i.toString(16)).slice(-2) + "d1";
+    for (var i = 0; i < 256; i++)
+      file.writeSync({ key: key(i), name: "QUEUE", amount: "0000000000000010" });
+    expect(() => {
+      file.find(key(0), (record, err) => {}, { priority: "urgent" });
+    }).to.throw(/find error: priority must be either interactive or batch./);
+    file.setMaxInFlight(1, { onFull: "wait" });
+    file.find(key(0), (record, err) => {
+      assert.ifError(err);
+    });
+    file.find(key(1), (record, err) => {
+      assert.isNull(record);
+      assert.match(err, /^timeout error: the deadline passed after waiting/);
+      file.setMaxInFlight(0);
+      var order = [];
+      const onDone = (name) => (result, err) => {
+        assert.ifError(err);
+        order.push(name);
+        if (order.length < 3)
+          return;
+        assert.isBelow(order.indexOf("interactive"), order.indexOf("batch"));
+        assert.equal(file.deleteRangeSync("e9", "e9"), 256);
+        expect(file.close()).to.not.throw;
+        done();
+      };
+      // the finds are queued while the scan runs, the batch one first
+      file.scanJson({ from: "e9", to: "e9" }, onDone("scan"));
+      file.find(key(2), onDone("batch"), { priority: "batch" });
+      file.find(key(3), onDone("interactive"), { priority: "interactive" });
+    }, { deadline: 5 });
+    // the second find waits for the first past its deadline
+    const end = Date.now() + 50;
+    while (Date.now() < end);
+  });
+
+  it("not share a find with a deadline with an identical find", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "edd2d3d4d5d6d7d1", name: "SHARE A", amount: "0000000000000010" });
+    file.writeSync({ key: "edd2d3d4d5d6d7d2", name: "SHARE B", amount: "0000000000000020" });
+    file.setMaxInFlight(1, { onFull: "wait" });
+    file.find("edd2d3d4d5d6d7d1", (record, err) => {
+      assert.ifError(err);
+    });
+    var timedOut = false;
+    file.find("edd2d3d4d5d6d7d2", (record, err) => {
+      assert.isNull(record);
+      assert.match(err, /^timeout error: the deadline passed after waiting/);
+      timedOut = true;
+    }, { deadline: 5 });
+    file.find("edd2d3d4d5d6d7d2", (record, err) => {
+      assert.ifError(err);
+      assert.equal(record.name, "SHARE B");
+      assert.isTrue(timedOut);
+      file.setMaxInFlight(0);
+      assert.equal(file.deleteRangeSync("ed", "ed"), 2);
+      expect(file.close()).to.not.throw;
+      done();
+    });
+    // the find with the deadline waits past it
+    const end = Date.now() + 50;
+    while (Date.now() < end);
+  });
+
+  it("fail as busy or wait over the maximum in flight", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "dfd2d3d4d5d6d7d1", name: "LIMIT A", amount: "0000000000000010" });
+    file.writeSync({ key: "dfd2d3d4d5d6d7d2", name: "LIMIT B", amount: "0000000000000020" });
+    file.setMaxInFlight(1);
+    file.find("dfd2d3d4d5d6d7d1", (record, err) => {
+      assert.ifError(err);
+      assert.equal(record.name, "LIMIT A");
+      file.setMaxInFlight(1, { onFull: "wait" });
+      var names = [];
+      const onRecord = (record, err) => {
+        assert.ifError(err);
+        names.push(record.name);
+        if (names.length < 2)
+          return;
+        assert.deepEqual(names, ["LIMIT A", "LIMIT B"]);
+        assert.equal(file.queueStats().inFlight, 0);
+        file.setMaxInFlight(0);
+        assert.equal(file.deleteRangeSync("df", "df"), 2);
+        expect(file.close()).to.not.throw;
+        done();
+      };
+      file.find("dfd2d3d4d5d6d7d1", onRecord);
+      file.find("dfd2d3d4d5d6d7d2", onRecord);
+      var stats = file.queueStats();
+      assert.equal(stats.inFlight, 1);
+      assert.equal(stats.waiting, 1);
+    });
+    var issued = false;
+    file.find("dfd2d3d4d5d6d7d2", (record, err) => {
+      assert.isTrue(issued);
+      assert.isNull(record);
+      assert.match(err, /^busy error: 1 requests are in flight on the dataset/);
+    });
+    issued = true;
+  });
+
+  it("cancel a request with a signal before it's started", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "e0d2d3d4d5d6d7d1", name: "CANCEL A", amount: "0000000000000010" });
+    file.setMaxInFlight(1, { onFull: "wait" });
+    var cancelled = null;
+    file.find("e0d2d3d4d5d6d7d1", (record, err) => {
+      assert.ifError(err);
+      assert.equal(record.name, "CANCEL A");
+      assert.match(cancelled, /^cancel error: the request was aborted/);
+      file.setMaxInFlight(0);
+      file.findAsync("e0d2d3d4d5d6d7d1", { timeout: 60000 }).then((record) => {
+        assert.equal(record.name, "CANCEL A");
+        assert.equal(file.deleteRangeSync("e0", "e0"), 1);
+        expect(file.close()).to.not.throw;
+        done();
+      }, done);
+    });
+    const controller = new AbortController();
+    file.find("e0d2d3d4d5d6d7d1", (record, err) => {
+      assert.isNull(record);
+      cancelled = err;
+    }, { signal: controller.signal });
+    assert.equal(file.queueStats().waiting, 1);
+    controller.abort();
+    assert.equal(file.queueStats().waiting, 0);
+  });
+
+  it("cancel a range delete with a signal while it runs", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    const key = (i) => "ead2d3d4d5" + ("000" + i.toString(16)).slice(-4) + "d1";
+    const n = 4096;
+    for (var i = 0; i < n; i++)
+      file.writeSync({ key: key(i), name: "CANCEL", amount: "0000000000000010" });
+    const controller = new AbortController();
+    file.deleteRange("ea", "ea", (count, err) => {
+      assert.match(err, /^cancel error: the request was aborted/);
+      assert.isBelow(count, n);
+      assert.equal(file.deleteRangeSync("ea", "ea"), n - count);
+      expect(file.close()).to.not.throw;
+      done();
+    }, { signal: controller.signal });
+    // aborted while the records are deleted, which stops at the next one
+    const end = Date.now() + 10;
+    while (Date.now() < end);
+    controller.abort();
+  });
+
+  it("not take a record with signal or timeout fields for the options", async function() {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "ebd2d3d4d5d6d7d1", name: "OPTIONS", amount: "0000000000000010" });
+    // taken as { timeout }, it would leave updateAsync() without a record
+    assert.isAtMost(await file.updateAsync("ebd2d3d4d5d6d7d1", { timeout: "5" }), 1);
+    assert.equal(await file.updateAsync("ebd2d3d4d5d6d7d1", { name: "UPDATED" }, { timeout: 60000 }), 1);
+    assert.equal(file.findSync("ebd2d3d4d5d6d7d1").name, "UPDATED");
+    assert.equal(file.deleteRangeSync("eb", "eb"), 1);
+    expect(file.close()).to.not.throw;
+  });
+
+  it("open and close asynchronously, and open many datasets", async function() {
+    const schema = JSON.parse(fs.readFileSync('test/schema.json'));
+    var file = await vsam.openAsync(testSet, schema);
+    assert.equal(await file.writeAsync({ key: "e1d2d3d4d5d6d7d1", name: "OPENASYNC", amount: "0000000000000010" }), 1);
+    assert.equal((await file.findAsync("e1d2d3d4d5d6d7d1")).name, "OPENASYNC");
+    assert.equal(await file.deleteAsync("e1d2d3d4d5d6d7d1"), 1);
+    await file.closeAsync();
+    try {
+      await file.closeAsync();
+      assert.fail("closeAsync of a closed dataset should be rejected");
+    } catch (err) {
+      assert.match(err.message, /^closeAsync error: VSAM dataset is not open./);
+    }
+    try {
+      await vsam.openMany([{ path: testSet, schema: schema },
+                           { path: "A9y8o2.X", schema: schema }]);
+      assert.fail("openMany of a dataset that doesn't exist should be rejected");
+    } catch (err) {
+      assert.match(err.message, /^open error: fopen\(\) failed/);
+    }
+    var files = await vsam.openMany([{ path: testSet, schema: schema }]);
+    assert.equal(files.length, 1);
+    await files[0].closeAsync();
+  });
+
   it("deallocate a dataset", function(done) {
     var file = vsam.openSync(testSet,
                              JSON.parse(fs.readFileSync('test/schema.json')));
@@ -7,6 +7,7 @@
 /* This is similar to test/ksds2.js, except here only *Sync APIs are used */
 
 const vsam = require("../build/Release/vsam.js.node");
+require("../index.js"); // adds the functions implemented in JavaScript
 const fs = require('fs');
 const expect = require('chai').expect;
 const should = require('chai').should;
@@ -551,11 +552,13 @@ describe(title, function() {
     var record3 = {
       key: "F1F2F3F4",
       name: "TEST"
-      // leave amount undefined, update should fail
+      // leave amount undefined, update should keep its value in the record found
     };
-    expect(() => {
-      count = file.updateSync(record3);
-    }).to.throw(/updateSync error: update value for amount has not been set./);
+    count = file.updateSync(record3);
+    assert.equal(count, 1);
+    record2 = file.findSync(record.key);
+    assert.equal(record2.name, "TEST", "correct name in record");
+    assert.equal(record2.amount, "00", "amount not updated as expected");
 
     var record4 = {
       key: "F1F2F3F4",
@@ -570,6 +573,28 @@ describe(title, function() {
     done();
   });
 
+  it("update only the fields set in the record last read", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    expect(() => {
+      file.updateSync({ name: "NO READ" });
+    }).to.throw(/updateSync error: no record has been read or found to update./);
+
+    var record = file.findSync("F1F2F3F4");
+    expect(record).to.not.be.null;
+    assert.equal(file.updateSync({ amount: "a1b2" }), 1);
+    record = file.findSync("F1F2F3F4");
+    assert.equal(record.name, "TEST", "name not updated as expected");
+    assert.equal(record.amount, "a1b2", "amount updated as expected");
+    assert.equal(file.updateSync({ amount: "" }), 1);
+
+    expect(() => {
+      file.updateSync({ name: "" });
+    }).to.throw(/updateSync error: length of 'name' must be 1 or more./);
+    expect(file.close()).to.not.throw;
+    done();
+  });
+
   it("find and update in one call, also verify no record found case", function(done) {
     var file = vsam.openSync(testSet,
                              JSON.parse(fs.readFileSync('test/schema.json')));
@@ -1021,6 +1046,440 @@ describe(title, function() {
     readUntilEnd(file, done);
   });
 
+  it("aggregate count, sum, min and max over a key range, filtered and grouped", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "d1d2d3d4d5d6d7d1", name: "AGGR A", amount: "0000000000000010" });
+    file.writeSync({ key: "d1d2d3d4d5d6d7d2", name: "AGGR B", amount: "0000000000000020" });
+    file.writeSync({ key: "d1d2d3d4d5d6d7d3", name: "AGGR A", amount: "0000000000000030" });
+
+    const options = { from: "d1", to: "d1", sum: ["amount"], min: ["amount"], max: ["amount"] };
+    var result = file.aggregateSync(options);
+    assert.equal(result.count, 3);
+    assert.equal(result.sum.amount, 96);
+    assert.equal(result.min.amount, 16);
+    assert.equal(result.max.amount, 48);
+
+    options.groupBy = "name";
+    result = file.aggregateSync(options);
+    assert.equal(result.count, 3);
+    assert.equal(result.groups["AGGR A"].count, 2);
+    assert.equal(result.groups["AGGR A"].min.amount, 16);
+    assert.equal(result.groups["AGGR B"].sum.amount, 32);
+
+    result = file.aggregateSync({ from: "d1d2d3d4d5d6d7d9", to: "d1", sum: ["amount"], min: ["amount"] });
+    assert.equal(result.count, 0);
+    assert.equal(result.sum.amount, 0);
+    assert.equal(result.min.amount, null);
+
+    // an 8-byte field is aggregated exactly, as a BigInt
+    file.writeSync({ key: "d1d2d3d4d5d6d7d4", name: "AGGR C", amount: "ffffffffffffffff" });
+    file.writeSync({ key: "d1d2d3d4d5d6d7d5", name: "AGGR C", amount: "ffffffffffffffff" });
+    result = file.aggregateSync({ from: "d1d2d3d4d5d6d7d4", to: "d1", sum: ["amount"], max: ["amount"] });
+    assert.strictEqual(result.max.amount, 0xffffffffffffffffn);
+    assert.strictEqual(result.sum.amount, 0x1fffffffffffffffen);
+    assert.equal(file.deleteRangeSync("d1d2d3d4d5d6d7d4", "d1"), 2);
+
+    expect(() => {
+      file.aggregateSync({ groupBy: "gender" });
+    }).to.throw(/aggregateSync error: groupBy must name a field of the schema./);
+
+    assert.equal(file.deleteSync("d1d2d3d4d5d6d7"), 3);
+    expect(file.close()).to.not.throw;
+    done();
+  });
+
+  it("delete and update the records in a key range", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "d2d2d3d4d5d6d7d1", name: "RANGE A", amount: "0000000000000010" });
+    file.writeSync({ key: "d2d2d3d4d5d6d7d2", name: "RANGE B", amount: "0000000000000020" });
+    file.writeSync({ key: "d2d2d3d4d5d6d7d3", name: "RANGE A", amount: "0000000000000030" });
+
+    assert.equal(file.updateRangeSync("d2", "d2", { name: "RANGE C" }), 3);
+    var result = file.aggregateSync({ from: "d2", to: "d2", groupBy: "name" });
+    assert.equal(result.groups["RANGE C"].count, 3);
+
+    expect(() => {
+      file.updateRangeSync("d2", "d2", {});
+    }).to.throw(/updateRangeSync error: no field to update is set./);
+
+    assert.equal(file.deleteRangeSync("d2", "d2",
+                 { filter: [{ field: "amount", op: ">=", value: "0000000000000020" }] }), 2);
+    assert.equal(file.deleteRangeSync(Buffer.from([0xd2]), "d2"), 1);
+    assert.equal(file.deleteRangeSync("d2", "d2"), 0);
+    expect(file.close()).to.not.throw;
+    done();
+  });
+
+  it("find and scan records as JSON Buffers", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "d5d2d3d4d5d6d7d1", name: "JSON A", amount: "0000000000000010" });
+    file.writeSync({ key: "d5d2d3d4d5d6d7d2", name: "JSON B", amount: "0000000000000020" });
+
+    var json = file.findJsonSync("d5d2d3d4d5d6d7d2");
+    assert.deepEqual(JSON.parse(json.toString()),
+                     { key: "d5d2d3d4d5d6d7d2", name: "JSON B", amount: "0000000000000020" });
+    assert.isNull(file.findJsonSync("d5d2d3d4d5d6d7d9"));
+
+    json = file.scanJsonSync({ from: "d5", to: "d5", limit: 1, fields: ["key"] });
+    assert.deepEqual(JSON.parse(json.toString()), [{ key: "d5d2d3d4d5d6d7d1" }]);
+
+    expect(() => {
+      file.scanJsonSync({ fields: [] });
+    }).to.throw(/scanJsonSync error: fields must be a non-empty array of field names./);
+
+    assert.equal(file.deleteRangeSync("d5", "d5"), 2);
+    expect(file.close()).to.not.throw;
+
+    // the name is written as bytes, with one that isn't valid UTF-8, and read
+    // as a string field whose name has a quote
+    var schema = JSON.parse(fs.readFileSync('test/schema.json'));
+    file = vsam.openSync(testSet, { key: schema.key,
+                                    raw: { type: "hexadecimal", maxLength: 10 },
+                                    amount: schema.amount });
+    file.writeSync({ key: "d5d2d3d4d5d6d7d3", raw: "41ff42", amount: "0000000000000030" });
+    expect(file.close()).to.not.throw;
+    file = vsam.openSync(testSet, { key: schema.key, 'na"me': schema.name,
+                                    amount: schema.amount });
+    json = file.findJsonSync("d5d2d3d4d5d6d7d3");
+    assert.deepEqual(JSON.parse(json.toString()),
+                     { key: "d5d2d3d4d5d6d7d3", 'na"me': "A\ufffdB", amount: "0000000000000030" });
+    assert.equal(file.deleteRangeSync("d5", "d5"), 1);
+    expect(file.close()).to.not.throw;
+    done();
+  });
+
+  it("scan records into typed array columns", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "d6d2d3d4d5d6d7d1", name: "COLUMN A", amount: "0000000000000010" });
+    file.writeSync({ key: "d6d2d3d4d5d6d7d2", name: "COL B", amount: "0000000000000020" });
+
+    var batch = file.scanColumnsSync({ from: "d6", to: "d6",
+                                       filter: [{ field: "name", value: "COL B" }] });
+    assert.equal(batch.length, 1);
+    assert.deepEqual(Array.from(batch.columns.key), [0xd6d2d3d4d5d6d7d2n]);
+    assert.equal(batch.columns.name.data.toString(), "COL B");
+
+    expect(() => {
+      file.scanColumnsSync({ fields: "amount" });
+    }).to.throw(/scanColumnsSync error: fields must be a non-empty array of field names./);
+
+    assert.equal(file.deleteRangeSync("d6", "d6"), 2);
+    expect(file.close()).to.not.throw;
+    done();
+  });
+
+  it("scan records into a RecordBatch", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "d7d2d3d4d5d6d7d1", name: "BATCH A", amount: "0000000000000010" });
+    file.writeSync({ key: "d7d2d3d4d5d6d7d2", name: "BATCH B", amount: "0000000000000020" });
+
+    var batch = file.scanBatchSync({ from: "d7", to: "d7", limit: 1 });
+    assert.equal(batch.length, 1);
+    assert.equal(batch.getField(0, "amount"), "0000000000000010");
+    assert.equal(file.scanBatchSync({ from: "d7d2d3d4d5d6d7d9", to: "d7" }).length, 0);
+
+    expect(() => {
+      file.scanBatchSync({ limit: -1 });
+    }).to.throw(/scanBatchSync error: limit must be a number greater than or equal to 0./);
+
+    assert.equal(file.deleteRangeSync("d7", "d7"), 2);
+    expect(file.close()).to.not.throw;
+    done();
+  });
+
+  it("find all the records matching a key, and reject an alternateKey on a base cluster", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "d9d2d3d4d5d6d7d1", name: "ALL A", amount: "0000000000000010" });
+    file.writeSync({ key: "d9d2d3d4d5d6d7d2", name: "ALL B", amount: "0000000000000020" });
+    file.writeSync({ key: "d9d3d3d4d5d6d7d1", name: "ALL C", amount: "0000000000000030" });
+
+    var records = file.findAllSync("d9d2");
+    assert.deepEqual(records.map((r) => r.name), ["ALL A", "ALL B"]);
+    assert.deepEqual(file.findAllSync(Buffer.from([0xd9, 0xd3]), 2).map((r) => r.key),
+                     ["d9d3d3d4d5d6d7d1"]);
+    assert.deepEqual(file.findAllSync("d9d4"), []);
+    assert.equal(file.deleteRangeSync("d9", "d9"), 3);
+    expect(file.close()).to.not.throw;
+
+    const schema = JSON.parse(fs.readFileSync('test/schema.json'));
+    schema.name.alternateKey = true;
+    expect(() => {
+      vsam.openSync(testSet, schema);
+    }).to.throw(`open error: ${testSet} is not an alternate index path, but the schema has an alternateKey.`);
+    expect(() => {
+      vsam.allocSync(testSet + "X", schema);
+    }).to.throw(/allocSync error in JSON: alternateKey can only be used to open an alternate index path./);
+    schema.amount.alternateKey = true;
+    expect(() => {
+      vsam.openSync(testSet, schema);
+    }).to.throw(/openSync error in JSON \(item 3\): only one field can be the alternateKey./);
+    done();
+  });
+
+  it("find records by an indexed field, kept up to date by writes and deletes", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "dad2d3d4d5d6d7d1", name: "IDX A", amount: "0000000000000010" });
+    file.writeSync({ key: "dad2d3d4d5d6d7d2", name: "IDX A", amount: "0000000000000020" });
+    assert.isNull(file.indexStats("name"));
+    expect(() => {
+      file.findBySync("name", "IDX A");
+    }).to.throw(/findBy error: no index on field 'name', buildIndex\(\) must be called first./);
+
+    var stats = file.buildIndexSync("name");
+    assert.isAbove(stats.count, 1);
+    assert.isAbove(stats.memoryUsage, 0);
+    assert.deepEqual(file.findBySync("name", "IDX A").map((r) => r.key),
+                     ["dad2d3d4d5d6d7d1", "dad2d3d4d5d6d7d2"]);
+    assert.deepEqual(file.findBySync("name", "IDX B"), []);
+
+    file.writeSync({ key: "dad2d3d4d5d6d7d3", name: "IDX B", amount: "0000000000000030" });
+    assert.equal(file.indexStats("name").count, stats.count + 1);
+    assert.deepEqual(file.findBySync("name", "IDX B").map((r) => r.amount),
+                     ["0000000000000030"]);
+    file.findSync("dad2d3d4d5d6d7d1");
+    file.updateSync({ key: "dad2d3d4d5d6d7d1", name: "IDX B", amount: "0000000000000010" });
+    assert.equal(file.findBySync("name", "IDX A").length, 1);
+    assert.equal(file.findBySync("name", "IDX B").length, 2);
+
+    assert.equal(file.deleteRangeSync("da", "da"), 3);
+    assert.deepEqual(file.findBySync("name", "IDX B"), []);
+    assert.equal(file.indexStats("name").count, stats.count - 2);
+    assert.equal(file.indexStats("name").values, stats.values - 1);
+    expect(() => {
+      file.buildIndexSync("nosuchfield");
+    }).to.throw(/buildIndexSync error: 'nosuchfield' is not a field of the schema./);
+    expect(file.close()).to.not.throw;
+    done();
+  });
+
+  it("run several operations in one call", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "dcd2d3d4d5d6d7d1", name: "EXEC A", amount: "0000000000000010" });
+    file.writeSync({ key: "dcd2d3d4d5d6d7d3", name: "EXEC C", amount: "0000000000000030" });
+
+    var results = file.execSync([
+      { op: "find", key: "dcd2d3d4d5d6d7d1" },
+      { op: "update", key: "dcd2d3d4d5d6d7d1", record: { amount: "0000000000000011" } },
+      { op: "write", record: { key: "dcd2d3d4d5d6d7d2", name: "EXEC B", amount: "0000000000000020" } },
+      { op: "delete", key: "dcd2d3d4d5d6d7d3" },
+      { op: "find", key: "dcd2d3d4d5d6d7d3" },
+    ]);
+    assert.equal(results.length, 5);
+    assert.equal(results[0].name, "EXEC A");
+    assert.deepEqual(results.slice(1), [1, 1, 1, null]);
+    assert.equal(file.findSync("dcd2d3d4d5d6d7d1").amount, "0000000000000011");
+
+    expect(() => {
+      file.execSync([{ op: "write", record: { key: "dcd2d3d4d5d6d7d2", name: "DUP", amount: "0000000000000020" } },
+                     { op: "delete", key: "dcd2d3d4d5d6d7d2" }]);
+    }).to.throw(/execSync error: operation 1: write error/);
+    assert.equal(file.findSync("dcd2d3d4d5d6d7d2").name, "EXEC B");
+    try {
+      file.execSync([{ op: "write", record: { key: "dcd2d3d4d5d6d7d2", name: "DUP", amount: "0000000000000020" } },
+                     { op: "find", key: "dcd2d3d4d5d6d7d2" }],
+                    { stopOnError: false });
+      assert.fail("execSync with a failed operation should throw");
+    } catch (err) {
+      assert.match(err.message, /^execSync error: operation 1: write error/);
+      assert.equal(err.results.length, 2);
+      assert.isNull(err.results[0]);
+      assert.equal(err.results[1].name, "EXEC B");
+    }
+    expect(() => {
+      file.execSync([{ op: "find", key: "dc" }, { op: "read" }]);
+    }).to.throw(/execSync error: operation 2 must be an object with op one of find, write, update or delete./);
+
+    assert.equal(file.deleteRangeSync("dc", "dc"), 2);
+    expect(file.close()).to.not.throw;
+    done();
+  });
+
+  it("report the time in queue per class, and validate deadlines", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    var before = file.queueStats();
+    file.writeSync({ key: "ded2d3d4d5d6d7d1", name: "QUEUE", amount: "0000000000000010" });
+    file.scanBatchSync({ from: "de", to: "de" });
+    var stats = file.queueStats();
+    assert.equal(stats.interactive.count, before.interactive.count + 1);
+    assert.equal(stats.batch.count, before.batch.count + 1);
+    assert.isAtLeast(stats.batch.maxWait, stats.batch.meanWait);
+    assert.equal(stats.batch.expired, 0);
+
+    file.setDeadline(60000);
+    assert.equal(file.execSync([{ op: "find", key: "ded2d3d4d5d6d7d1" }],
+                               { priority: "batch", deadline: 1000 })[0].name, "QUEUE");
+    file.setDeadline(0);
+    expect(() => {
+      file.setDeadline(-1);
+    }).to.throw(/setDeadline error: deadline must be a number of milliseconds./);
+    expect(() => {
+      file.execSync([], { priority: "urgent" });
+    }).to.throw(/execSync error: priority must be either interactive or batch./);
+    assert.equal(file.deleteRangeSync("de", "de"), 1);
+    expect(file.close()).to.not.throw;
+    done();
+  });
+
+  it("open datasets with a compiled schema", function(done) {
+    var schema = vsam.compileSchema(JSON.parse(fs.readFileSync('test/schema.json')));
+    assert.equal(schema.key, "key");
+    assert.equal(schema.recordLength, 26);
+    assert.deepEqual(schema.fields[1], { name: "name", type: "string", offset: 8, minLength: 1, maxLength: 10 });
+    schema.fields[1].maxLength = 1; // a copy, the schema doesn't change
+    assert.equal(schema.fields[1].maxLength, 10);
+
+    var file = vsam.openSync(testSet, schema);
+    file.writeSync({ key: "e2d2d3d4d5d6d7d1", name: "COMPILED", amount: "0000000000000010" });
+    expect(file.close()).to.not.throw;
+    file = vsam.openSync(testSet, schema);
+    assert.equal(file.findSync("e2d2d3d4d5d6d7d1").name, "COMPILED");
+    assert.equal(file.deleteRangeSync("e2", "e2"), 1);
+    expect(file.close()).to.not.throw;
+    expect(() => {
+      vsam.compileSchema(schema);
+    }).to.throw(/compileSchema error: compileSchema\(\) expects argument: schema JSON object./);
+    expect(() => {
+      vsam.compileSchema({ key: { type: "string" } });
+    }).to.throw(/compileSchema error in JSON \(item 1\): maxLength must be specified./);
+    done();
+  });
+
+  it("page through a dataset with two independent cursors", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    for (var i = 1; i <= 4; i++)
+      file.writeSync({ key: "e3d2d3d4d5d6d7d" + i, name: "CURSOR " + i, amount: "0000000000000010" });
+    var a = file.openCursor();
+    var b = file.openCursor();
+    assert.equal(a.findSync("e3d2d3d4d5d6d7d1").name, "CURSOR 1");
+    assert.equal(b.findSync("e3d2d3d4d5d6d7d3").name, "CURSOR 3");
+    assert.equal(file.findSync("e3d2d3d4d5d6d7d4").name, "CURSOR 4");
+    assert.equal(a.readSync().name, "CURSOR 2");
+    assert.equal(b.readSync().name, "CURSOR 4");
+    assert.equal(a.readSync().name, "CURSOR 3");
+    // the dataset object's own record is kept for its update()
+    assert.equal(file.updateSync({ amount: "0000000000000040" }), 1);
+    assert.equal(b.findSync("e3d2d3d4d5d6d7d4").amount, "0000000000000040");
+    a.close();
+    expect(() => {
+      a.readSync();
+    }).to.throw(/readSync error: the cursor is closed./);
+    b.close();
+    assert.equal(file.deleteRangeSync("e3", "e3"), 4);
+    expect(file.close()).to.not.throw;
+    done();
+  });
+
+  it("page through a dataset with resume tokens", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    for (var i = 1; i <= 5; i++)
+      file.writeSync({ key: "e4d2d3d4d5d6d7d" + i, name: "PAGE " + i, amount: "0000000000000010" });
+    var names = [];
+    var page = file.scanPageSync({ from: "e4", to: "e4", limit: 2 });
+    for (;;) {
+      assert.isAtMost(page.records.length, 2);
+      for (var record of page.records)
+        names.push(record.name);
+      if (page.next === null)
+        break;
+      page = file.scanPageSync({ after: page.next, to: "e4", limit: 2 });
+    }
+    assert.deepEqual(names, ["PAGE 1", "PAGE 2", "PAGE 3", "PAGE 4", "PAGE 5"]);
+    expect(() => {
+      file.scanPageSync({ from: "e4" });
+    }).to.throw(/scanPageSync error: limit must be a number greater than 0./);
+    expect(() => {
+      file.scanPageSync({ after: "e4d2", limit: 2 });
+    }).to.throw(/scanPageSync error: after must be the next token of a page returned by scanPage\(\)./);
+    assert.equal(file.deleteRangeSync("e4", "e4"), 5);
+    expect(file.close()).to.not.throw;
+    done();
+  });
+
+  it("page through the duplicates of an alternate key", function() {
+    // needs an alternate index path, with name as its non-unique key and
+    // upgraded on writes, over a dataset with test/schema.json
+    const aixPath = process.env.IBM_VSAM_AIX_PATH;
+    if (!aixPath)
+      this.skip();
+    var schema = JSON.parse(fs.readFileSync('test/schema.json'));
+    schema.name.alternateKey = true;
+    var file = vsam.openSync(aixPath, schema);
+    for (var i = 1; i <= 5; i++)
+      file.writeSync({ key: "eed2d3d4d5d6d7d" + i, name: "EEDUP", amount: "0000000000000010" });
+    var keys = [];
+    var page = file.scanPageSync({ from: "EEDUP", to: "EEDUP", limit: 2 });
+    for (;;) {
+      for (var record of page.records)
+        keys.push(record.key);
+      if (page.next === null)
+        break;
+      page = file.scanPageSync({ after: page.next, to: "EEDUP", limit: 2 });
+    }
+    assert.equal(keys.length, 5);
+    assert.deepEqual(keys.slice().sort(), [1, 2, 3, 4, 5].map((i) => "eed2d3d4d5d6d7d" + i));
+    assert.equal(file.deleteSync("EEDUP"), 5);
+    expect(file.close()).to.not.throw;
+  });
+
+  it("find a record by a buffer key without its length", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')));
+    file.writeSync({ key: "e5d2d3d4d5d6d7d1", name: "BUFKEY", amount: "0000000000000010" });
+    // a view at an offset into a larger buffer
+    var buf = Buffer.from([0x00, 0xe5, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd1, 0xff]);
+    assert.equal(file.findSync(buf.subarray(1, 9)).name, "BUFKEY");
+    assert.equal(file.findSync(new Uint8Array(buf.buffer, buf.byteOffset + 1, 8)).name, "BUFKEY");
+    assert.equal(file.findgeSync(buf.subarray(1, 3)).name, "BUFKEY");
+    expect(() => {
+      file.findSync(buf.subarray(1, 3), 4);
+    }).to.throw(/findSync error: key-buffer-length 4 exceeds the length 2 of the buffer./);
+    assert.equal(file.deleteSync(buf.subarray(1, 9)), 1);
+    expect(file.close()).to.not.throw;
+    done();
+  });
+
+  it("use a dataset opened with direct: true from the sync functions only", function(done) {
+    var file = vsam.openSync(testSet,
+                             JSON.parse(fs.readFileSync('test/schema.json')),
+                             { direct: true });
+    file.writeSync({ key: "e6d2d3d4d5d6d7d1", name: "DIRECT 1", amount: "0000000000000010" });
+    file.writeSync({ key: "e6d2d3d4d5d6d7d2", name: "DIRECT 2", amount: "0000000000000020" });
+    assert.equal(file.findSync("e6d2d3d4d5d6d7d1").name, "DIRECT 1");
+    assert.equal(file.readSync().name, "DIRECT 2");
+    assert.equal(file.updateSync("e6d2d3d4d5d6d7d2", { name: "DIRECT 3" }), 1);
+    assert.equal(file.findSync("e6d2d3d4d5d6d7d2").name, "DIRECT 3");
+    expect(() => {
+      file.setWriteBehind({ batchSize: 8 });
+    }).to.throw(/setWriteBehind error: the dataset was opened with {direct: true}/);
+    expect(() => {
+      file.flush((failures, err) => {});
+    }).to.throw(/flush error: the dataset was opened with {direct: true}/);
+    expect(() => {
+      vsam.openSync(testSet, JSON.parse(fs.readFileSync('test/schema.json')), { direct: 1 });
+    }).to.throw(/openSync error: direct must be a boolean./);
+    var issued = false;
+    file.find("e6d2d3d4d5d6d7d1", (record, err) => {
+      assert.isTrue(issued);
+      assert.isNull(record);
+      assert.equal(err, "direct error: the dataset was opened with {direct: true}, so only the sync functions can be used.");
+      assert.equal(file.deleteRangeSync("e6", "e6"), 2);
+      expect(file.close()).to.not.throw;
+      done();
+    });
+    issued = true;
+  });
+
   it("deallocate a dataset", function(done) {
     var file = vsam.openSync(testSet,
                              JSON.parse(fs.readFileSync('test/schema.json')));
@@ -0,0 +1,124 @@
+/*
+ * Licensed Materials - Property of IBM
+ * (C) Copyright IBM Corp. 2022. All Rights Reserved.
+ * US Government Users Restricted Rights - Use, duplication or disclosure restricted by GSA ADP Schedule Contract with IBM Corp.
+*/
+
+/* The addon loaded in worker threads, each with its own dataset */
+
+const { Worker, isMainThread, parentPort, workerData } = require('worker_threads');
+const vsam = require("../build/Release/vsam.js.node");
+const fs = require('fs');
+const { execSync } = require('child_process');
+
+// Set IBM_VSAM_UID environment variable for customer uid
+const uid = process.env.IBM_VSAM_UID || execSync('whoami').slice(0, -1);
+const nworkers = 4;
+const nrecords = 500;
+
+function dataset(n) {
+  return `${uid}.TEST.WORKER${n}.KSDS`;
+}
+
+async function workerMain() {
+  const schema = JSON.parse(fs.readFileSync('test/schema.json'));
+  const file = vsam.allocSync(workerData.dsname, schema);
+  if (workerData.leaveOpen) {
+    // exit with the dataset open: it's closed by the addon's cleanup hook
+    file.writeSync({ key: "a1", name: "LEFT OPEN", amount: "01" });
+    parentPort.postMessage({ count: 1 });
+    return;
+  }
+  if (workerData.exitInFlight) {
+    // exit with requests on the thread pool: the last one to complete closes
+    // the dataset
+    file.writeSync({ key: "a1", name: "IN FLIGHT", amount: "01" });
+    for (let i = 0; i < 8; i++)
+      file.find("a1", () => {});
+    parentPort.postMessage({ count: 1 });
+    process.exit(0);
+  }
+  const start = process.hrtime.bigint();
+  for (let i = 0; i < workerData.nrecords; i++) {
+    await file.writeAsync({ key: (0x100000 + i).toString(16), name: `WORKER ${workerData.n}`,
+                            amount: i.toString(16).padStart(4, "0") });
+  }
+  let count = 0;
+  for (let record = file.findfirstSync(); record !== null; record = file.readSync())
+    count++;
+  const elapsed = Number(process.hrtime.bigint() - start) / 1e6;
+  file.close();
+  file.dealloc((err) => {
+    parentPort.postMessage({ count, elapsed, err });
+  });
+}
+
+function runWorker(n, leaveOpen = false, exitInFlight = false) {
+  return new Promise((resolve, reject) => {
+    const worker = new Worker(__filename, {
+      workerData: { n, dsname: dataset(n), nrecords, leaveOpen, exitInFlight } });
+    let result;
+    worker.on('message', (msg) => { result = msg; });
+    worker.on('error', reject);
+    worker.on('exit', (code) => {
+      if (code !== 0)
+        reject(new Error(`worker ${n} exited with code ${code}`));
+      else
+        resolve(result);
+    });
+  });
+}
+
+if (!isMainThread) {
+  workerMain().catch((err) => { throw err; });
+} else {
+  const expect = require('chai').expect;
+  const assert = require('chai').assert;
+
+  describe("VSAM Key Sequenced Datasets - worker threads", function() {
+    before(async function() {
+      // remove the datasets left by a previous failed run
+      for (let n = 0; n <= nworkers + 1; n++) {
+        if (vsam.exist(dataset(n))) {
+          var file = vsam.openSync(dataset(n), JSON.parse(fs.readFileSync('test/schema.json')));
+          file.close();
+          await new Promise((resolve) => file.dealloc(resolve));
+        }
+      }
+    });
+
+    it(`write and read ${nrecords} records in each of ${nworkers} workers concurrently`, async function() {
+      const start = Date.now();
+      const results = await Promise.all([...Array(nworkers).keys()].map((n) => runWorker(n)));
+      const elapsed = Date.now() - start;
+      for (const result of results) {
+        assert.ifError(result.err);
+        assert.equal(result.count, nrecords);
+      }
+      console.log(`      ${nworkers * nrecords} records written and read in ${elapsed} ms ` +
+                  `(${Math.round(nworkers * nrecords * 2000 / elapsed)} records/s)`);
+    });
+
+    it("close a dataset left open by a worker on its exit", async function() {
+      const result = await runWorker(nworkers, true);
+      assert.equal(result.count, 1);
+      var file = vsam.openSync(dataset(nworkers), JSON.parse(fs.readFileSync('test/schema.json')));
+      assert.equal(file.findSync("a1").name, "LEFT OPEN");
+      expect(file.close()).to.not.throw;
+      await new Promise((resolve, reject) => {
+        file.dealloc((err) => { err ? reject(new Error(err)) : resolve(); });
+      });
+    });
+
+    it("exit a worker with requests in flight on its dataset", async function() {
+      const result = await runWorker(nworkers + 1, false, true);
+      assert.equal(result.count, 1);
+      var file = vsam.openSync(dataset(nworkers + 1), JSON.parse(fs.readFileSync('test/schema.json')));
+      assert.equal(file.findSync("a1").name, "IN FLIGHT");
+      expect(file.close()).to.not.throw;
+      await new Promise((resolve, reject) => {
+        file.dealloc((err) => { err ? reject(new Error(err)) : resolve(); });
+      });
+    });
+  });
+}
@@ -7,6 +7,8 @@
 
 #include <napi.h>
 
+#include "CompiledSchema.h"
+#include "Snapshot.h"
 #include "WrappedVsam.h"
 
 
@@ -17,8 +19,16 @@ Napi::Object InitAll(Napi::Env env, Napi::Object exports) {
               Napi::Function::New(env, WrappedVsam::OpenSync));
   exports.Set(Napi::String::New(env, "allocSync"),
               Napi::Function::New(env, WrappedVsam::AllocSync));
+  exports.Set(Napi::String::New(env, "openAsync"),
+              Napi::Function::New(env, WrappedVsam::OpenAsync));
+  exports.Set(Napi::String::New(env, "allocAsync"),
+              Napi::Function::New(env, WrappedVsam::AllocAsync));
   exports.Set(Napi::String::New(env, "exist"),
               Napi::Function::New(env, WrappedVsam::Exist));
+  exports.Set(Napi::String::New(env, "compileSchema"),
+              Napi::Function::New(env, CompiledSchema::Compile));
+  exports.Set(Napi::String::New(env, "openSnapshot"),
+              Napi::Function::New(env, Snapshot::Open));
   return exports;
 }
 